@@ -112,6 +112,17 @@ public:
 		for (node_t t0 = 0; t0 < G.max_nodes(); t0 ++) 
 			G.set_node_prop(G_pg_rank, t0, 1 / N);
 
+		// Precompute the inverse out-degrees once, turning the per-edge
+		// divide in the pull loop below into a multiply
+
+		value_t* inv_out_deg = m.allocate<value_t>(G.max_nodes());
+
+#pragma omp parallel for
+		for (node_t t0 = 0; t0 < G.max_nodes(); t0 ++) {
+			size_t d = G.out_degree(t0);
+			inv_out_deg[t0] = d == 0 ? 0 : 1 / ((value_t) d);
+		}
+
 		this->progress_init(max);
 
 		do
@@ -144,7 +155,7 @@ public:
 					typename Graph::iterator iter;
 					typename Graph::iterator end = G.end();
 					for (iter = G.in_begin(t); iter != end; ++iter) {
-						__S1 = __S1 + G_pg_rank[*iter] / ((value_t)((G.out_degree(*iter)))) ;
+						__S1 = __S1 + G_pg_rank[*iter] * inv_out_deg[*iter] ;
 					}
 #else
 					/*ll_edge_iterator iter;
@@ -157,7 +168,7 @@ public:
 					}*/
 
 					ll_foreach_in(w, G, t) {
-						__S1 = __S1 + G_pg_rank[w] / ((value_t)((G.out_degree(w)))) ;
+						__S1 = __S1 + G_pg_rank[w] * inv_out_deg[w] ;
 					}
 #endif
 
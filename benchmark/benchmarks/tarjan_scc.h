@@ -55,12 +55,12 @@
 // BFS/DFS definitions for the procedure
 template <class Graph>
 class Tarjan_dfs : public ll_dfs_template
-    <Graph, true, true, true, false>
+    <Tarjan_dfs<Graph>, Graph, true, true, true, false>
 {
 public:
     Tarjan_dfs(Graph& _G, node_t*& _G_SCC, bool*& _G_InStack, 
         node_t*& _G_LowLink, ll_node_seq_vec& _Stack, node_t& _n)
-    : ll_dfs_template<Graph, true, true, true, false>(_G),
+    : ll_dfs_template<Tarjan_dfs<Graph>, Graph, true, true, true, false>(_G),
       G(_G), G_SCC(_G_SCC), G_InStack(_G_InStack), G_LowLink(_G_LowLink),
 	  Stack(_Stack), n(_n){}
 
@@ -72,15 +72,15 @@ private:  // list of varaibles
     ll_node_seq_vec& Stack;
     node_t& n;
 
-protected:
-    virtual void visit_pre(node_t t) 
+public:  // the DFS template dispatches to these statically
+    void visit_pre(node_t t) 
     {
         G.set_node_prop(G_InStack, t, true);
         Stack.push_back(t);
         G.set_node_prop(G_LowLink, t, t);
     }
 
-    virtual void visit_post(node_t t) 
+    void visit_post(node_t t) 
     {
 		ll_edge_iterator iter;
 		G.out_iter_begin(iter, t);
@@ -105,7 +105,7 @@ protected:
         }
     }
 
-    virtual bool check_navigator(node_t t, edge_t t_idx) 
+    bool check_navigator(node_t t, edge_t t_idx) 
     {
         return ( !G_InStack[t]);
     }
@@ -45,17 +45,93 @@
 #include <cmath>
 #include <algorithm>
 #include <omp.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#ifdef _OPENMP
+#include <parallel/algorithm>
+#endif
 
 #include "benchmarks/benchmark.h"
 #include "tools/print.h"
 
 
+/**
+ * Sort a neighbor list. Power-law graphs have a few nodes with very long
+ * neighbor lists, for which the single-threaded sort dominates the entire
+ * validation, so use the libstdc++ parallel mode sort for those.
+ *
+ * @param v the neighbor list
+ */
+inline void cross_validate_sort_neighbors(std::vector<node_t>& v) {
+#ifdef _OPENMP
+	if (v.size() >= 65536) {
+		__gnu_parallel::sort(v.begin(), v.end());
+		return;
+	}
+#endif
+	std::sort(v.begin(), v.end());
+}
+
+
+/**
+ * Advise transparent hugepages for the backing store of a neighbor buffer
+ * once it grows past the 2 MB hugepage size, to cut TLB misses on the
+ * sort and compare sweeps. Re-advises only when the vector reallocates.
+ *
+ * @param v the neighbor buffer
+ * @param advised the previously advised data pointer (in/out)
+ */
+inline void cross_validate_advise_hugepages(std::vector<node_t>& v,
+		const void*& advised) {
+#ifdef MADV_HUGEPAGE
+	if (v.data() == advised) return;
+	if (v.capacity() * sizeof(node_t) < (2ul << 20)) return;
+	advised = v.data();
+
+	uintptr_t start = (uintptr_t) v.data();
+	uintptr_t end = start + v.capacity() * sizeof(node_t);
+	uintptr_t mask = sysconf(_SC_PAGESIZE) - 1;
+	start = (start + mask) & ~mask;
+	end &= ~mask;
+	if (end > start) madvise((void*) start, end - start, MADV_HUGEPAGE);
+#else
+	(void) v; (void) advised;
+#endif
+}
+
+
+/**
+ * Turn a property map into a vector of (name, property) pairs sorted by
+ * name, so that two such collections can be matched with a linear merge
+ * instead of per-node tree lookups
+ *
+ * @param m the property map
+ * @return the sorted vector of pairs
+ */
+template <class Map>
+std::vector<std::pair<std::string, typename Map::mapped_type> >
+cross_validate_sorted_properties(const Map& m) {
+	std::vector<std::pair<std::string, typename Map::mapped_type> >
+		v(m.begin(), m.end());
+	std::sort(v.begin(), v.end());
+	return v;
+}
+
+
 template <class EXP_GRAPH, class EXP_GRAPH2>
 node_t cross_validate_exp_out(EXP_GRAPH& G_org, EXP_GRAPH2& G_exp) {
 
 	std::vector<node_t> v_exp;
 	std::vector<node_t> v_org;
 
+	const void* advised_exp = NULL;
+	const void* advised_org = NULL;
+
 	if (G_org.max_nodes() != G_exp.max_nodes()) {
 		fprintf(stderr, "Different number of nodes:\n");
 		fprintf(stderr, "  Exp: %lu\n", G_exp.max_nodes());
@@ -63,12 +139,29 @@ node_t cross_validate_exp_out(EXP_GRAPH& G_org, EXP_GRAPH2& G_exp) {
 		abort();
 	}
 
-	for (node_t u = 0; u < G_org.max_nodes(); u ++) 
+	// Hoist the node count: the iterator calls below are statically
+	// dispatched and inlined for the concrete Graph type, so the invariant
+	// max_nodes() call is the only per-iteration indirection left here
+
+	const node_t num_nodes = G_org.max_nodes();
+
+	for (node_t u = 0; u < num_nodes; u ++)
 	{
-		v_exp.clear();
-		v_org.clear();
+		// The degrees are known up front, so size the buffers once and use
+		// indexed writes instead of push_back on the hot path (falling back
+		// to push_back only if the iterator yields more than the degree,
+		// which is exactly the kind of inconsistency we validate below)
+
+		size_t deg_exp = G_exp.out_degree(u);
+		size_t deg_org = G_org.out_degree(u);
+
+		v_exp.resize(deg_exp);
+		v_org.resize(deg_org);
+
+		cross_validate_advise_hugepages(v_exp, advised_exp);
+		cross_validate_advise_hugepages(v_org, advised_org);
 
-		int count_exp = 0;
+		size_t count_exp = 0;
 		ll_edge_iterator iter;
 		G_exp.out_iter_begin(iter, u);
 		for (edge_t v_idx = G_exp.out_iter_next(iter);
@@ -76,37 +169,68 @@ node_t cross_validate_exp_out(EXP_GRAPH& G_org, EXP_GRAPH2& G_exp) {
 				v_idx = G_exp.out_iter_next(iter)) {
 			node_t v = LL_ITER_OUT_NEXT_NODE(G_exp, iter, v_idx);
 
+			if (count_exp < deg_exp)
+				v_exp[count_exp] = v;
+			else
+				v_exp.push_back(v);
 			count_exp++;
-			v_exp.push_back(v);
 		}
+		if (count_exp < deg_exp) v_exp.resize(count_exp);
 
-		int count_org = 0;
+		size_t count_org = 0;
 		G_org.out_iter_begin(iter, u);
 		for (edge_t v_idx = G_org.out_iter_next(iter);
 				v_idx != LL_NIL_EDGE;
 				v_idx = G_org.out_iter_next(iter)) {
 			node_t v = LL_ITER_OUT_NEXT_NODE(G_org, iter, v_idx);
 
+			if (count_org < deg_org)
+				v_org[count_org] = v;
+			else
+				v_org.push_back(v);
 			count_org++;
-			v_org.push_back(v);
 		}
+		if (count_org < deg_org) v_org.resize(count_org);
 
 		if (count_org != count_exp) return u;
 
-		std::sort(v_org.begin(), v_org.end());
-		std::sort(v_exp.begin(), v_exp.end());
-		
-		for (size_t i = 0; i < v_org.size(); i++) {
-			if (v_org[i] != v_exp[i]) {
-				for (size_t j = 0; j < v_org.size(); j++) {
-					printf("%8ld %8ld", v_org[j], v_exp[j]);
-					if (v_org[j] != v_exp[j]) printf(" *");
-					printf("\n");
+		cross_validate_sort_neighbors(v_org);
+		cross_validate_sort_neighbors(v_exp);
+
+		size_t i = 0;
+		bool mismatch = false;
+
+#ifdef __AVX2__
+		// Both vectors are cache-resident after the sort, so compare
+		// four 64-bit node IDs per iteration
+		for (; i + 4 <= v_org.size(); i += 4) {
+			__m256i a = _mm256_loadu_si256((const __m256i*) &v_org[i]);
+			__m256i b = _mm256_loadu_si256((const __m256i*) &v_exp[i]);
+			if (_mm256_movemask_epi8(_mm256_cmpeq_epi64(a, b)) != -1) {
+				mismatch = true;
+				break;
+			}
+		}
+#endif
+
+		if (!mismatch) {
+			for (; i < v_org.size(); i++) {
+				if (v_org[i] != v_exp[i]) {
+					mismatch = true;
+					break;
 				}
-				return u;
 			}
 		}
 
+		if (mismatch) {
+			for (size_t j = 0; j < v_org.size(); j++) {
+				printf("%8ld %8ld", v_org[j], v_exp[j]);
+				if (v_org[j] != v_exp[j]) printf(" *");
+				printf("\n");
+			}
+			return u;
+		}
+
 		if (v_exp.size() != G_exp.out_degree(u)) return u;
 	}
 
@@ -120,36 +244,70 @@ node_t cross_validate_exp_in(EXP_GRAPH& G_org, EXP_GRAPH2& G_exp) {
 	std::vector<node_t> v_exp;
 	std::vector<node_t> v_org;
 
-	for (node_t u = 0; u < G_org.max_nodes(); u ++) 
+	const void* advised_exp = NULL;
+	const void* advised_org = NULL;
+
+	const node_t num_nodes = G_org.max_nodes();
+
+	for (node_t u = 0; u < num_nodes; u ++)
 	{
-		v_exp.clear();
-		v_org.clear();
+		// Size the buffers from the known in-degrees and use indexed
+		// writes, just like cross_validate_exp_out() above
+
+		size_t deg_exp = G_exp.in_degree(u);
+		size_t deg_org = G_org.in_degree(u);
+
+		v_exp.resize(deg_exp);
+		v_org.resize(deg_org);
 
-		int count_exp = 0;
+		cross_validate_advise_hugepages(v_exp, advised_exp);
+		cross_validate_advise_hugepages(v_org, advised_org);
+
+		size_t count_exp = 0;
 		ll_edge_iterator iter;
 		G_exp.inm_iter_begin(iter, u);
 		for (node_t v = G_exp.inm_iter_next(iter);
 				v != LL_NIL_EDGE;
 				v = G_exp.inm_iter_next(iter)) {
+			if (count_exp < deg_exp)
+				v_exp[count_exp] = v;
+			else
+				v_exp.push_back(v);
 			count_exp++;
-			v_exp.push_back(v);
 		}
+		if (count_exp < deg_exp) v_exp.resize(count_exp);
 
-		int count_org = 0;
+		size_t count_org = 0;
 		G_org.inm_iter_begin(iter, u);
 		for (node_t v = G_org.inm_iter_next(iter);
 				v != LL_NIL_EDGE;
 				v = G_org.inm_iter_next(iter)) {
+			if (count_org < deg_org)
+				v_org[count_org] = v;
+			else
+				v_org.push_back(v);
 			count_org++;
-			v_org.push_back(v);
 		}
+		if (count_org < deg_org) v_org.resize(count_org);
 
 		if (count_org != count_exp) return u;
 
-		std::sort(v_org.begin(), v_org.end());
-		std::sort(v_exp.begin(), v_exp.end());
-		
-		for (size_t i = 0; i < v_org.size(); i++) {
+		cross_validate_sort_neighbors(v_org);
+		cross_validate_sort_neighbors(v_exp);
+
+		size_t i = 0;
+
+#ifdef __AVX2__
+		// Compare four 64-bit node IDs per iteration
+		for (; i + 4 <= v_org.size(); i += 4) {
+			__m256i a = _mm256_loadu_si256((const __m256i*) &v_org[i]);
+			__m256i b = _mm256_loadu_si256((const __m256i*) &v_exp[i]);
+			if (_mm256_movemask_epi8(_mm256_cmpeq_epi64(a, b)) != -1)
+				return u;
+		}
+#endif
+
+		for (; i < v_org.size(); i++) {
 			if (v_org[i] != v_exp[i]) return u;
 		}
 
@@ -164,66 +322,51 @@ template <class EXP_GRAPH, class EXP_GRAPH2>
 node_t cross_validate_exp_node_properties(EXP_GRAPH& G_org, EXP_GRAPH2& G_exp) {
 
 	{
-		auto node_properties_org = G_org.get_all_node_properties_32();
-		auto node_properties_exp = G_exp.get_all_node_properties_32();
+		// Match the two property collections by name once, up front; the
+		// per-node loop below then only dereferences raw property pointers
+
+		auto p_org = cross_validate_sorted_properties(
+				G_org.get_all_node_properties_32());
+		auto p_exp = cross_validate_sorted_properties(
+				G_exp.get_all_node_properties_32());
+
+		if (p_org.size() != p_exp.size()) return 0;
+		for (size_t i = 0; i < p_org.size(); i++) {
+			if (p_org[i].first != p_exp[i].first) return 0;
+			if (p_org[i].second->type() != p_exp[i].second->type()) return 0;
+		}
 
-		for (node_t u = 0; u < G_org.max_nodes(); u ++) 
+		for (node_t u = 0, num_nodes = G_org.max_nodes(); u < num_nodes; u ++)
 		{
-			std::map<std::string, std::pair<short, uint64_t>> p_org;
-			std::map<std::string, std::pair<short, uint64_t>> p_exp;
-
-			for (auto it = node_properties_org.begin(); it != node_properties_org.end(); it++) {
-				p_org[it->first] =
-					std::pair<short, uint64_t>(it->second->type(), it->second->get(u));
-			}
-
-			for (auto it = node_properties_exp.begin(); it != node_properties_exp.end(); it++) {
-				p_exp[it->first] =
-					std::pair<short, uint64_t>(it->second->type(), it->second->get(u));
-			}
-
-			for (auto it = p_org.begin(); it != p_org.end(); it++) {
-				auto it2 = p_exp.find(it->first);
-				if (it2 == p_exp.end()) return u;
-				if (it->second.first  != it2->second.first ) return u;
-				if (it->second.second != it2->second.second) return u;
-			}
-
-			for (auto it = p_exp.begin(); it != p_exp.end(); it++) {
-				auto it2 = p_org.find(it->first);
-				if (it2 == p_org.end()) return u;
+			for (size_t i = 0; i < p_org.size(); i++) {
+				if (p_org[i].second->get(u) != p_exp[i].second->get(u))
+					return u;
 			}
 		}
 	}
 
 	{
-		auto node_properties_org = G_org.get_all_node_properties_64();
-		auto node_properties_exp = G_exp.get_all_node_properties_64();
+		auto p_org = cross_validate_sorted_properties(
+				G_org.get_all_node_properties_64());
+		auto p_exp = cross_validate_sorted_properties(
+				G_exp.get_all_node_properties_64());
+
+		if (p_org.size() != p_exp.size()) return 0;
+		for (size_t i = 0; i < p_org.size(); i++) {
+			if (p_org[i].first != p_exp[i].first) return 0;
+			if (p_org[i].second->type() != p_exp[i].second->type()) return 0;
+		}
 
-		for (node_t u = 0; u < G_org.max_nodes(); u ++) 
+		for (node_t u = 0, num_nodes = G_org.max_nodes(); u < num_nodes; u ++)
 		{
-			std::map<std::string, std::pair<short, uint64_t>> p_org;
-			std::map<std::string, std::pair<short, uint64_t>> p_exp;
-
-			for (auto it = node_properties_org.begin(); it != node_properties_org.end(); it++) {
-				p_org[it->first] =
-					std::pair<short, uint64_t>(it->second->type(), it->second->get(u));
-			}
-
-			for (auto it = node_properties_exp.begin(); it != node_properties_exp.end(); it++) {
-				p_exp[it->first] =
-					std::pair<short, uint64_t>(it->second->type(), it->second->get(u));
-			}
-
-			for (auto it = p_org.begin(); it != p_org.end(); it++) {
-				auto it2 = p_exp.find(it->first);
-				if (it2 == p_exp.end()) return u;
-				if (it->second.first  != it2->second.first ) return u;
-				if (it->second.second != it2->second.second) {
-					if (it->second.first == LL_T_STRING) {
-						if (it->second.second == 0 || it2->second.second == 0) return u;
-						std::string* s1 = reinterpret_cast<std::string*>(it->second.second);
-						std::string* s2 = reinterpret_cast<std::string*>(it2->second.second);
+			for (size_t i = 0; i < p_org.size(); i++) {
+				uint64_t x_org = p_org[i].second->get(u);
+				uint64_t x_exp = p_exp[i].second->get(u);
+				if (x_org != x_exp) {
+					if (p_org[i].second->type() == LL_T_STRING) {
+						if (x_org == 0 || x_exp == 0) return u;
+						std::string* s1 = reinterpret_cast<std::string*>(x_org);
+						std::string* s2 = reinterpret_cast<std::string*>(x_exp);
 						if (*s1 != *s2) return u;
 					}
 					else {
@@ -231,11 +374,6 @@ node_t cross_validate_exp_node_properties(EXP_GRAPH& G_org, EXP_GRAPH2& G_exp) {
 					}
 				}
 			}
-
-			for (auto it = p_exp.begin(); it != p_exp.end(); it++) {
-				auto it2 = p_org.find(it->first);
-				if (it2 == p_org.end()) return u;
-			}
 		}
 	}
 
@@ -55,8 +55,12 @@
 template <class Graph>
 class ll_t_degree_distribution : public ll_benchmark<Graph> {
 
-    std::vector<size_t> log2degree_counts;
-    std::vector<size_t> log2degree_sums;
+	// Degrees are bounded by the number of nodes, so 64 log2 buckets
+	// always suffice -- no need for dynamically grown vectors
+	static const size_t NUM_BUCKETS = 64;
+
+	size_t log2degree_counts[NUM_BUCKETS];
+	size_t log2degree_sums[NUM_BUCKETS];
 	size_t max_edges;
 
 
@@ -67,6 +71,8 @@ public:
 	 */
 	ll_t_degree_distribution()
 		: ll_benchmark<Graph>("[Tool] Degree Distribution") {
+		memset(log2degree_counts, 0, sizeof(log2degree_counts));
+		memset(log2degree_sums, 0, sizeof(log2degree_sums));
 		max_edges = 0;
 	}
 
@@ -86,6 +92,11 @@ public:
 	virtual double run(void) {
 		Graph& G = *this->_graph;
 
+		size_t counts[NUM_BUCKETS] = { 0 };
+		size_t sums[NUM_BUCKETS] = { 0 };
+		size_t edges = 0;
+
+#pragma omp parallel for schedule(static) reduction(+:counts,sums,edges)
 		for (node_t n = 0; n < G.max_nodes(); n++) {
 			size_t d = G.out_degree(n);
 
@@ -93,13 +104,16 @@ public:
 			size_t x = d;
 			while (x > 1) { l++; x >>= 1; }
 
-			while (log2degree_counts.size() <= l) log2degree_counts.push_back(0);
-			log2degree_counts[l] += 1;
+			counts[l] += 1;
+			sums[l] += d;
+			edges += d;
+		}
 
-			while (log2degree_sums.size() <= l) log2degree_sums.push_back(0);
-			log2degree_sums[l] += d;
-			max_edges += d;
+		for (size_t i = 0; i < NUM_BUCKETS; i++) {
+			log2degree_counts[i] += counts[i];
+			log2degree_sums[i] += sums[i];
 		}
+		max_edges += edges;
 
         return NAN;
     }
@@ -120,7 +134,8 @@ public:
 		fprintf(f, "----------+----------+----------+----------+----------+----------\n");
 
 		size_t cummulative_count = 0;
-		for (size_t i = 0; i < log2degree_counts.size(); i++) {
+		for (size_t i = 0; i < NUM_BUCKETS; i++) {
+			if (log2degree_counts[i] == 0 && i > 0) continue;
 			cummulative_count += log2degree_counts[i];
 			fprintf(f, " %8lu | %8lu | %8lu | %8.2lf | %8lu | %8.2lf\n",
 					i == 0 ? 0 : (1ul << i), (1ul << (i + 1)) - 1,
@@ -133,7 +148,8 @@ public:
 		fprintf(f, "----------+----------+----------+----------+----------+----------\n");
 
 		size_t cummulative_sum = 0;
-		for (size_t i = 0; i < log2degree_sums.size(); i++) {
+		for (size_t i = 0; i < NUM_BUCKETS; i++) {
+			if (log2degree_counts[i] == 0 && i > 0) continue;
 			cummulative_sum += log2degree_sums[i];
 			fprintf(f, " %8lu | %8lu | %8lu | %8.2lf | %8lu | %8.2lf\n",
 					i == 0 ? 0 : (1ul << i), (1ul << (i + 1)) - 1,
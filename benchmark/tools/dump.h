@@ -42,6 +42,7 @@
 #include <stdint.h>
 #include <float.h>
 #include <limits.h>
+#include <unistd.h>
 #include <cmath>
 #include <algorithm>
 #include <omp.h>
@@ -49,6 +50,139 @@
 #include "benchmarks/benchmark.h"
 
 
+/**
+ * A batched dump output buffer. Formats integers directly into a large
+ * buffer and flushes it with a single write(2) per chunk, which bypasses
+ * the per-edge stdio locking and format-string parsing of fprintf.
+ */
+class ll_dump_buffer {
+
+	static const size_t CAPACITY = 1 << 20;
+
+	char _data[CAPACITY];
+	size_t _len;
+	int _fd;
+
+
+public:
+
+	/**
+	 * Create the buffer
+	 *
+	 * @param out the output file (flushed, so that raw writes stay ordered)
+	 */
+	ll_dump_buffer(FILE* out) {
+		_len = 0;
+		fflush(out);
+		_fd = fileno(out);
+	}
+
+
+	/**
+	 * Destroy the buffer, flushing any buffered output
+	 */
+	~ll_dump_buffer(void) {
+		flush();
+	}
+
+
+	/**
+	 * Flush the buffered data with a single write
+	 */
+	void flush(void) {
+		size_t off = 0;
+		while (off < _len) {
+			ssize_t r = ::write(_fd, _data + off, _len - off);
+			if (r <= 0) {
+				perror("write");
+				abort();
+			}
+			off += r;
+		}
+		_len = 0;
+	}
+
+
+	/**
+	 * Emit a single character
+	 *
+	 * @param c the character
+	 */
+	inline void emit_char(char c) {
+		if (_len + 1 > CAPACITY) flush();
+		_data[_len++] = c;
+	}
+
+
+	/**
+	 * Emit a decimal integer, optionally right-aligned within the given
+	 * minimum width (the equivalent of the "%5ld" row-header format)
+	 *
+	 * @param x the number
+	 * @param width the minimum field width
+	 */
+	inline void emit_i64(int64_t x, size_t width=0) {
+
+		if (_len + 32 > CAPACITY) flush();
+
+		char tmp[24];
+		size_t l = 0;
+
+		bool neg = x < 0;
+		uint64_t v = neg ? 0 - (uint64_t) x : (uint64_t) x;
+		do {
+			tmp[l++] = '0' + (char) (v % 10);
+			v /= 10;
+		} while (v != 0);
+
+		for (size_t t = l + (neg ? 1 : 0); t < width; t++)
+			_data[_len++] = ' ';
+
+		if (neg) _data[_len++] = '-';
+		while (l > 0) _data[_len++] = tmp[--l];
+	}
+
+
+	/**
+	 * Emit a string
+	 *
+	 * @param s the string
+	 */
+	void emit_str(const char* s) {
+		for (; *s != '\0'; s++) emit_char(*s);
+	}
+
+
+	/**
+	 * Append a decimal integer to a string buffer, using the same format
+	 * as emit_i64() -- for threads that format privately before handing
+	 * their output to a shared buffer
+	 *
+	 * @param s the string buffer
+	 * @param x the number
+	 * @param width the minimum field width
+	 */
+	static void append_i64(std::string& s, int64_t x, size_t width=0) {
+
+		char tmp[24];
+		size_t l = 0;
+
+		bool neg = x < 0;
+		uint64_t v = neg ? 0 - (uint64_t) x : (uint64_t) x;
+		do {
+			tmp[l++] = '0' + (char) (v % 10);
+			v /= 10;
+		} while (v != 0);
+
+		for (size_t t = l + (neg ? 1 : 0); t < width; t++)
+			s.push_back(' ');
+
+		if (neg) s.push_back('-');
+		while (l > 0) s.push_back(tmp[--l]);
+	}
+};
+
+
 /**
  * Tool: Dump the graph
  */
@@ -87,38 +221,75 @@ public:
 		bool reverse = G.has_reverse_edges();
 
 		printf("\n\n");
+		fflush(stdout);
+
+		ll_dump_buffer buf(_out);
+
+		// Format each node's adjacency row in parallel into a per-thread
+		// string and hand the rows to the shared buffer in node order, so
+		// that the CSR gather and the formatting overlap across threads
+		// while the output stays byte-identical to the serial dump
+
+		buf.emit_str("Out-edges\n");
+
+#pragma omp parallel
+		{
+			std::string line;
+			line.reserve(4096);
 
-		fprintf(_out, "Out-edges\n");
-		for (size_t n = 0; n < max_nodes; n++) {
-			fprintf(_out, "%5ld:", n);
+#pragma omp for schedule(dynamic,4096) ordered
+			for (size_t n = 0; n < max_nodes; n++) {
+				line.clear();
+				ll_dump_buffer::append_i64(line, n, 5);
+				line.push_back(':');
 
-			ll_edge_iterator iter;
-			G.out_iter_begin(iter, n);
-			for (edge_t v_idx = G.out_iter_next(iter);
-					v_idx != LL_NIL_EDGE;
-					v_idx = G.out_iter_next(iter)) {
-				fprintf(_out, "\t%ld", iter.last_node);
+				ll_edge_iterator iter;
+				G.out_iter_begin(iter, n);
+				for (edge_t v_idx = G.out_iter_next(iter);
+						v_idx != LL_NIL_EDGE;
+						v_idx = G.out_iter_next(iter)) {
+					line.push_back('\t');
+					ll_dump_buffer::append_i64(line, iter.last_node);
+				}
+				line.push_back('\n');
+
+#pragma omp ordered
+				buf.emit_str(line.c_str());
 			}
-			fprintf(_out, "\n");
 		}
 
 		if (reverse) {
-			fprintf(_out, "\nIn-edges\n");
-			for (size_t n = 0; n < max_nodes; n++) {
-				fprintf(_out, "%5ld:", n);
+			buf.emit_str("\nIn-edges\n");
 
-				ll_edge_iterator iter;
-				G.inm_iter_begin(iter, n);
-				for (node_t v = G.inm_iter_next(iter);
-						v != LL_NIL_NODE;
-						v = G.inm_iter_next(iter)) {
-					fprintf(_out, "\t%ld", v);
+#pragma omp parallel
+			{
+				std::string line;
+				line.reserve(4096);
+
+#pragma omp for schedule(dynamic,4096) ordered
+				for (size_t n = 0; n < max_nodes; n++) {
+					line.clear();
+					ll_dump_buffer::append_i64(line, n, 5);
+					line.push_back(':');
+
+					ll_edge_iterator iter;
+					G.inm_iter_begin(iter, n);
+					for (node_t v = G.inm_iter_next(iter);
+							v != LL_NIL_NODE;
+							v = G.inm_iter_next(iter)) {
+						line.push_back('\t');
+						ll_dump_buffer::append_i64(line, v);
+					}
+					line.push_back('\n');
+
+#pragma omp ordered
+					buf.emit_str(line.c_str());
 				}
-				fprintf(_out, "\n");
 			}
 		}
 
-		fprintf(_out, "\n");
+		buf.emit_char('\n');
+		buf.flush();
 
         return NAN;
     }
@@ -49,6 +49,70 @@
 #include "benchmarks/benchmark.h"
 
 
+/**
+ * Sort an adjacency buffer by the target node. Short lists use insertion
+ * sort; longer ones an 8-bit LSD radix sort bouncing between the buffer and
+ * a reusable per-thread scratch area, which is O(k) per node instead of the
+ * O(k log k) comparison sort. Ties keep their iteration order, which is
+ * fine because only the target node is written to the flattened level.
+ *
+ * @param v the adjacency buffer
+ * @param scratch the per-thread scratch buffer
+ */
+inline void ll_flatten_sort_adj(std::vector<std::pair<node_t, edge_t> >& v,
+		std::vector<std::pair<node_t, edge_t> >& scratch) {
+
+	const size_t k = v.size();
+
+	if (k <= 32) {
+		for (size_t i = 1; i < k; i++) {
+			std::pair<node_t, edge_t> x = v[i];
+			size_t j = i;
+			while (j > 0 && v[j-1].first > x.first) {
+				v[j] = v[j-1];
+				j--;
+			}
+			v[j] = x;
+		}
+		return;
+	}
+
+	scratch.resize(k);
+
+	node_t max_key = 0;
+	for (size_t i = 0; i < k; i++) {
+		if (v[i].first > max_key) max_key = v[i].first;
+	}
+
+	std::pair<node_t, edge_t>* src = &v[0];
+	std::pair<node_t, edge_t>* dst = &scratch[0];
+
+	for (int shift = 0; (((uint64_t) max_key) >> shift) != 0; shift += 8) {
+
+		size_t count[256] = { 0 };
+		for (size_t i = 0; i < k; i++) {
+			count[(((uint64_t) src[i].first) >> shift) & 0xff]++;
+		}
+
+		size_t offset = 0;
+		for (size_t b = 0; b < 256; b++) {
+			size_t c = count[b];
+			count[b] = offset;
+			offset += c;
+		}
+
+		for (size_t i = 0; i < k; i++) {
+			dst[count[(((uint64_t) src[i].first) >> shift) & 0xff]++]
+				= src[i];
+		}
+
+		std::swap(src, dst);
+	}
+
+	if (src != &v[0]) std::copy(src, src + k, &v[0]);
+}
+
+
 /**
  * Tool: Flatten the entire database into one level -- i.e. do a full merge
  */
@@ -116,8 +180,12 @@ public:
 
 		// Determine the degree counts
 
+		degree_t max_degree_out = 0;
+
 		for (node_t n = 0; n < G.max_nodes(); n++) {
 			degrees_out[n] = G.out_degree(n);
+			if (degrees_out[n] > max_degree_out)
+				max_degree_out = degrees_out[n];
 		}
 
 		if (reverse) {
@@ -136,7 +204,13 @@ public:
 
 #pragma omp parallel
 		{
+			// Size the gather and scratch buffers once per thread -- the
+			// degrees are already known, so no per-node heap growth
+
 			std::vector<std::pair<node_t, edge_t>> v;
+			std::vector<std::pair<node_t, edge_t>> scratch;
+			v.reserve(max_degree_out);
+			scratch.reserve(max_degree_out);
 
 #pragma omp for nowait schedule(dynamic,1)
 			for (node_t n1 = 0; n1 < G.max_nodes(); n1 += 1024 * 256) {
@@ -151,17 +225,24 @@ public:
 
 				for (node_t n = n1; n < n2; n++) {
 
-					v.clear();
+					size_t deg = degrees_out[n];
+					if (deg == 0) continue;
+
+					v.resize(deg);
+
+					size_t c = 0;
 					ll_edge_iterator iter;
 					G.out_iter_begin(iter, n);
 					for (edge_t v_idx = G.out_iter_next(iter);
-							v_idx != LL_NIL_EDGE;
+							v_idx != LL_NIL_EDGE && c < deg;
 							v_idx = G.out_iter_next(iter)) {
-						v.push_back(std::pair<node_t, edge_t>(iter.last_node,
-									v_idx));
+						v[c].first = iter.last_node;
+						v[c].second = v_idx;
+						c++;
 					}
+					if (c < deg) v.resize(c);
 
-					std::sort(v.begin(), v.end());
+					ll_flatten_sort_adj(v, scratch);
 
 					for (size_t i = 0; i < v.size(); i++) {
 						(*et)[index] = LL_VALUE_CREATE((node_t) v[i].first);
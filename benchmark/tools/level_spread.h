@@ -56,29 +56,75 @@ void level_spread(EXP_GRAPH& G, std::vector<int>& r, std::vector<int>& ds)
 	int nl = G.num_levels();
 	for (int i = 0; i < nl+1; i++) r.push_back(0);
 	for (int i = 0; i < nl+1; i++) ds.push_back(0);
-	bool* b = (bool*) alloca(sizeof(bool) * (nl+1));
 
-	for (node_t n = 0; n < G.max_nodes(); n++) {
-		bzero(b, sizeof(bool) * (nl+1));
+	if (nl + 1 <= 64) {
 
-		ll_edge_iterator iter;
-		G.out_iter_begin(iter, n);
-		for (edge_t e = G.out_iter_next(iter);
-				e != LL_NIL_EDGE;
-				e = G.out_iter_next(iter)) {
+		// The common case: all level flags fit into one 64-bit mask, so
+		// collect them with bit-ors and count them with a single popcount
+		// instead of clearing and rescanning a bool array per node. Each
+		// thread accumulates into its own histogram, merged once at the end
 
-			edge_t l = LL_EDGE_LEVEL(e);
-			if (l == LL_WRITABLE_LEVEL) l = nl;
-			b[l] = true;
+#pragma omp parallel
+		{
+			std::vector<int> r_local(nl + 1, 0);
+			std::vector<int> ds_local(nl + 1, 0);
+
+#pragma omp for schedule(dynamic,4096) nowait
+			for (node_t n = 0; n < G.max_nodes(); n++) {
+				uint64_t b = 0;
+
+				ll_for_each_out_edge(G, n, [&b, nl](edge_t e, node_t w) {
+					edge_t l = LL_EDGE_LEVEL(e);
+					if (l == LL_WRITABLE_LEVEL) l = nl;
+					b |= 1ull << l;
+				});
+
+				int x = __builtin_popcountll(b);
+
+				r_local[x]++;
+				ds_local[x] += G.out_degree(n);
+			}
+
+#pragma omp critical(level_spread_merge)
+			for (int i = 0; i < nl + 1; i++) {
+				r[i] += r_local[i];
+				ds[i] += ds_local[i];
+			}
 		}
 
-		int x = 0;
-		for (int i = 0; i < nl+1; i++) {
-			if (b[i]) x++;
+		return;
+	}
+
+#pragma omp parallel
+	{
+		std::vector<int> r_local(nl + 1, 0);
+		std::vector<int> ds_local(nl + 1, 0);
+		std::vector<char> b(nl + 1);
+
+#pragma omp for schedule(dynamic,4096) nowait
+		for (node_t n = 0; n < G.max_nodes(); n++) {
+			bzero(&b[0], sizeof(char) * (nl+1));
+
+			ll_for_each_out_edge(G, n, [&b, nl](edge_t e, node_t w) {
+				edge_t l = LL_EDGE_LEVEL(e);
+				if (l == LL_WRITABLE_LEVEL) l = nl;
+				b[l] = true;
+			});
+
+			int x = 0;
+			for (int i = 0; i < nl+1; i++) {
+				if (b[i]) x++;
+			}
+
+			r_local[x]++;
+			ds_local[x] += G.out_degree(n);
 		}
 
-		r[x]++;
-		ds[x] += G.out_degree(n);
+#pragma omp critical(level_spread_merge)
+		for (int i = 0; i < nl + 1; i++) {
+			r[i] += r_local[i];
+			ds[i] += ds_local[i];
+		}
 	}
 }
 
@@ -47,86 +47,228 @@
 #include <omp.h>
 
 
+/**
+ * A batched adjacency-row formatter. printf(" %7u") per edge pays the
+ * format-string parsing and the stdio lock on every call; this formats
+ * the digits directly into a buffer and hands whole chunks to stdio with
+ * one fwrite each. Flushing through the same FILE* keeps the output
+ * correctly interleaved with the callers' own printf row headers.
+ */
+class ll_print_emitter {
+
+	static const size_t CAPACITY = 64 * 1024;
+
+	char _data[CAPACITY];
+	size_t _len;
+	FILE* _f;
+
+
+public:
+
+	/**
+	 * Create the emitter
+	 *
+	 * @param f the output file
+	 */
+	ll_print_emitter(FILE* f=stdout) {
+		_len = 0;
+		_f = f;
+	}
+
+
+	/**
+	 * Destroy the emitter, flushing any buffered output
+	 */
+	~ll_print_emitter(void) {
+		flush();
+	}
+
+
+	/**
+	 * Hand the buffered data to stdio
+	 */
+	void flush(void) {
+		if (_len > 0) {
+			fwrite(_data, 1, _len, _f);
+			_len = 0;
+		}
+	}
+
+
+	/**
+	 * Emit a string
+	 *
+	 * @param s the string
+	 */
+	inline void emit_str(const char* s) {
+		for (; *s != '\0'; s++) {
+			if (_len + 1 > CAPACITY) flush();
+			_data[_len++] = *s;
+		}
+	}
+
+
+	/**
+	 * Emit a decimal integer
+	 *
+	 * @param x the number
+	 */
+	inline void emit_i64(int64_t x) {
+
+		if (_len + 32 > CAPACITY) flush();
+
+		char tmp[24];
+		size_t l = 0;
+
+		bool neg = x < 0;
+		uint64_t v = neg ? 0 - (uint64_t) x : (uint64_t) x;
+		do {
+			tmp[l++] = '0' + (char) (v % 10);
+			v /= 10;
+		} while (v != 0);
+
+		if (neg) _data[_len++] = '-';
+		while (l > 0) _data[_len++] = tmp[--l];
+	}
+
+
+	/**
+	 * Emit an unsigned integer right-aligned to seven columns with a
+	 * leading space -- the equivalent of the " %7u" per-edge format
+	 *
+	 * @param v the number
+	 */
+	inline void emit_u32_width7(uint32_t v) {
+
+		if (_len + 32 > CAPACITY) flush();
+
+		char tmp[16];
+		size_t l = 0;
+
+		do {
+			tmp[l++] = '0' + (char) (v % 10);
+			v /= 10;
+		} while (v != 0);
+
+		_data[_len++] = ' ';
+		for (size_t t = l; t < 7; t++) _data[_len++] = ' ';
+		while (l > 0) _data[_len++] = tmp[--l];
+	}
+};
+
+
 template <class EXP_GRAPH>
-void print_exp_adj_out(EXP_GRAPH& G, node_t n) {
+void print_exp_adj_out(EXP_GRAPH& G, node_t n, ll_print_emitter& e) {
 	if (!G.node_exists(n)) {
-		printf(" %7s\n", "--");
+		e.emit_str("      --\n");
 		return;
 	}
-	ll_edge_iterator iter;
-	G.out_iter_begin(iter, n);
-	FOREACH_OUTEDGE_ITER(v_idx, G, iter) {
-		node_t v = LL_ITER_OUT_NEXT_NODE(G, iter, v_idx);
-		printf(" %7u", (unsigned) v);
-		//printf("[%07x]", (unsigned long) v_idx);
-	}
-	printf("  [Degree: %d]\n", (int) G.out_degree(n));
+	ll_for_each_out_edge(G, n, [&e](edge_t v_idx, node_t v) {
+		e.emit_u32_width7((unsigned) v);
+	});
+	e.emit_str("  [Degree: ");
+	e.emit_i64((int) G.out_degree(n));
+	e.emit_str("]\n");
 }
 
 
 template <class EXP_GRAPH>
-void print_exp_adj_out_sorted(EXP_GRAPH& G, node_t n) {
+void print_exp_adj_out(EXP_GRAPH& G, node_t n) {
+	ll_print_emitter e;
+	print_exp_adj_out(G, n, e);
+}
+
+
+template <class EXP_GRAPH>
+void print_exp_adj_out_sorted(EXP_GRAPH& G, node_t n, ll_print_emitter& e) {
 	if (!G.node_exists(n)) {
-		printf(" %7s\n", "--");
+		e.emit_str("      --\n");
 		return;
 	}
-	ll_edge_iterator iter;
-	G.out_iter_begin(iter, n);
 	std::vector<node_t> nodes;
-	FOREACH_OUTEDGE_ITER(v_idx, G, iter) {
-		node_t v = LL_ITER_OUT_NEXT_NODE(G, iter, v_idx);
+	ll_for_each_out_edge(G, n, [&nodes](edge_t v_idx, node_t v) {
 		nodes.push_back(v);
-	}
+	});
 	std::sort(nodes.begin(), nodes.end());
 	for (size_t i = 0; i < nodes.size(); i++)
-		printf(" %7u", (unsigned) nodes[i]);
-	printf("  [Degree: %d]\n", (int) G.out_degree(n));
+		e.emit_u32_width7((unsigned) nodes[i]);
+	e.emit_str("  [Degree: ");
+	e.emit_i64((int) G.out_degree(n));
+	e.emit_str("]\n");
 }
 
 
 template <class EXP_GRAPH>
-void print_exp_adj_in(EXP_GRAPH& G, node_t n) {
+void print_exp_adj_out_sorted(EXP_GRAPH& G, node_t n) {
+	ll_print_emitter e;
+	print_exp_adj_out_sorted(G, n, e);
+}
+
+
+template <class EXP_GRAPH>
+void print_exp_adj_in(EXP_GRAPH& G, node_t n, ll_print_emitter& e) {
 	if (!G.node_exists(n)) {
-		printf(" %7s\n", "--");
+		e.emit_str("      --\n");
 		return;
 	}
-	ll_edge_iterator iter;
-	G.inm_iter_begin(iter, n);
-	FOREACH_INNODE_ITER(v, G, iter) {
-		printf(" %7u", (unsigned) v);
-	}
-	printf("  [Degree: %d]\n", (int) G.in_degree(n));
+	ll_for_each_in_node(G, n, [&e](node_t v) {
+		e.emit_u32_width7((unsigned) v);
+	});
+	e.emit_str("  [Degree: ");
+	e.emit_i64((int) G.in_degree(n));
+	e.emit_str("]\n");
+}
+
+
+template <class EXP_GRAPH>
+void print_exp_adj_in(EXP_GRAPH& G, node_t n) {
+	ll_print_emitter e;
+	print_exp_adj_in(G, n, e);
 }
 
 
 template <class MLCSR>
-void print_exp_adj_within_level(MLCSR& g, node_t n, int l) {
+void print_exp_adj_within_level(MLCSR& g, node_t n, int l,
+		ll_print_emitter& e) {
 	if (!g.node_exists(n)) {
-		printf(" %7s\n", "--");
+		e.emit_str("      --\n");
 		return;
 	}
 	ll_edge_iterator iter;
+	iter.last_node = LL_NIL_NODE;
 	g.iter_begin_within_level(iter, n, l);
 	FOREACH_ITER_WITHIN_LEVEL(v_idx, g, iter) {
 		node_t v = LL_ITER_OUT_NEXT_NODE(g, iter, v_idx);
-		printf(" %7u", (unsigned) v);
+		e.emit_u32_width7((unsigned) v);
 	}
 	if (g.max_nodes(l) > n) {
-		printf("  [Degree: %d]\n", (int) g.degree(n, l));
+		e.emit_str("  [Degree: ");
+		e.emit_i64((int) g.degree(n, l));
+		e.emit_str("]\n");
 	}
 	else {
-		printf("\n");
+		e.emit_str("\n");
 	}
 }
 
 
+template <class MLCSR>
+void print_exp_adj_within_level(MLCSR& g, node_t n, int l) {
+	ll_print_emitter e;
+	print_exp_adj_within_level(g, n, l, e);
+}
+
+
 template <class EXP_GRAPH>
 void print_exp_graph_out(EXP_GRAPH& G) {
 
+	ll_print_emitter e;
+
 	for (node_t n = 0; n < G.max_nodes(); n++) {
 		if (!G.node_exists(n)) continue;
-		printf(" %7ld:", n);
-		print_exp_adj_out(G, n);
+		e.emit_u32_width7((unsigned) n);
+		e.emit_str(":");
+		print_exp_adj_out(G, n, e);
 	}
 }
 
@@ -134,10 +276,13 @@ void print_exp_graph_out(EXP_GRAPH& G) {
 template <class EXP_GRAPH>
 void print_exp_graph_out_sorted(EXP_GRAPH& G) {
 
+	ll_print_emitter e;
+
 	for (node_t n = 0; n < G.max_nodes(); n++) {
 		if (!G.node_exists(n) || G.out_degree(n) == 0) continue;
-		printf(" %7ld:", n);
-		print_exp_adj_out_sorted(G, n);
+		e.emit_u32_width7((unsigned) n);
+		e.emit_str(":");
+		print_exp_adj_out_sorted(G, n, e);
 	}
 }
 
@@ -42,6 +42,7 @@
 #include <stdint.h>
 #include <float.h>
 #include <limits.h>
+#include <limits>
 #include <cmath>
 #include <algorithm>
 #include <omp.h>
@@ -98,42 +99,92 @@ public:
 		Graph& G = *this->_graph;
 		ll_mlcsr_edge_property<value_t>& p = *_p;
 
-        _min = 0;
-        _max = 0;
-        _sum = 0;
-        _mean = 0;
-        _count = 0;
+        // Seed min/max from the numeric limits instead of tracking a
+        // "first" sentinel, which keeps the inner loop branch-predictable
+        // and lets the whole scan run as a plain OpenMP reduction
+
+        value_t vmin = std::numeric_limits<value_t>::max();
+        value_t vmax = std::numeric_limits<value_t>::lowest();
+        value_t vsum = 0;
+        size_t vcount = 0;
+
+        // The stat visits every edge and is order-independent, so when
+        // every visible edge lives in a dense per-level property array --
+        // the common case of a fully checkpointed graph with no deletions
+        // or pending writable edges -- enumerate the edges as (level,
+        // index) pairs directly. The property pages then stream
+        // sequentially instead of being gathered per-node through the
+        // iterator. The degree sum is compared against the dense sizes to
+        // detect the cases where the enumeration would be wrong and the
+        // per-node walk is still required
+
+        size_t visible_edges = 0;
+#pragma omp parallel for schedule(static) reduction(+:visible_edges)
+        for (node_t n = 0; n < G.max_nodes(); n++) {
+            visible_edges += G.out_degree(n);
+        }
 
-        bool first = true;
+        size_t dense_edges = 0;
+        for (int l = 0; l < (int) G.num_levels(); l++) {
+            if (l <= p.max_level_id() && p.level_exists(l))
+                dense_edges += G.max_edges(l);
+        }
 
-        //#pragma omp parallel for schedule(dynamic,4096)
-        for (node_t n = 0; n < G.max_nodes(); n++) {
-            ll_edge_iterator iter;
-            G.out_iter_begin(iter, n);
-            for (edge_t e = G.out_iter_next(iter);
-                    e != LL_NIL_EDGE;
-                    e = G.out_iter_next(iter)) {
-
-                value_t v = p[e];
-
-                if (first) {
-                    _min = v;
-                    _max = v;
-                    first = false;
-                }
-                else {
-                    if (v < _min) _min = v;
-                    if (v > _max) _max = v;
+        if (dense_edges == visible_edges) {
+
+            for (int l = 0; l < (int) G.num_levels(); l++) {
+                if (l > p.max_level_id() || !p.level_exists(l)) continue;
+                edge_t num_edges = G.max_edges(l);
+
+#pragma omp parallel for schedule(static) \
+        reduction(min:vmin) reduction(max:vmax) reduction(+:vsum,vcount)
+                for (edge_t i = 0; i < num_edges; i++) {
+
+                    value_t v = p[LL_EDGE_CREATE(l, i)];
+
+                    if (v < vmin) vmin = v;
+                    if (v > vmax) vmax = v;
+
+                    vsum += v;
+                    vcount++;
                 }
+            }
+        }
+        else {
+
+#pragma omp parallel for schedule(dynamic,4096) \
+        reduction(min:vmin) reduction(max:vmax) reduction(+:vsum,vcount)
+            for (node_t n = 0; n < G.max_nodes(); n++) {
+                ll_edge_iterator iter;
+                G.out_iter_begin(iter, n);
+                for (edge_t e = G.out_iter_next(iter);
+                        e != LL_NIL_EDGE;
+                        e = G.out_iter_next(iter)) {
+
+                    value_t v = p[e];
+
+                    if (v < vmin) vmin = v;
+                    if (v > vmax) vmax = v;
 
-                _sum += v;
-                _count++;
+                    vsum += v;
+                    vcount++;
 
-                //if (v > 1) LL_D_PRINT("%lx: %ld --> %ld [w=%d]\n",
-                        //e, n, iter.last_node, (int) v);
-			}
+                    //if (v > 1) LL_D_PRINT("%lx: %ld --> %ld [w=%d]\n",
+                            //e, n, iter.last_node, (int) v);
+                }
+            }
+        }
+
+        if (vcount == 0) {
+            vmin = 0;
+            vmax = 0;
         }
 
+        _min = vmin;
+        _max = vmax;
+        _sum = vsum;
+        _count = vcount;
+
         _mean = _sum / (double) _count;
 
 		return 0;
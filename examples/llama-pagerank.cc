@@ -37,6 +37,8 @@
  * LLAMA Example: PageRank using persistent storage (LL_PERSISTENCE)
  */
 
+#include <algorithm>
+#include <vector>
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
@@ -46,24 +48,116 @@
 #include <llama.h>
 
 
+/**
+ * Allocate a cache-line-aligned array without touching its pages
+ *
+ * The 64-byte alignment lets the compiler use aligned vector stores for
+ * the parallel fill loops below, which also serve as the NUMA
+ * first-touch of each page.
+ *
+ * @param count the number of elements
+ * @return the array
+ */
+template <typename T>
+static T* alloc_aligned(size_t count) {
+	void* p = NULL;
+	if (posix_memalign(&p, 64, count * sizeof(T)) != 0) {
+		fprintf(stderr, "Error: Out of memory\n");
+		abort();
+	}
+	return (T*) p;
+}
+
+
 /**
  * Run PageRank
  *
+ * The scalar type is a template parameter: float halves the memory
+ * bandwidth of the rank, next-rank, and contribution arrays, which is
+ * where the memory-bound pull spends its time. The per-node accumulator
+ * and the convergence diff stay double for numeric robustness.
+ *
+ * With reorder=true the contribution array is stored in a permuted index
+ * space that clusters high out-degree nodes at the front. The CSR itself
+ * cannot be permuted in place, so the gather goes through an indirection
+ * vector instead; the hot entries -- hubs, which are hit once per
+ * out-edge -- then share a few cache lines instead of being scattered
+ * across the whole array. This helps on scale-free graphs whose rank
+ * array far exceeds the last-level cache and is off by default.
+ *
  * @param G the graph
  * @param damping the damping factor
  * @param threshold the threshold
  * @param max_iterations the maximum number of iterations
+ * @param reorder true to cluster hub contributions for cache locality
  * @param verbose true for verbose
  * @return the PageRank of each node
  */
-double* pagerank(ll_mlcsr_ro_graph& G, double damping, double threshold,
-		size_t max_iterations, bool verbose) {
+template <typename scalar_t>
+scalar_t* pagerank(ll_mlcsr_ro_graph& G, double damping, double threshold,
+		size_t max_iterations, bool reorder, bool verbose) {
 
-	double* pr      = (double*) calloc(G.max_nodes(), sizeof(double));
-	double* pr_next = (double*) calloc(G.max_nodes(), sizeof(double));
+	// Allocate without touching the pages and initialize from the parallel
+	// loops below, so that on NUMA machines each page is first touched --
+	// and therefore placed -- by a thread that will actually work on it.
+	// Unlike calloc, this also avoids a redundant kernel zeroing pass
+
+	scalar_t* pr      = alloc_aligned<scalar_t>(G.max_nodes());
+	scalar_t* pr_next = alloc_aligned<scalar_t>(G.max_nodes());
+	scalar_t* contrib = alloc_aligned<scalar_t>(G.max_nodes());
 
 	double N = G.max_nodes();
-	ll_foreach_node_omp(n, G) pr[n] = 1.0 / N;
+	ll_foreach_node_omp(n, G) pr[n] = (scalar_t) (1.0 / N);
+	ll_foreach_node_omp(n, G) pr_next[n] = 0;
+	ll_foreach_node_omp(n, G) contrib[n] = 0;
+
+	// Precompute the inverse out-degrees once, so that the main loop does
+	// one multiply per node per iteration instead of one divide per edge
+
+	scalar_t* inv_out_deg = alloc_aligned<scalar_t>(G.max_nodes());
+	ll_foreach_node_omp(n, G) {
+		size_t d = G.out_degree(n);
+		inv_out_deg[n] = d == 0 ? 0 : (scalar_t) (1.0 / (double) d);
+	}
+
+	const node_t num_nodes = G.max_nodes();
+
+	// The permutation is computed once and reused across all iterations
+
+	node_t* perm = NULL;
+	if (reorder) {
+		std::vector<node_t> order(num_nodes);
+		for (node_t n = 0; n < num_nodes; n++) order[n] = n;
+		std::sort(order.begin(), order.end(),
+				[&G](node_t a, node_t b) {
+					size_t da = G.out_degree(a);
+					size_t db = G.out_degree(b);
+					if (da != db) return da > db;
+					return a < b;
+				});
+		perm = (node_t*) malloc(num_nodes * sizeof(node_t));
+		for (node_t i = 0; i < num_nodes; i++) perm[order[i]] = i;
+	}
+
+	// Process the nodes in descending in-degree order under a guided
+	// schedule: the expensive hubs are handed out first and the cheap
+	// tail fills in behind them, so on power-law graphs no thread is
+	// left finishing a multi-million-edge node after the others have
+	// drained the queue. Computed once and reused across iterations
+
+	std::vector<node_t> sched(num_nodes);
+	for (node_t n = 0; n < num_nodes; n++) sched[n] = n;
+	std::sort(sched.begin(), sched.end(),
+			[&G](node_t a, node_t b) {
+				size_t da = G.in_degree(a);
+				size_t db = G.in_degree(b);
+				if (da != db) return da > db;
+				return a < b;
+			});
+
+	// How many edges ahead to prefetch in the gather loops below
+
+	const size_t PREFETCH_DIST = 8;
 
 	double diff = 0;
 	size_t iteration = 0;
@@ -71,28 +165,88 @@ double* pagerank(ll_mlcsr_ro_graph& G, double damping, double threshold,
 	do {
 		diff = 0;
 
-		#pragma omp parallel
-		{
-			double diff_prv = 0;
+		// Each node's contribution is the same for all of its out-edges,
+		// so compute it once per iteration instead of per incoming hit
+
+		if (perm == NULL) {
+			ll_foreach_node_omp(n, G) contrib[n] = pr[n] * inv_out_deg[n];
+		}
+		else {
+			ll_foreach_node_omp(n, G)
+				contrib[perm[n]] = pr[n] * inv_out_deg[n];
+		}
 
-			#pragma omp for nowait schedule(dynamic,4096)
-			ll_foreach_node(n, G) {
+		// A plain reduction keeps the abs+add accumulation vectorizable,
+		// with no hand-rolled per-thread partials or atomics. The loop is
+		// duplicated rather than branching on the permutation per edge
+
+		if (perm == NULL) {
+
+			#pragma omp parallel for schedule(guided,64) reduction(+:diff)
+			for (node_t i = 0; i < num_nodes; i++) {
+				node_t n = sched[i];
+
+				// The gather issues a dependent load per edge; prefetching
+				// the contribution of a neighbor several edges ahead within
+				// the current level chunk overlaps the L3 misses
 
 				double t = 0;
-				ll_foreach_in(w, G, n) {
-					t += pr[w] / (double) G.out_degree(w);
+
+				ll_edge_iterator iter;
+				G.inm_iter_begin(iter, n);
+				for (node_t w = G.inm_iter_next(iter);
+						w != LL_NIL_NODE;
+						w = G.inm_iter_next(iter)) {
+					if (iter.left > PREFETCH_DIST) {
+						node_t pw = (node_t) LL_VALUE_PAYLOAD(((const node_t*)
+									iter.ptr)[PREFETCH_DIST - 1]);
+						__builtin_prefetch(&contrib[pw], 0, 0);
+					}
+					t += contrib[w];
 				}
 
 				double val = (1 - damping) / N + damping * t;
-				pr_next[n] = val;
+				pr_next[n] = (scalar_t) val;
 
-				diff_prv += std::abs(val - pr[n]);
+				diff += std::abs(val - (double) pr[n]);
 			}
+		}
+		else {
+
+			#pragma omp parallel for schedule(guided,64) reduction(+:diff)
+			for (node_t i = 0; i < num_nodes; i++) {
+				node_t n = sched[i];
+
+				// With the indirection vector only the permutation entry can
+				// be prefetched ahead; the contribution array is clustered,
+				// so its hot entries tend to stay resident anyway
 
-			ATOMIC_ADD(&diff, diff_prv);
+				double t = 0;
+
+				ll_edge_iterator iter;
+				G.inm_iter_begin(iter, n);
+				for (node_t w = G.inm_iter_next(iter);
+						w != LL_NIL_NODE;
+						w = G.inm_iter_next(iter)) {
+					if (iter.left > PREFETCH_DIST) {
+						node_t pw = (node_t) LL_VALUE_PAYLOAD(((const node_t*)
+									iter.ptr)[PREFETCH_DIST - 1]);
+						__builtin_prefetch(&perm[pw], 0, 0);
+					}
+					t += contrib[perm[w]];
+				}
+
+				double val = (1 - damping) / N + damping * t;
+				pr_next[n] = (scalar_t) val;
+
+				diff += std::abs(val - (double) pr[n]);
+			}
 		}
 
-		ll_foreach_node_omp(n, G) pr[n] = pr_next[n];
+		// The old ranks are dead after this point, so swap the buffers
+		// instead of copying N doubles back
+
+		std::swap(pr, pr_next);
 		iteration++;
 
 		if (verbose) {
@@ -102,6 +256,9 @@ double* pagerank(ll_mlcsr_ro_graph& G, double damping, double threshold,
 	}
 	while ((diff > threshold) && (iteration < max_iterations));
 
+	if (perm != NULL) free(perm);
+	free(inv_out_deg);
+	free(contrib);
 	free(pr_next);
 	return pr;
 }
@@ -111,11 +268,13 @@ double* pagerank(ll_mlcsr_ro_graph& G, double damping, double threshold,
 // The Command-Line Arguments                                               //
 //==========================================================================//
 
-static const char* SHORT_OPTIONS = "d:ht:v";
+static const char* SHORT_OPTIONS = "d:fhrt:v";
 
 static struct option LONG_OPTIONS[] =
 {
 	{"database"     , required_argument, 0, 'd'},
+	{"float"        , no_argument,       0, 'f'},
+	{"reorder"      , no_argument,       0, 'r'},
 	{"help"         , no_argument,       0, 'h'},
 	{"threads"      , required_argument, 0, 't'},
 	{"verbose"      , no_argument,       0, 'v'},
@@ -137,6 +296,8 @@ static void usage(const char* arg0) {
 	
 	fprintf(stderr, "Options:\n");
 	fprintf(stderr, "  -d, --database DIR    Set the database directory\n");
+	fprintf(stderr, "  -f, --float           Compute in single precision\n");
+	fprintf(stderr, "  -r, --reorder         Reorder hub contributions for locality\n");
 	fprintf(stderr, "  -h, --help            Show this usage information and exit\n");
 	fprintf(stderr, "  -t, --threads N       Set the number of threads\n");
 	fprintf(stderr, "  -v, --verbose         Enable verbose output\n");
@@ -147,26 +308,6 @@ static void usage(const char* arg0) {
 // Utilities                                                                //
 //==========================================================================//
 
-struct node_and_data {
-	node_t node;
-	double data;
-};
-
-
-/**
- * Compare by the node data
- */
-int cmp_by_data_desc(const void* a, const void* b) {
-
-	const node_and_data* A = (const node_and_data*) a;
-	const node_and_data* B = (const node_and_data*) b;
-
-	if (A->data > B->data) return -1;
-	if (A->data < B->data) return  1;
-	return (int) A->node - (int) B->node;
-}
-
-
 //==========================================================================//
 // The Main Function                                                        //
 //==========================================================================//
@@ -178,6 +319,8 @@ int main(int argc, char** argv)
 {
 	char* database_directory = NULL;
 	bool verbose = false;
+	bool use_float = false;
+	bool reorder = false;
 	int num_threads = -1;
 
 	double damping = 0.85;
@@ -199,10 +342,18 @@ int main(int argc, char** argv)
 				database_directory = optarg;
 				break;
 
+			case 'f':
+				use_float = true;
+				break;
+
 			case 'h':
 				usage(argv[0]);
 				return 0;
 
+			case 'r':
+				reorder = true;
+				break;
+
 			case 't':
 				num_threads = atoi(optarg);
 				break;
@@ -241,8 +392,21 @@ int main(int argc, char** argv)
 	// Run the computation
 
 	double ts = ll_get_time_ms();
-	double* pr = pagerank(graph.ro_graph(), damping, threshold,
-			max_iterations, verbose);
+
+	double* pr;
+	if (use_float) {
+		float* pr_f = pagerank<float>(graph.ro_graph(), damping, threshold,
+				max_iterations, reorder, verbose);
+		pr = (double*) malloc(graph.max_nodes() * sizeof(double));
+		for (size_t i = 0; i < (size_t) graph.max_nodes(); i++)
+			pr[i] = pr_f[i];
+		free(pr_f);
+	}
+	else {
+		pr = pagerank<double>(graph.ro_graph(), damping, threshold,
+				max_iterations, reorder, verbose);
+	}
+
 	double t = ll_get_time_ms() - ts;
 
 	if (verbose) {
@@ -252,24 +416,29 @@ int main(int argc, char** argv)
 
 	// Print the top nodes
 	
-	size_t n = graph.max_nodes();
-	node_and_data* a = (node_and_data*) malloc(sizeof(node_and_data) * n);
-	for (size_t i = 0; i < n; i++) {
-		a[i].node = i;
-		a[i].data = pr[i];
-	}
+	// Sort a node permutation keyed directly by the dense rank array; the
+	// comparisons then touch half the memory of a (node, rank) struct sort
 
-	qsort(a, n, sizeof(node_and_data), cmp_by_data_desc);
+	size_t n = graph.max_nodes();
+	std::vector<node_t> idx(n);
+	for (size_t i = 0; i < n; i++) idx[i] = i;
 
 	size_t max = 10;
 	if (max > n) max = n;
 
+	// Only the top few nodes are printed, so a partial sort suffices
+	std::partial_sort(idx.begin(), idx.begin() + max, idx.end(),
+			[&pr](node_t a, node_t b) {
+				if (pr[a] != pr[b]) return pr[a] > pr[b];
+				return a < b;
+			});
+
 	printf("\tNode\tPageRank\n");
 	for (size_t i = 0; i < max; i++) {
-		printf("%lu\t%lu\t%0.6lf\n", i+1, a[i].node, a[i].data);
+		printf("%lu\t%lu\t%0.6lf\n", i+1,
+				(unsigned long) idx[i], pr[idx[i]]);
 	}
 
-	free(a);
 	free(pr);
 
 	return 0;
@@ -71,43 +71,171 @@
 #ifndef LL_BFS_TEMPLATE_H
 #define LL_BFS_TEMPLATE_H
 #include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <algorithm>
 #include <map>
+#include <new>
 #include <set>
 #include <unordered_set>
 #include <unordered_map>
 
 
+/**
+ * A small open-addressing hash map from node to BFS level, used for the
+ * initial small phase instead of a red-black tree. Linear probing keeps a
+ * lookup within one or two cache lines instead of a pointer chase per tree
+ * level, which dominates the per-edge cost of the small phase.
+ */
+template<typename level_t>
+class ll_bfs_small_map
+{
+  public:
+    ll_bfs_small_map() {
+        _capacity = 256;
+        _size = 0;
+        _keys = new node_t[_capacity];
+        _vals = new level_t[_capacity];
+        for (size_t i = 0; i < _capacity; i++) _keys[i] = LL_NIL_NODE;
+    }
+
+    ~ll_bfs_small_map() {
+        delete [] _keys;
+        delete [] _vals;
+    }
+
+    size_t size() const { return _size; }
+    size_t capacity() const { return _capacity; }
+
+    node_t key_at(size_t i) const { return _keys[i]; }
+    level_t value_at(size_t i) const { return _vals[i]; }
+
+    bool contains(node_t k) const {
+        return _keys[find_slot(k)] != LL_NIL_NODE;
+    }
+
+    level_t& operator[](node_t k) {
+        size_t i = find_slot(k);
+        if (_keys[i] == LL_NIL_NODE) {
+            if ((_size + 1) * 2 > _capacity) {
+                grow();
+                i = find_slot(k);
+            }
+            _keys[i] = k;
+            _vals[i] = 0;
+            _size++;
+        }
+        return _vals[i];
+    }
+
+    // A single probe sequence for the check-then-insert pattern: inserts
+    // the key with the given value if absent, and reports which happened,
+    // so callers do not pay for two independent lookups per edge
+    level_t& find_or_insert(node_t k, level_t v, bool& inserted) {
+        size_t i = find_slot(k);
+        if (_keys[i] == LL_NIL_NODE) {
+            if ((_size + 1) * 2 > _capacity) {
+                grow();
+                i = find_slot(k);
+            }
+            _keys[i] = k;
+            _vals[i] = v;
+            _size++;
+            inserted = true;
+        } else {
+            inserted = false;
+        }
+        return _vals[i];
+    }
+
+  private:
+    size_t find_slot(node_t k) const {
+        size_t i = (((uint64_t) k) * 0x9E3779B97F4A7C15ull)
+            & (_capacity - 1);
+        while (_keys[i] != LL_NIL_NODE && _keys[i] != k) {
+            i = (i + 1) & (_capacity - 1);
+        }
+        return i;
+    }
+
+    void grow() {
+        node_t* old_keys = _keys;
+        level_t* old_vals = _vals;
+        size_t old_capacity = _capacity;
+
+        _capacity *= 2;
+        _keys = new node_t[_capacity];
+        _vals = new level_t[_capacity];
+        for (size_t i = 0; i < _capacity; i++) _keys[i] = LL_NIL_NODE;
+
+        for (size_t i = 0; i < old_capacity; i++) {
+            if (old_keys[i] == LL_NIL_NODE) continue;
+            size_t j = find_slot(old_keys[i]);
+            _keys[j] = old_keys[i];
+            _vals[j] = old_vals[i];
+        }
+
+        delete [] old_keys;
+        delete [] old_vals;
+    }
+
+    node_t* _keys;
+    level_t* _vals;
+    size_t _capacity;   // always a power of two
+    size_t _size;
+};
+
+
+// level_t sizes the per-node visited_level array that the scan states walk
+// in full, so it should be the narrowest signed type whose range covers the
+// BFS diameter plus the __INVALID_LEVEL sentinel: the benchmarks use short,
+// which halves the scan traffic against int and still handles diameters far
+// beyond any small-world or road graph. It must be signed for the sentinel
 template<class Graph, typename level_t, bool use_multithread, bool has_navigator,
 	bool use_reverse_edge, bool save_child>
 class ll_bfs_template
 {
+	static_assert((level_t) -1 < (level_t) 0,
+			"level_t must be a signed type (the invalid sentinel is -2)");
 
   public:
     ll_bfs_template(Graph& _G) :
             G(_G) {
         visited_bitmap = NULL; // bitmap
         visited_level = NULL;
+        frontier_bitmap = NULL;
+        frontier_next_bitmap = NULL;
         thread_local_next_level = NULL;
         down_edge_array = NULL;
-        down_edge_set = NULL;
         down_edge_array_w = NULL;
+        down_edge_epoch_array = NULL;
+        down_edge_epoch_array_w = NULL;
+        down_edge_epoch = 0;
+        down_edge_total_words = 0;
+        down_edge_list_sorted = true;
         if (save_child) {
-            down_edge_set = new std::unordered_set<edge_t>();
+            down_edge_list.reserve(1024);
         }
     }
 
     virtual ~ll_bfs_template() {
-        delete [] visited_bitmap;
-        delete [] visited_level;
-        delete [] thread_local_next_level;
-        delete down_edge_set;
+        bfs_free(visited_bitmap,
+                sizeof(uint64_t) * ((G.max_nodes() + 63) / 64));
+        bfs_free(visited_level, sizeof(level_t) * G.max_nodes());
+        bfs_free(frontier_bitmap,
+                sizeof(uint64_t) * ((G.max_nodes() + 63) / 64));
+        bfs_free(frontier_next_bitmap,
+                sizeof(uint64_t) * ((G.max_nodes() + 63) / 64));
+        // The queues are trivially destructible and placement-constructed
+        // on posix_memalign memory, so a plain free() is the matching
+        // release
+        free(thread_local_next_level);
 
 		if (down_edge_array != NULL) {
-#ifndef FORCE_L0
-			for (size_t i = 0; i < G.num_levels(); i++) delete[] down_edge_array[i];
-#endif
 			delete[] down_edge_array;
+			delete[] down_edge_epoch_array;
 		}
     }
 
@@ -130,22 +258,51 @@ class ll_bfs_template
         root = root_node;
         state = ST_SMALL;
         assert(root != LL_NIL_NODE);
+
+        // Start a new down-edge epoch instead of clearing the per-level
+        // bitmaps; see set_down_edge_bit. Epochs advance by two so that
+        // odd values can serve as in-progress claim markers, and the rare
+        // wrap-around falls back to a real clear
         if (save_child) {
-            if (down_edge_set == NULL)
-                down_edge_set = new std::unordered_set<edge_t>();
+            if (down_edge_epoch >= 0xfffffffcu) {
+                down_edge_epoch = 0;
+                if (down_edge_array != NULL) {
+                    memset(down_edge_array, 0,
+                            sizeof(uint64_t) * down_edge_total_words);
+                    memset(down_edge_epoch_array, 0,
+                            sizeof(uint32_t) * down_edge_total_words);
+                }
+            }
+            down_edge_epoch += 2;
         }
 
+        // Reserve the queue storage up front: the global queue can grow to
+        // max_nodes() anyway, and reserving it here keeps the first large
+        // level from reallocating mid-traversal (and keeps repeated runs
+        // from reallocating at all, since clear() retains the capacity)
         global_vector.clear();
+        global_vector.reserve(G.max_nodes());
         level_queue_begin.clear();
+        level_queue_begin.reserve(64);
         level_count.clear();
+        level_count.reserve(64);
         // create local queues
         if (thread_local_next_level == NULL) {
-            thread_local_next_level = new std::vector<node_t>[num_thread];
+            // new[] would not honor the queues' 64-byte alignment under
+            // C++11, so take the array from posix_memalign and construct
+            // the queues in place
+            void* m = NULL;
+            if (posix_memalign(&m, 64,
+                        sizeof(ll_bfs_thread_queue) * num_thread) != 0) {
+                perror("posix_memalign");
+                abort();
+            }
+            thread_local_next_level = (ll_bfs_thread_queue*) m;
             for (int i = 0; i < num_thread; i++)
-                thread_local_next_level[i].reserve(THRESHOLD2);
+                new (&thread_local_next_level[i]) ll_bfs_thread_queue();
         } else {
             for (int i = 0; i < num_thread; i++)
-                thread_local_next_level[i].clear();
+                thread_local_next_level[i].len = 0;
         }
     }
 
@@ -157,6 +314,15 @@ class ll_bfs_template
         curr_count = 0;
         next_count = 0;
 
+        // Track the Beamer-style direction criterion: mf, the number of
+        // edges hanging off the frontier being discovered, against mu, the
+        // number of edges still reachable from unexplored nodes
+
+        next_frontier_edges = 0;
+        unexplored_edges = 0;
+        for (size_t i = 0; i < G.num_levels(); i++)
+            unexplored_edges += G.max_edges(i);
+
         small_visited[root] = curr_level;
         curr_count++;
         global_vector.push_back(root);
@@ -172,8 +338,7 @@ class ll_bfs_template
                 case ST_SMALL: {
                     for (node_t i = 0; i < curr_count; i++) {
                         node_t t = global_vector[global_curr_level_begin + i];
-                        iterate_neighbor_small(t);
-                        visit_fw(t);            // visit after iteration. in that way, one can check  down-neighbors quite easily
+                        iterate_and_visit_small(t);
                     }
                     break;
                 }
@@ -181,14 +346,50 @@ class ll_bfs_template
                     if (use_multithread)  // do it in parallel
                     {
                         int num_threads = std::min((node_t) max_threads, curr_count/128+1);
+
+                        // Partition the frontier by edges, not vertices: a
+                        // prefix sum of the frontier degrees lets each
+                        // thread binary-search the vertex range holding its
+                        // 1/T share of the edges, so a hub no longer stalls
+                        // the level barrier behind a single thread. The
+                        // O(frontier) scan is trivial next to expanding
+                        // those same vertices' edges
+
+                        frontier_edge_prefix.resize(curr_count + 1);
+                        frontier_edge_prefix[0] = 0;
+                        #pragma omp parallel for schedule(static)                                 num_threads(num_threads)
+                        for (node_t i = 0; i < curr_count; i++) {
+                            frontier_edge_prefix[i + 1] = degree_of(
+                                    global_vector[global_curr_level_begin + i]);
+                        }
+                        for (node_t i = 0; i < curr_count; i++)
+                            frontier_edge_prefix[i + 1]
+                                += frontier_edge_prefix[i];
+                        edge_t frontier_edges = frontier_edge_prefix[curr_count];
+
                         #pragma omp parallel num_threads(num_threads)
                         {
                             int tid = omp_get_thread_num();
-                            #pragma omp for nowait 
-                            for (node_t i = 0; i < curr_count; i++) {
+                            int nt = omp_get_num_threads();
+
+                            edge_t e_lo = (edge_t)
+                                ((frontier_edges * (uint64_t) tid) / nt);
+                            edge_t e_hi = (edge_t)
+                                ((frontier_edges * (uint64_t) (tid + 1)) / nt);
+
+                            node_t lo = std::lower_bound(
+                                    frontier_edge_prefix.begin(),
+                                    frontier_edge_prefix.end(), e_lo)
+                                - frontier_edge_prefix.begin();
+                            node_t hi = (tid == nt - 1) ? curr_count
+                                : (node_t) (std::lower_bound(
+                                    frontier_edge_prefix.begin(),
+                                    frontier_edge_prefix.end(), e_hi)
+                                - frontier_edge_prefix.begin());
+
+                            for (node_t i = lo; i < hi; i++) {
                                 node_t t = global_vector[global_curr_level_begin + i];
-                                iterate_neighbor_que(t, tid);
-                                visit_fw(t);
+                                iterate_and_visit_que(t, tid);
                             }
                             finish_thread_que(tid);
                         }
@@ -198,8 +399,7 @@ class ll_bfs_template
                             for (node_t i = 0; i < curr_count; i++) {
                                 //node_t t = global_curr_level[i];
                                 node_t t = global_vector[global_curr_level_begin + i];
-                                iterate_neighbor_que(t, tid);
-                                visit_fw(t);
+                                iterate_and_visit_que(t, tid);
                             }
                             finish_thread_que(tid);
                     }
@@ -211,73 +411,161 @@ class ll_bfs_template
                         #pragma omp parallel num_threads(num_threads)
                         {
                             node_t local_cnt = 0;
-                            #pragma omp for nowait 
+                            edge_t local_mf = 0;
+                            #pragma omp for nowait schedule(dynamic,64)
                             for (node_t i = 0; i < curr_count; i++) {
                                 node_t t = global_vector[global_curr_level_begin + i];
-                                iterate_neighbor_rd(t, local_cnt);
-                                visit_fw(t);
+                                iterate_and_visit_rd(t, local_cnt, local_mf);
                             }
-                            finish_thread_rd(local_cnt);
+                            finish_thread_rd(local_cnt, local_mf);
                         }
                     } else { // do it sequentially
                             node_t local_cnt = 0;
+                            edge_t local_mf = 0;
                             for (node_t i = 0; i < curr_count; i++) {
                                 //node_t t = global_curr_level[i];
                                 node_t t = global_vector[global_curr_level_begin + i];
-                                iterate_neighbor_rd(t, local_cnt);
-                                visit_fw(t);
+                                iterate_and_visit_rd(t, local_cnt, local_mf);
                             }
-                            finish_thread_rd(local_cnt);
+                            finish_thread_rd(local_cnt, local_mf);
                     }
                     break;
                 }
 
                 case ST_RD: {
+                    // Enumerate the frontier from the per-level bitmap --
+                    // one bit per node instead of a 1-word compare per node
+                    // over the whole level array
+                    node_t num_words = (G.max_nodes() + 63) / 64;
+                    if (use_multithread) { // do it in parallel
+                        #pragma omp parallel
+                        {
+                            node_t local_cnt = 0;
+                            edge_t local_mf = 0;
+                            #pragma omp for nowait schedule(dynamic,128)
+                            for (node_t w = 0; w < num_words; w++) {
+                                uint64_t m = frontier_bitmap[w];
+                                while (m != 0) {
+                                    node_t t = (w << 6)
+                                        + __builtin_ctzll(m);
+                                    m &= m - 1;
+                                    iterate_and_visit_rd(t, local_cnt, local_mf);
+                                }
+                            }
+                            finish_thread_rd(local_cnt, local_mf);
+                        }
+                    } else { // do it in sequential
+                            node_t local_cnt = 0;
+                            edge_t local_mf = 0;
+                            for (node_t w = 0; w < num_words; w++) {
+                                uint64_t m = frontier_bitmap[w];
+                                while (m != 0) {
+                                    node_t t = (w << 6)
+                                        + __builtin_ctzll(m);
+                                    m &= m - 1;
+                                    iterate_and_visit_rd(t, local_cnt, local_mf);
+                                }
+                            }
+                            finish_thread_rd(local_cnt, local_mf);
+                    }
+                    break;
+                }
+                case ST_BU: {
+                    // Direction-optimizing (bottom-up) step: when the
+                    // frontier covers a large fraction of the graph, scan
+                    // the still-unvisited nodes and probe their incoming
+                    // neighbors, stopping at the first parent found in the
+                    // current level -- instead of expanding every out-edge
+                    // of the huge frontier. The same scan also performs the
+                    // visit of the current level's nodes
+                    // Drive the scan from the bitmaps instead of the
+                    // level array: the frontier bitmap holds exactly the
+                    // current level's nodes and a zero visited bit marks an
+                    // undiscovered one, so each 64-node block is two loads
+                    // and a ctz enumeration instead of 64 compare-branch
+                    // pairs -- and blocks with no frontier or no unvisited
+                    // nodes are skipped with a single test
+                    node_t num_words = (G.max_nodes() + 63) / 64;
+                    const uint64_t* visited_words
+                        = (const uint64_t*) visited_bitmap;
+                    uint64_t tail_mask = ((G.max_nodes() & 63) != 0)
+                        ? (1ull << (G.max_nodes() & 63)) - 1 : ~0ull;
                     if (use_multithread) { // do it in parallel
                         #pragma omp parallel
                         {
                             node_t local_cnt = 0;
+                            edge_t local_mf = 0;
                             #pragma omp for nowait schedule(dynamic,128)
-                            for (node_t t = 0; t < G.max_nodes(); t++) {
-                                if (visited_level[t] == curr_level) {
-                                    iterate_neighbor_rd(t, local_cnt);
+                            for (node_t w = 0; w < num_words; w++) {
+                                uint64_t fm = frontier_bitmap[w];
+                                while (fm != 0) {
+                                    node_t t = (w << 6)
+                                        + __builtin_ctzll(fm);
+                                    fm &= fm - 1;
                                     visit_fw(t);
                                 }
+                                uint64_t um = ~visited_words[w];
+                                if (w == num_words - 1) um &= tail_mask;
+                                while (um != 0) {
+                                    node_t t = (w << 6)
+                                        + __builtin_ctzll(um);
+                                    um &= um - 1;
+                                    bottom_up_visit(t, local_cnt, local_mf);
+                                }
                             }
-                            finish_thread_rd(local_cnt);
+                            finish_thread_rd(local_cnt, local_mf);
                         }
                     } else { // do it in sequential
                             node_t local_cnt = 0;
-                            for (node_t t = 0; t < G.max_nodes(); t++) {
-                                if (visited_level[t] == curr_level) {
-                                    iterate_neighbor_rd(t, local_cnt);
+                            edge_t local_mf = 0;
+                            for (node_t w = 0; w < num_words; w++) {
+                                uint64_t fm = frontier_bitmap[w];
+                                while (fm != 0) {
+                                    node_t t = (w << 6)
+                                        + __builtin_ctzll(fm);
+                                    fm &= fm - 1;
                                     visit_fw(t);
                                 }
+                                uint64_t um = ~visited_words[w];
+                                if (w == num_words - 1) um &= tail_mask;
+                                while (um != 0) {
+                                    node_t t = (w << 6)
+                                        + __builtin_ctzll(um);
+                                    um &= um - 1;
+                                    bottom_up_visit(t, local_cnt, local_mf);
+                                }
                             }
-                            finish_thread_rd(local_cnt);
+                            finish_thread_rd(local_cnt, local_mf);
                     }
                     break;
                 }
                 case ST_R2Q: {
+                    node_t num_words = (G.max_nodes() + 63) / 64;
                     if (use_multithread) { // do it in parallel
                         #pragma omp parallel
                         {
                             int tid = omp_get_thread_num();
                             #pragma omp for nowait schedule(dynamic,128)
-                            for (node_t t = 0; t < G.max_nodes(); t++) {
-                                if (visited_level[t] == curr_level) {
-                                    iterate_neighbor_que(t, tid);
-                                    visit_fw(t);
+                            for (node_t w = 0; w < num_words; w++) {
+                                uint64_t m = frontier_bitmap[w];
+                                while (m != 0) {
+                                    node_t t = (w << 6)
+                                        + __builtin_ctzll(m);
+                                    m &= m - 1;
+                                    iterate_and_visit_que(t, tid);
                                 }
                             }
                             finish_thread_que(tid);
                         }
                     } else {
                             int tid = 0;
-                            for (node_t t = 0; t < G.max_nodes(); t++) {
-                                if (visited_level[t] == curr_level) {
-                                    iterate_neighbor_que(t, tid);
-                                    visit_fw(t);
+                            for (node_t w = 0; w < num_words; w++) {
+                                uint64_t m = frontier_bitmap[w];
+                                while (m != 0) {
+                                    node_t t = (w << 6)
+                                        + __builtin_ctzll(m);
+                                    m &= m - 1;
+                                    iterate_and_visit_que(t, tid);
                                 }
                             }
                             finish_thread_que(tid);
@@ -335,17 +623,30 @@ class ll_bfs_template
     }
 
     bool is_down_edge(edge_t idx) {
-        if (state == ST_SMALL)
-            return (down_edge_set->find(idx) != down_edge_set->end());
+        if (state == ST_SMALL) {
+            if (!down_edge_list_sorted) {
+                std::sort(down_edge_list.begin(), down_edge_list.end());
+                down_edge_list.erase(std::unique(down_edge_list.begin(),
+                            down_edge_list.end()), down_edge_list.end());
+                down_edge_list_sorted = true;
+            }
+            return std::binary_search(down_edge_list.begin(),
+                    down_edge_list.end(), idx);
+        }
         else {
 #ifdef FORCE_L0
-            return down_edge_array[idx];
+            return get_down_edge_bit(down_edge_array,
+                    down_edge_epoch_array, idx);
 #else
 			size_t level = LL_EDGE_LEVEL(idx);
 			if (level == LL_WRITABLE_LEVEL) {
-				return down_edge_array_w[LL_EDGE_GET_WRITABLE(idx)->we_numerical_id];
+				return get_down_edge_bit(down_edge_array_w,
+						down_edge_epoch_array_w,
+						LL_EDGE_GET_WRITABLE(idx)->we_numerical_id);
 			}
-			return down_edge_array[level][LL_EDGE_INDEX(idx)];
+			size_t off = down_edge_word_offset[level];
+			return get_down_edge_bit(down_edge_array + off,
+					down_edge_epoch_array + off, LL_EDGE_INDEX(idx));
 #endif
 		}
     }
@@ -353,6 +654,29 @@ class ll_bfs_template
   protected:
     virtual void visit_fw(node_t t)=0;
     virtual void visit_rv(node_t t)=0;
+
+    // Per-vertex entry points for the forward states: the expansion of t's
+    // neighbors and the application's visit run back-to-back (the visit
+    // comes after the iteration so that it can check down-neighbors). An
+    // application whose visit_fw() re-walks the adjacency -- e.g. the BC
+    // sigma push -- can override one of these to share a single CSR walk
+    // between the expansion and the visit; the default just chains the two
+
+    virtual void iterate_and_visit_small(node_t t) {
+        iterate_neighbor_small(t);
+        visit_fw(t);
+    }
+
+    virtual void iterate_and_visit_que(node_t t, int tid) {
+        iterate_neighbor_que(t, tid);
+        visit_fw(t);
+    }
+
+    virtual void iterate_and_visit_rd(node_t t, node_t& local_cnt,
+            edge_t& local_mf) {
+        iterate_neighbor_rd(t, local_cnt, local_mf);
+        visit_fw(t);
+    }
     virtual bool check_navigator(node_t t, edge_t nx)=0;
     virtual void do_end_of_level_fw() {
     }
@@ -366,7 +690,7 @@ class ll_bfs_template
     level_t get_level(node_t t) {
         // GCC expansion
         if (__builtin_expect((state == ST_SMALL), 0)) {
-            if (small_visited.find(t) == small_visited.end())
+            if (!small_visited.contains(t))
                 return __INVALID_LEVEL;
             else
                 return small_visited[t];
@@ -395,7 +719,9 @@ class ll_bfs_template
                 }
                 break;
             case ST_QUE:
-                if ((next_count >= THRESHOLD2) && (next_count >= curr_count*5)) {
+                if (((next_count >= THRESHOLD2) && (next_count >= curr_count*5))
+                        || (next_frontier_edges
+                                > unexplored_edges / BU_ALPHA)) {
                     prepare_read();
                     next_state = ST_Q2R;
                 }
@@ -404,10 +730,21 @@ class ll_bfs_template
                 next_state = ST_RD;
                 break;
             case ST_RD:
-                if (next_count <= (2 * curr_count)) {
+                if (can_go_bottom_up()
+                        && next_frontier_edges
+                            > unexplored_edges / BU_ALPHA) {
+                    rebuild_visited_words();
+                    next_state = ST_BU;
+                }
+                else if (next_count <= (2 * curr_count)) {
                     next_state = ST_R2Q;
                 }
                 break;
+            case ST_BU:
+                if (next_count < G.max_nodes() / BU_BETA) {
+                    next_state = ST_RD;
+                }
+                break;
             case ST_R2Q:
                 next_state = ST_QUE;
                 break;
@@ -420,7 +757,7 @@ class ll_bfs_template
     }
 
     void finish_level(int state) {
-        if ((state == ST_RD) || (state == ST_Q2R)) {
+        if ((state == ST_RD) || (state == ST_Q2R) || (state == ST_BU)) {
             // output queue is not valid
         } else { // move output queue
             //node_t* temp = &(global_next_level[next_count]);
@@ -430,13 +767,24 @@ class ll_bfs_template
             global_next_level_begin = global_next_level_begin + next_count;
         }
 
+        if (frontier_bitmap != NULL) {
+            // publish the next frontier for the scan-based states
+            std::swap(frontier_bitmap, frontier_next_bitmap);
+            memset(frontier_next_bitmap, 0,
+                    sizeof(uint64_t) * ((G.max_nodes() + 63) / 64));
+        }
+
+        unexplored_edges -= next_frontier_edges;
+        if (unexplored_edges < 0) unexplored_edges = 0;
+        next_frontier_edges = 0;
+
         curr_count = next_count;
         next_count = 0;
         curr_level++;
 
         // save 'new current' level status
         level_count.push_back(curr_count);
-        if ((state == ST_RD) || (state == ST_Q2R)) {
+        if ((state == ST_RD) || (state == ST_Q2R) || (state == ST_BU)) {
             //level_start_ptr.push_back(NULL);
             level_queue_begin.push_back(-1);
         } else {
@@ -445,6 +793,14 @@ class ll_bfs_template
         }
     }
 
+    // The branches on the template bools (use_reverse_edge, has_navigator,
+    // save_child, use_multithread) below and in the iterate_neighbor_*
+    // loops are compile-time constants per instantiation, so the compiler
+    // folds them away; always_inline makes sure the folding happens even
+    // when the wrappers are not judged profitable to inline on their own,
+    // keeping the per-edge fast path free of template-related tests
+
+	inline __attribute__((always_inline))
 	void iter_begin(ll_edge_iterator& iter, node_t v) {
         if (use_reverse_edge) {
 			G.in_iter_begin_fast(iter, v);
@@ -453,6 +809,7 @@ class ll_bfs_template
         }
     }
 
+	inline __attribute__((always_inline))
 	edge_t iter_next(ll_edge_iterator& iter) {
         if (use_reverse_edge) {
             return G.in_iter_next_fast(iter);
@@ -461,178 +818,396 @@ class ll_bfs_template
         }
     }
 
+    inline __attribute__((always_inline))
     node_t get_node(ll_edge_iterator& iter) {
 		return iter.last_node;
     }
 
+    degree_t degree_of(node_t u) {
+        return use_reverse_edge ? G.in_degree(u) : G.out_degree(u);
+    }
+
+	inline __attribute__((always_inline))
+	void iter_begin_rev(ll_edge_iterator& iter, node_t v) {
+        if (use_reverse_edge) {
+			G.out_iter_begin(iter, v);
+        } else {
+			G.in_iter_begin_fast(iter, v);
+        }
+    }
+
+	inline __attribute__((always_inline))
+	edge_t iter_next_rev(ll_edge_iterator& iter) {
+        if (use_reverse_edge) {
+            return G.out_iter_next(iter);
+        } else {
+            return G.in_iter_next_fast(iter);
+        }
+    }
+
     void iterate_neighbor_small(node_t t) {
 		ll_edge_iterator iter; iter_begin(iter, t);
 		for (edge_t nx = iter_next(iter); nx != LL_NIL_EDGE; nx = iter_next(iter)) {
             node_t u = get_node(iter);
 
-            // check visited
-            if (small_visited.find(u) == small_visited.end()) {
-                if (has_navigator) {
+            if (has_navigator) {
+
+                // The navigator may reject the node, so the membership
+                // test has to stay separate from the insertion here
+
+                if (!small_visited.contains(u)) {
                     if (check_navigator(u, nx) == false) continue;
-                }
 
-                if (save_child) {
-                    save_down_edge_small(nx);
-                }
+                    if (save_child) {
+                        save_down_edge_small(nx);
+                    }
 
-                small_visited[u] = curr_level + 1;
-                //global_next_level[next_count++] = u;
-                global_vector.push_back(u); 
-                next_count++;
-            }
-            else if (save_child) {
-                if (has_navigator) {
+                    small_visited[u] = curr_level + 1;
+                    global_vector.push_back(u);
+                    next_count++;
+                    next_frontier_edges += degree_of(u);
+                }
+                else if (save_child) {
                     if (check_navigator(u, nx) == false) continue;
+
+                    if (small_visited[u] == (curr_level+1)){
+                        save_down_edge_small(nx);
+                    }
                 }
+            } else {
+
+                // Membership check and insertion share one probe sequence
 
-                if (small_visited[u] == (curr_level+1)){
+                bool inserted;
+                level_t& lev = small_visited.find_or_insert(u,
+                        curr_level + 1, inserted);
+
+                if (inserted) {
+                    if (save_child) {
+                        save_down_edge_small(nx);
+                    }
+
+                    //global_next_level[next_count++] = u;
+                    global_vector.push_back(u);
+                    next_count++;
+                    next_frontier_edges += degree_of(u);
+                }
+                else if (save_child && lev == curr_level + 1) {
                     save_down_edge_small(nx);
                 }
             }
         }
     }
 
-    // should be used only when save_child is enabled
+    // should be used only when save_child is enabled; membership queries
+    // sort and dedup the list lazily, so the discovery path itself is one
+    // vector store instead of a hash insert with a per-edge allocation
     void save_down_edge_small(edge_t idx) {
-        down_edge_set->insert(idx);
+        down_edge_list.push_back(idx);
+        down_edge_list_sorted = false;
+    }
+
+    // One bit per edge instead of one byte: the side-array is touched on
+    // every save/check, so the 8x density directly cuts its DRAM traffic.
+    // Writes use an atomic OR since neighbor iterations run concurrently.
+    // All the atomics in this class are plain counters and bit-sets whose
+    // results are consumed only after the barrier at the end of the level,
+    // so they use relaxed ordering: the barrier provides the fence, and a
+    // relaxed RMW avoids a full mfence per update on x86
+
+    // Each bitmap word carries a shadow epoch: a word whose epoch is not
+    // the current one still holds bits from an earlier traversal and reads
+    // as all-zero. The first writer to touch a stale word claims it by
+    // installing the odd (current + 1) marker, clears it, and then
+    // publishes the current epoch; concurrent writers that lose the claim
+    // wait for the publication before OR-ing their bit in. This replaces
+    // the O(E) clear at the start of every BFS with a real clear of only
+    // the words the traversal actually touches
+
+    void set_down_edge_bit(uint64_t* arr, uint32_t* epochs, size_t idx) {
+        size_t w = idx >> 6;
+        uint64_t bit = 1ull << (idx & 63);
+
+        if (use_multithread) {
+            uint32_t e = __atomic_load_n(&epochs[w], __ATOMIC_ACQUIRE);
+            while (e != down_edge_epoch) {
+                if (e != down_edge_epoch + 1
+                        && __atomic_compare_exchange_n(&epochs[w], &e,
+                            down_edge_epoch + 1, false,
+                            __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+                    __atomic_store_n(&arr[w], 0, __ATOMIC_RELAXED);
+                    __atomic_store_n(&epochs[w], down_edge_epoch,
+                            __ATOMIC_RELEASE);
+                    break;
+                }
+                e = __atomic_load_n(&epochs[w], __ATOMIC_ACQUIRE);
+            }
+            __atomic_fetch_or(&arr[w], bit, __ATOMIC_RELAXED);
+        } else {
+            if (epochs[w] != down_edge_epoch) {
+                arr[w] = 0;
+                epochs[w] = down_edge_epoch;
+            }
+            arr[w] |= bit;
+        }
+    }
+
+    bool get_down_edge_bit(const uint64_t* arr, const uint32_t* epochs,
+            size_t idx) {
+        if (epochs[idx >> 6] != down_edge_epoch) return false;
+        return (arr[idx >> 6] >> (idx & 63)) & 1;
     }
 
     void save_down_edge_large(edge_t idx) {
 #ifdef FORCE_L0
-        down_edge_array[idx] = 1;
+        set_down_edge_bit(down_edge_array, down_edge_epoch_array, idx);
 #else
 		size_t level = LL_EDGE_LEVEL(idx);
 		if (level == LL_WRITABLE_LEVEL) {
-			down_edge_array_w[LL_EDGE_GET_WRITABLE(idx)->we_numerical_id] = 1;
+			set_down_edge_bit(down_edge_array_w, down_edge_epoch_array_w,
+					LL_EDGE_GET_WRITABLE(idx)->we_numerical_id);
+		}
+		else {
+			size_t off = down_edge_word_offset[level];
+			set_down_edge_bit(down_edge_array + off,
+					down_edge_epoch_array + off, LL_EDGE_INDEX(idx));
 		}
-		down_edge_array[LL_EDGE_LEVEL(idx)][LL_EDGE_INDEX(idx)] = 1;
 #endif
 	}
 
-    void prepare_que() {
+    // The bottom-up step cannot record down-edges or consult the navigator:
+    // the probe walks the reverse direction, so the edge ids it sees do not
+    // match the forward edges those callbacks expect. It also needs the
+    // reverse direction to be present in the first place
+    bool can_go_bottom_up() {
+        if (save_child || has_navigator) return false;
+        return use_reverse_edge ? true : G.has_reverse_edges();
+    }
 
-        global_vector.reserve(G.max_nodes());
+    // Claim an undiscovered node for the next level: one CAS (or a plain
+    // store when single-threaded) on the level array replaces the old
+    // bitmap test-and-set plus separate level store
+    inline __attribute__((always_inline))
+    bool claim_visited(node_t u) {
+        if (use_multithread) {
+            level_t expected = __INVALID_LEVEL;
+            return __atomic_compare_exchange_n(&visited_level[u],
+                    &expected, (level_t) (curr_level + 1), false,
+                    __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+        } else {
+            visited_level[u] = curr_level + 1;
+            return true;
+        }
+    }
+
+    // The word-granular visited view is only consulted by the bottom-up
+    // scan, so it is rebuilt from the level array when the traversal
+    // switches into ST_BU and then kept current by bottom_up_visit; the
+    // top-down states never touch it
+    void rebuild_visited_words() {
+        node_t num_words = (G.max_nodes() + 63) / 64;
+        uint64_t* words = (uint64_t*) visited_bitmap;
+        node_t num_nodes = G.max_nodes();
+
+#pragma omp parallel if (use_multithread)
+        {
+#pragma omp for nowait schedule(static)
+            for (node_t w = 0; w < num_words; w++) {
+                uint64_t m = 0;
+                node_t base = w << 6;
+                node_t lim = num_nodes - base;
+                if (lim > 64) lim = 64;
+                for (node_t b = 0; b < lim; b++) {
+                    if (visited_level[base + b] != __INVALID_LEVEL)
+                        m |= 1ull << b;
+                }
+                words[w] = m;
+            }
+        }
+    }
+
+    void bottom_up_visit(node_t t, node_t& local_cnt, edge_t& local_mf) {
+		ll_edge_iterator iter; iter_begin_rev(iter, t);
+		for (edge_t nx = iter_next_rev(iter); nx != LL_NIL_EDGE;
+				nx = iter_next_rev(iter)) {
+            node_t u = get_node(iter);
+            if ((frontier_bitmap[u >> 6] >> (u & 63)) & 1) {
+                // the scan assigns each 64-node word to one thread, so
+                // this word update needs no atomic
+                _ll_set_bit(visited_bitmap, t);
+                visited_level[t] = curr_level + 1;
+                mark_next_frontier(t);
+                local_cnt++;
+                local_mf += degree_of(t);
+                break;
+            }
+        }
+    }
+
+    // Record a newly discovered node in the next level's frontier bitmap,
+    // from which the scan-based states enumerate the frontier
+    void mark_next_frontier(node_t u) {
+        if (use_multithread) {
+            __atomic_fetch_or(&frontier_next_bitmap[u >> 6],
+                    1ull << (u & 63), __ATOMIC_RELAXED);
+        } else {
+            frontier_next_bitmap[u >> 6] |= 1ull << (u & 63);
+        }
+    }
+
+    void prepare_que() {
 
         // create bitmap and edges
         if (visited_bitmap == NULL) {
-            visited_bitmap = new unsigned char[(G.max_nodes() + 7) / 8];
-            visited_level = new level_t[G.max_nodes()];
+            // sized in whole 64-bit words so ST_BU can scan it as such
+            visited_bitmap = (unsigned char*)
+                bfs_alloc(sizeof(uint64_t) * ((G.max_nodes() + 63) / 64));
+            visited_level = (level_t*)
+                bfs_alloc(sizeof(level_t) * G.max_nodes());
+        }
+        if (frontier_bitmap == NULL) {
+            frontier_bitmap = (uint64_t*)
+                bfs_alloc(sizeof(uint64_t) * ((G.max_nodes() + 63) / 64));
+            frontier_next_bitmap = (uint64_t*)
+                bfs_alloc(sizeof(uint64_t) * ((G.max_nodes() + 63) / 64));
         }
+        memset(frontier_bitmap, 0,
+                sizeof(uint64_t) * ((G.max_nodes() + 63) / 64));
+        memset(frontier_next_bitmap, 0,
+                sizeof(uint64_t) * ((G.max_nodes() + 63) / 64));
         if (save_child) {
             if (down_edge_array == NULL) {
 #ifdef FORCE_L0
-                down_edge_array = new unsigned char [G.max_edges(0)];
+                down_edge_total_words = (G.max_edges(0) + 63) / 64;
 #else
-                down_edge_array = new unsigned char* [G.num_levels()];
-				for (size_t i = 0; i < G.num_levels(); i++) 
-					down_edge_array[i] = new unsigned char [G.max_edges(i)];
+                // One contiguous allocation for all levels: an edge check
+                // indexes it through a small word-offset table instead of
+                // chasing a per-level pointer first
+                down_edge_word_offset.resize(G.num_levels());
+                down_edge_total_words = 0;
+				for (size_t i = 0; i < G.num_levels(); i++) {
+					down_edge_word_offset[i] = down_edge_total_words;
+					down_edge_total_words += (G.max_edges(i) + 63) / 64;
+				}
+#endif
+                down_edge_array = new uint64_t [down_edge_total_words];
+                down_edge_epoch_array
+                    = new uint32_t [down_edge_total_words];
+                memset(down_edge_epoch_array, 0,
+                        sizeof(uint32_t) * down_edge_total_words);
+#ifndef FORCE_L0
 				// Note: This makes sense only if the current graph is writable,
 				// but fortunatelly it is never accessed unless we are on the
 				// writable level
-				down_edge_array_w = down_edge_array[G.num_levels() - 1];
+				down_edge_array_w = down_edge_array
+					+ down_edge_word_offset[G.num_levels() - 1];
+				down_edge_epoch_array_w = down_edge_epoch_array
+					+ down_edge_word_offset[G.num_levels() - 1];
 #endif
 			}
         }
 
+        // The visited bitmap needs no clearing here: it is rebuilt from
+        // the level array on entry to the bottom-up state. The level array
+        // fill stays parallel both for the store bandwidth -- the constant
+        // fill vectorizes -- and to keep the NUMA first-touch distribution
+        // of its pages
+
         if (use_multithread) {
 			#pragma omp parallel
             {
-				#pragma omp for nowait
-                for (node_t i = 0; i < (G.max_nodes() + 7) / 8; i++)
-                    visited_bitmap[i] = 0;
-
-				#pragma omp for nowait
+				#pragma omp for nowait schedule(static)
                 for (node_t i = 0; i < G.max_nodes(); i++)
                     visited_level[i] = __INVALID_LEVEL;
 
-                if (save_child) {
-#ifdef FORCE_L0
-					#pragma omp for nowait
-					for (edge_t i = 0; i < G.max_edges(0); i++) 
-                        down_edge_array[i] = 0;
-#else
-					#pragma omp for nowait
-					for (size_t i = 0; i < G.num_levels(); i++) 
-                        memset(down_edge_array[i], 0, sizeof(unsigned char) * G.max_edges(i));
-#endif
-                }
+                // (The down-edge bitmaps are not cleared here: stale
+                // words are detected and recycled by the epoch scheme in
+                // set_down_edge_bit)
             }
         } else {
-            for (node_t i = 0; i < (G.max_nodes() + 7) / 8; i++)
-                visited_bitmap[i] = 0;
             for (node_t i = 0; i < G.max_nodes(); i++)
                 visited_level[i] = __INVALID_LEVEL;
-            if (save_child) {
-#ifdef FORCE_L0
-				for (edge_t i = 0; i < G.max_edges(0); i++) 
-					down_edge_array[i] = 0;
-#else
-				for (size_t i = 0; i < G.num_levels(); i++) 
-					memset(down_edge_array[i], 0, sizeof(unsigned char) * G.max_edges(i));
-#endif
-            }
         }
 
-        //typename std::unordered_map<node_t, level_t>::iterator II;
-        typename std::map<node_t, level_t>::iterator II;
-        for (II = small_visited.begin(); II != small_visited.end(); II++) {
-            node_t u = II->first;
-            level_t lev = II->second;
-            _ll_set_bit(visited_bitmap, u);
+        for (size_t i = 0; i < small_visited.capacity(); i++) {
+            node_t u = small_visited.key_at(i);
+            if (u == LL_NIL_NODE) continue;
+            level_t lev = small_visited.value_at(i);
             visited_level[u] = lev;
+            if (lev == curr_level + 1) mark_next_frontier(u);
         }
 
         if (save_child) {
-            typename std::unordered_set<edge_t>::iterator J;
-            for (J = down_edge_set->begin(); J != down_edge_set->end(); J++) {
-				edge_t idx = *J;
-#ifdef FORCE_L0
-				down_edge_array[idx] = 1;
-#else
-				size_t level = LL_EDGE_LEVEL(idx);
-				if (level == LL_WRITABLE_LEVEL) {
-					down_edge_array_w[LL_EDGE_GET_WRITABLE(idx)->we_numerical_id] = 1;
-				}
-				down_edge_array[level][LL_EDGE_INDEX(idx)] = 1;
-#endif
+            for (size_t j = 0; j < down_edge_list.size(); j++) {
+                save_down_edge_large(down_edge_list[j]);
             }
         }
     }
 
+    // The visited structures come from mmap rather than new[]: the pages
+    // are not touched at allocation, so the parallel init loops above and
+    // in prepare_que place each page on the socket of the thread that
+    // first writes it, and large arrays are eligible for huge pages
+
+    static void* bfs_alloc(size_t bytes) {
+        void* p = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) {
+            perror("mmap");
+            abort();
+        }
+#ifdef MADV_HUGEPAGE
+        if (bytes >= 2ul * 1024 * 1024) madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+        return p;
+    }
+
+    static void bfs_free(void* p, size_t bytes) {
+        if (p != NULL) munmap(p, bytes);
+    }
+
+    // Prefetch the visited state of the neighbor several edges ahead in
+    // the current CSR chunk: the bitmap and level lookups are dependent
+    // loads into large arrays and miss for almost every neighbor on big
+    // graphs, and the core iterator only streams the edge table itself
+    void prefetch_visited_ahead(const ll_edge_iterator& iter) {
+        if (iter.owner == LL_I_OWNER_RO_CSR
+                && iter.left > (size_t) BFS_PREFETCH_DIST) {
+            node_t u_future = (node_t) LL_VALUE_PAYLOAD(((const node_t*)
+                        iter.ptr)[BFS_PREFETCH_DIST - 1]);
+            __builtin_prefetch(&visited_level[u_future], 1, 0);
+        }
+    }
+
     void iterate_neighbor_que(node_t t, int tid) {
 		ll_edge_iterator iter; iter_begin(iter, t);
 		for (edge_t nx = iter_next(iter); nx != LL_NIL_EDGE; nx = iter_next(iter)) {
             node_t u = get_node(iter);
 			assert(u >= 0 && u < G.max_nodes());
+            prefetch_visited_ahead(iter);
 
-            // check visited bitmap
-            // test & test& set
-            if (_ll_get_bit(visited_bitmap, u) == 0) {
+            // check visited: the level array is the single source of
+            // truth, claimed with one CAS from the invalid sentinel --
+            // no separate bitmap read and write per neighbor
+            if (visited_level[u] == __INVALID_LEVEL) {
                 if (has_navigator) {
                     if (check_navigator(u, nx) == false) continue;
                 }
 
-                bool re_check_result;
-                if (use_multithread) {
-                    re_check_result = _ll_set_bit_atomic(visited_bitmap, u);
-                } else {
-                    re_check_result = true;
-                    _ll_set_bit(visited_bitmap, u);
-                }
+                bool re_check_result = claim_visited(u);
 
                 if (save_child) {
                     save_down_edge_large(nx);
                 }
 
                 if (re_check_result) {
-                    // add to local q
-                    thread_local_next_level[tid].push_back(u);
-                    visited_level[u] = (curr_level + 1);
+                    // add to the local batch; full batches flush straight
+                    // into the shared queue with one reservation each
+                    ll_bfs_thread_queue& q = thread_local_next_level[tid];
+                    q.buf[q.len++] = u;
+                    q.mf += degree_of(u);
+                    if (q.len == ll_bfs_thread_queue::BATCH) flush_que(q);
+                    mark_next_frontier(u);
                 }
             }
             else if (save_child) {
@@ -646,42 +1221,68 @@ class ll_bfs_template
         }
     }
 
+    // Each per-thread batch is padded out to its own cache line: the
+    // counters are written on every discovery, and packing them
+    // contiguously would bounce the shared line between threads. The batch
+    // is a small fixed buffer: discoveries go straight into the shared
+    // queue once it fills, so the frontier is written once instead of
+    // being staged in a per-thread vector and copied at the level barrier
+    struct __attribute__((aligned(64))) ll_bfs_thread_queue {
+        static const size_t BATCH = 64;
+
+        node_t buf[BATCH];
+        size_t len;
+        edge_t mf;
+
+        ll_bfs_thread_queue() : len(0), mf(0) {}
+    };
+
+    // Reserve a contiguous range of the shared queue with one atomic add
+    // and write the batch there directly -- the only copy of each
+    // discovered node after the one store into the batch buffer
+    void flush_que(ll_bfs_thread_queue& q) {
+        node_t old_idx;
+        if (use_multithread) {
+            old_idx = __atomic_fetch_add(&next_count, (node_t) q.len,
+                    __ATOMIC_RELAXED);
+        } else {
+            old_idx = next_count;
+            next_count += q.len;
+        }
+        memcpy(&(global_vector[global_next_level_begin + old_idx]),
+               q.buf, q.len * sizeof(node_t));
+        q.len = 0;
+    }
+
     void finish_thread_que(int tid) {
-        node_t local_cnt = thread_local_next_level[tid].size();
-        //copy curr_cnt to next_cnt
-        if (local_cnt > 0) {
-            node_t old_idx = __sync_fetch_and_add(&next_count, local_cnt);
-            // copy to global vector
-            memcpy(&(global_vector[global_next_level_begin + old_idx]), 
-                   &(thread_local_next_level[tid][0]), 
-                   local_cnt * sizeof(node_t));
+        ll_bfs_thread_queue& q = thread_local_next_level[tid];
+        if (q.len > 0) flush_que(q);
+
+        if (q.mf > 0) {
+            __atomic_fetch_add(&next_frontier_edges, q.mf,
+                    __ATOMIC_RELAXED);
+            q.mf = 0;
         }
-        thread_local_next_level[tid].clear();
     }
 
     void prepare_read() {
         // nothing to do
     }
 
-    void iterate_neighbor_rd(node_t t, node_t& local_cnt) {
+    void iterate_neighbor_rd(node_t t, node_t& local_cnt,
+            edge_t& local_mf) {
 		ll_edge_iterator iter; iter_begin(iter, t);
 		for (edge_t nx = iter_next(iter); nx != LL_NIL_EDGE; nx = iter_next(iter)) {
             node_t u = get_node(iter);
+            prefetch_visited_ahead(iter);
 
-            // check visited bitmap
-            // test & test& set
-            if (_ll_get_bit(visited_bitmap, u) == 0) {
+            // check visited; see iterate_neighbor_que
+            if (visited_level[u] == __INVALID_LEVEL) {
                 if (has_navigator) {
                     if (check_navigator(u, nx) == false) continue;
                 }
 
-                bool re_check_result;
-                if (use_multithread) {
-                    re_check_result = _ll_set_bit_atomic(visited_bitmap, u);
-                } else {
-                    re_check_result = true;
-                    _ll_set_bit(visited_bitmap, u);
-                }
+                bool re_check_result = claim_visited(u);
 
                 if (save_child) {
                     save_down_edge_large(nx);
@@ -689,8 +1290,9 @@ class ll_bfs_template
 
                 if (re_check_result) {
                     // add to local q
-                    visited_level[u] = curr_level + 1;
+                    mark_next_frontier(u);
                     local_cnt++;
+                    local_mf += degree_of(u);
                 }
             }
             else if (save_child) {
@@ -704,8 +1306,11 @@ class ll_bfs_template
         }
     }
 
-    void finish_thread_rd(node_t local_cnt) {
-        __sync_fetch_and_add(&next_count, local_cnt);
+    void finish_thread_rd(node_t local_cnt, edge_t local_mf) {
+        __atomic_fetch_add(&next_count, local_cnt, __ATOMIC_RELAXED);
+        if (local_mf > 0)
+            __atomic_fetch_add(&next_frontier_edges, local_mf,
+                    __ATOMIC_RELAXED);
     }
 
 
@@ -716,8 +1321,12 @@ class ll_bfs_template
     static const int ST_Q2R = 2;
     static const int ST_RD = 3;
     static const int ST_R2Q = 4;
+    static const int ST_BU = 5;
     static const int THRESHOLD1 = 128;  // single threaded
     static const int THRESHOLD2 = 1024; // move to RD-based
+    static const int BFS_PREFETCH_DIST = 8;
+    static const int BU_ALPHA = 14;     // frontier-edge fraction: go bottom-up
+    static const int BU_BETA = 24;      // frontier-node fraction: go top-down
 
     // not -1. 
     //(why? because curr_level-1 might be -1, when curr_level = 0)
@@ -727,27 +1336,36 @@ class ll_bfs_template
 
     unsigned char* visited_bitmap; // bitmap
     level_t* visited_level; // assumption: small_world graph
+    uint64_t* frontier_bitmap;      // the current level's frontier
+    uint64_t* frontier_next_bitmap; // the frontier being discovered
     bool is_finished;
     level_t curr_level;
     node_t root;
     Graph& G;
     node_t curr_count;
     node_t next_count;
+    edge_t next_frontier_edges;   // mf: edges hanging off the next frontier
+    edge_t unexplored_edges;      // mu: edges of still-unexplored nodes
 
     //std::unordered_map<node_t, level_t> small_visited;
-    std::map<node_t, level_t> small_visited;
-    std::unordered_set<edge_t>* down_edge_set;
-	unsigned char* down_edge_array_w;
-#ifdef FORCE_L0
-    unsigned char* down_edge_array;
-#else
-    unsigned char** down_edge_array;
+    ll_bfs_small_map<level_t> small_visited;
+    std::vector<edge_t> down_edge_list;
+    bool down_edge_list_sorted;
+	uint64_t* down_edge_array_w;
+	uint32_t* down_edge_epoch_array_w;
+    uint64_t* down_edge_array;
+    uint32_t* down_edge_epoch_array;
+#ifndef FORCE_L0
+    std::vector<size_t> down_edge_word_offset;
 #endif
+    size_t down_edge_total_words;
+    uint32_t down_edge_epoch;
 
     //node_t* global_next_level;
     //node_t* global_curr_level;
     //node_t* global_queue;
     std::vector<node_t> global_vector; 
+    std::vector<edge_t> frontier_edge_prefix;
     node_t global_curr_level_begin;
     node_t global_next_level_begin;
 
@@ -755,7 +1373,7 @@ class ll_bfs_template
     std::vector<node_t> level_queue_begin;
     std::vector<node_t> level_count;
 
-    std::vector<node_t>* thread_local_next_level;
+    ll_bfs_thread_queue* thread_local_next_level;
 
 	int max_threads;
 };
@@ -61,9 +61,17 @@
 #endif
 
 #include <sys/mman.h>
+#ifdef LL_HAVE_NUMA
+#include <numa.h>
+#endif
+#include <algorithm>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <errno.h>
 #include <omp.h>
+#include <sys/types.h>
+#include <vector>
 
 
 
@@ -106,7 +114,20 @@
 // Graph types and constants                                                //
 //==========================================================================//
 
+/*
+ * LL_SMALL_IDS narrows node ids to 32 bits, which halves the edge tables
+ * and every per-node worklist for graphs under 2^31 nodes -- the dominant
+ * DRAM traffic in the memory-bound traversals. Edge ids stay 64-bit in
+ * all configurations, since the multi-level CSR packs (level, index)
+ * pairs into them. Not available with LL_DELETIONS, which needs the high
+ * bits of the edge-table values for the deletion levels (checked below,
+ * after the configuration sections that can turn deletions on).
+ */
+#ifdef LL_SMALL_IDS
+typedef int32_t node_t;
+#else
 typedef int64_t node_t;
+#endif
 typedef int64_t edge_t;
 typedef uint32_t degree_t;
 
@@ -115,6 +136,32 @@ typedef struct {
 	node_t head;
 } node_pair_t;
 
+/*
+ * An edge list in structure-of-arrays layout: the tails and heads live in
+ * two parallel arrays, so a scan that consumes only one endpoint -- e.g.
+ * bucketing by source or gathering by target -- fetches half the bytes of
+ * an array of packed node_pair_t records
+ */
+typedef struct {
+	node_t* tail;
+	node_t* head;
+	size_t num_edges;
+} node_pair_soa_t;
+
+/**
+ * Read one edge of a structure-of-arrays edge list as a node pair
+ *
+ * @param e the edge list
+ * @param i the edge index
+ * @return the corresponding node pair
+ */
+inline node_pair_t ll_soa_pair(const node_pair_soa_t& e, size_t i) {
+	node_pair_t p;
+	p.tail = e.tail[i];
+	p.head = e.head[i];
+	return p;
+}
+
 #define LL_NIL				-1
 #define LL_NIL_NODE			((node_t) LL_NIL)
 #define LL_NIL_EDGE			((edge_t) LL_NIL)
@@ -140,6 +187,168 @@ struct ll_edge_comparator {
 };
 
 
+/**
+ * Sort an edge list by tail, then head, with a stable LSD radix sort on
+ * 8-bit digits instead of a comparator-based std::sort -- counting passes
+ * vectorize and never mispredict, unlike a comparison callback. Each pass
+ * is a parallel counting sort: per-thread histograms over fixed chunks,
+ * one exclusive scan in digit-major, thread-minor order (which is what
+ * keeps the scatter stable), then a parallel scatter. Digit positions
+ * above the largest key are skipped, so a graph with small IDs only pays
+ * for the bytes it uses.
+ *
+ * @param edges the edge list
+ * @param n the number of edges
+ */
+inline void ll_sort_edges_radix(node_pair_t* edges, size_t n) {
+
+	if (n < 2) return;
+
+	node_t max_tail = 0;
+	node_t max_head = 0;
+
+#pragma omp parallel
+	{
+		node_t mt = 0;
+		node_t mh = 0;
+
+#pragma omp for nowait schedule(static)
+		for (ssize_t i = 0; i < (ssize_t) n; i++) {
+			if (edges[i].tail > mt) mt = edges[i].tail;
+			if (edges[i].head > mh) mh = edges[i].head;
+		}
+
+#pragma omp critical(ll_sort_edges_radix_max)
+		{
+			if (mt > max_tail) max_tail = mt;
+			if (mh > max_head) max_head = mh;
+		}
+	}
+
+	node_pair_t* scratch = (node_pair_t*) malloc(sizeof(node_pair_t) * n);
+	size_t* counts = (size_t*) malloc(sizeof(size_t) * 256
+			* omp_get_max_threads());
+
+	node_pair_t* src = edges;
+	node_pair_t* dst = scratch;
+
+	// The low-order sort key (head) first, then the high-order one (tail);
+	// stability makes the tail passes preserve the head order
+
+	for (int part = 0; part < 2; part++) {
+
+		uint64_t max_key = (uint64_t) (part == 0 ? max_head : max_tail);
+
+		for (int shift = 0; (max_key >> shift) != 0; shift += 8) {
+
+#pragma omp parallel
+			{
+				int nt = omp_get_num_threads();
+				int tid = omp_get_thread_num();
+
+				// Fixed per-thread chunks, so the count and scatter
+				// phases see the same elements in the same order
+
+				size_t lo = (n * tid) / nt;
+				size_t hi = (n * (tid + 1)) / nt;
+
+				size_t* count = counts + 256 * (size_t) tid;
+				memset(count, 0, sizeof(size_t) * 256);
+
+				for (size_t i = lo; i < hi; i++) {
+					uint64_t k = (uint64_t)
+						(part == 0 ? src[i].head : src[i].tail);
+					count[(k >> shift) & 0xff]++;
+				}
+
+#pragma omp barrier
+#pragma omp single
+				{
+					size_t offset = 0;
+					for (size_t b = 0; b < 256; b++) {
+						for (int t = 0; t < nt; t++) {
+							size_t c = counts[256 * (size_t) t + b];
+							counts[256 * (size_t) t + b] = offset;
+							offset += c;
+						}
+					}
+				}
+
+				for (size_t i = lo; i < hi; i++) {
+					uint64_t k = (uint64_t)
+						(part == 0 ? src[i].head : src[i].tail);
+					dst[count[(k >> shift) & 0xff]++] = src[i];
+				}
+			}
+
+			node_pair_t* x = src; src = dst; dst = x;
+		}
+	}
+
+	if (src != edges) memcpy(edges, src, sizeof(node_pair_t) * n);
+
+	free(counts);
+	free(scratch);
+}
+
+
+/**
+ * Sort one node ID list in place with a serial LSD radix sort on 8-bit
+ * digits, reusing the caller's scratch vector across calls. Meant for
+ * the many small per-vertex adjacency lists sorted during a checkpoint,
+ * where a parallel sort would be overkill; short lists fall back to
+ * std::sort, which degenerates to an insertion sort there and wins
+ * below the cost of even one counting pass. Digit positions above the
+ * largest ID in the list are skipped.
+ *
+ * @param v the node IDs (sorted in place)
+ * @param scratch the scratch buffer (resized as needed)
+ */
+inline void ll_sort_nodes_radix(std::vector<node_t>& v,
+		std::vector<node_t>& scratch) {
+
+	size_t n = v.size();
+	if (n < 64) {
+		std::sort(v.begin(), v.end());
+		return;
+	}
+
+	node_t max_key = 0;
+	for (size_t i = 0; i < n; i++) {
+		if (v[i] > max_key) max_key = v[i];
+	}
+
+	if (scratch.size() < n) scratch.resize(n);
+
+	node_t* src = &v[0];
+	node_t* dst = &scratch[0];
+	size_t count[256];
+
+	for (int shift = 0; ((uint64_t) max_key >> shift) != 0; shift += 8) {
+
+		memset(count, 0, sizeof(count));
+		for (size_t i = 0; i < n; i++) {
+			count[((uint64_t) src[i] >> shift) & 0xff]++;
+		}
+
+		size_t offset = 0;
+		for (size_t b = 0; b < 256; b++) {
+			size_t c = count[b];
+			count[b] = offset;
+			offset += c;
+		}
+
+		for (size_t i = 0; i < n; i++) {
+			dst[count[((uint64_t) src[i] >> shift) & 0xff]++] = src[i];
+		}
+
+		node_t* x = src; src = dst; dst = x;
+	}
+
+	if (src != &v[0]) memcpy(&v[0], src, sizeof(node_t) * n);
+}
+
+
 
 //==========================================================================//
 // Advice constants                                                         //
@@ -147,6 +356,75 @@ struct ll_edge_comparator {
 
 #define LL_ADV_DONTNEED		MADV_DONTNEED
 #define LL_ADV_WILLNEED		MADV_WILLNEED
+#define LL_ADV_RANDOM		MADV_RANDOM
+#define LL_ADV_SEQUENTIAL	MADV_SEQUENTIAL
+#ifdef MADV_HUGEPAGE
+#define LL_ADV_HUGEPAGE		MADV_HUGEPAGE
+#endif
+
+
+/**
+ * Allocate an anonymous mapping backed by 2MB pages if possible. Try a
+ * MAP_HUGETLB mapping first (needs pages reserved by the administrator);
+ * if that fails, fall back to an ordinary mapping with MADV_HUGEPAGE, so
+ * transparent hugepages can still back it. A large CSR edge table on 2MB
+ * pages takes 512x fewer TLB entries than on 4KB pages, which is where
+ * much of the random-access time of the memory-bound traversals goes.
+ *
+ * @param bytes the number of bytes
+ * @return the mapping, or NULL on failure
+ */
+static inline void* ll_mmap_hugepages(size_t bytes) {
+
+	void* p = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+	p = mmap(NULL, bytes, PROT_READ|PROT_WRITE,
+			MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+#endif
+
+	if (p == MAP_FAILED) {
+		p = mmap(NULL, bytes, PROT_READ|PROT_WRITE,
+				MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED) return NULL;
+#ifdef MADV_HUGEPAGE
+		madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+	}
+
+	return p;
+}
+
+
+/**
+ * Whether to interleave the pages of large graph allocations across the
+ * NUMA nodes. Plain inline (not static) so that every translation unit
+ * sees the same flag; the loader sets it from lc_numa_interleave.
+ *
+ * @return the reference to the flag
+ */
+inline bool& ll_numa_interleave_enabled() {
+	static bool enabled = false;
+	return enabled;
+}
+
+
+/**
+ * Interleave the pages of the given mapping across all NUMA nodes, so a
+ * multi-socket traversal draws on every memory controller instead of the
+ * first-touch socket. Call before the pages are touched; a no-op unless
+ * compiled with LL_HAVE_NUMA (and linked with -lnuma).
+ *
+ * @param p the mapping (page-aligned)
+ * @param bytes the number of bytes
+ */
+static inline void ll_numa_interleave(void* p, size_t bytes) {
+#ifdef LL_HAVE_NUMA
+	if (numa_available() >= 0) {
+		numa_interleave_memory(p, bytes, numa_all_nodes_ptr);
+	}
+#endif
+}
 
 
 
@@ -188,14 +466,25 @@ struct ll_edge_comparator {
 #define LL_T_DOUBLE			0x21
 
 
+/*
+ * Type class masks: bit t is set iff type code t belongs to the class.
+ * All LL_T_* codes are < 64, so each predicate below is a single bit test
+ * instead of a chain of compares -- branchless in loops that dispatch on
+ * the property type per element
+ */
+#define LL_T_MASK_INTEGRAL32	((1ull << LL_T_INT32) | (1ull << LL_T_FLOAT))
+#define LL_T_MASK_INTEGRAL64	((1ull << LL_T_INT64) | (1ull << LL_T_DOUBLE))
+#define LL_T_MASK_FLOATING		((1ull << LL_T_FLOAT) | (1ull << LL_T_DOUBLE))
+
+
 /**
  * Is the type 32-bit integral?
  *
  * @param t the type
  * @return true if it is
  */
-inline bool ll_is_type_integral32(short t) {
-	return t == LL_T_INT32 || t == LL_T_FLOAT;
+inline bool __attribute__((const)) ll_is_type_integral32(unsigned t) {
+	return t < 64 && ((LL_T_MASK_INTEGRAL32 >> t) & 1);
 }
 
 
@@ -205,8 +494,8 @@ inline bool ll_is_type_integral32(short t) {
  * @param t the type
  * @return true if it is
  */
-inline bool ll_is_type_integral64(short t) {
-	return t == LL_T_INT64 || t == LL_T_DOUBLE;
+inline bool __attribute__((const)) ll_is_type_integral64(unsigned t) {
+	return t < 64 && ((LL_T_MASK_INTEGRAL64 >> t) & 1);
 }
 
 
@@ -216,8 +505,8 @@ inline bool ll_is_type_integral64(short t) {
  * @param t the type
  * @return true if it is
  */
-inline bool ll_is_type_floating_point(short t) {
-	return t == LL_T_FLOAT || t == LL_T_DOUBLE;
+inline bool __attribute__((const)) ll_is_type_floating_point(unsigned t) {
+	return t < 64 && ((LL_T_MASK_FLOATING >> t) & 1);
 }
 
 
@@ -308,6 +597,10 @@ inline bool ll_is_type_floating_point(short t) {
 // Configuration Modifications                                              //
 //==========================================================================//
 
+#if defined(LL_SMALL_IDS) && defined(LL_DELETIONS)
+#	error "LL_SMALL_IDS cannot be combined with LL_DELETIONS"
+#endif
+
 #ifdef LL_ONE_VT
 #	define LL_FLAT_VT
 #endif
@@ -361,11 +654,85 @@ inline bool ll_is_type_floating_point(short t) {
 #	define LL_ENTRIES_PER_PAGE_BITS		9
 #endif
 #define LL_ENTRIES_PER_PAGE				(1 << LL_ENTRIES_PER_PAGE_BITS)
+#define LL_PAGE_MASK					(LL_ENTRIES_PER_PAGE - 1)
+
+static_assert((LL_ENTRIES_PER_PAGE & LL_PAGE_MASK) == 0,
+		"LL_ENTRIES_PER_PAGE must be a power of two");
+
+/**
+ * Get the page number of the given entry index
+ *
+ * @param x the entry index
+ * @return the page number
+ */
+template <typename T>
+inline constexpr T ll_page_of(T x) {
+	return x >> LL_ENTRIES_PER_PAGE_BITS;
+}
+
+/**
+ * Get the within-page offset of the given entry index
+ *
+ * @param x the entry index
+ * @return the offset within the page
+ */
+template <typename T>
+inline constexpr T ll_page_off(T x) {
+	return x & (T) LL_PAGE_MASK;
+}
+
+/**
+ * Prefetch a cache line for reading into all cache levels
+ *
+ * @param p the address
+ */
+static inline void ll_prefetch_r(const void* p) {
+	__builtin_prefetch(p, 0, 3);
+}
+
+/**
+ * Prefetch a cache line for writing into all cache levels
+ *
+ * @param p the address
+ */
+static inline void ll_prefetch_w(const void* p) {
+	__builtin_prefetch(p, 1, 3);
+}
+
+/**
+ * Prefetch a range of memory for reading, one request per cache line,
+ * with low temporal locality so a long streamed range does not push the
+ * working set out of the cache
+ *
+ * @param p the start address
+ * @param bytes the number of bytes
+ */
+static inline void ll_prefetch_range(const void* p, size_t bytes) {
+	const char* b = (const char*) p;
+	for (size_t i = 0; i < bytes; i += 64) {
+		__builtin_prefetch(b + i, 0, 1);
+	}
+}
+
 
 #define LL_D_STRIPES					256
 #define LL_D_STRIPE_BASE_SHIFT			5
-#define LL_D_STRIPE(x)					(((x) >> LL_D_STRIPE_BASE_SHIFT) \
-											& (LL_D_STRIPES - 1))
+
+static_assert((LL_D_STRIPES & (LL_D_STRIPES - 1)) == 0,
+		"LL_D_STRIPES must be a power of two");
+
+/**
+ * Compute the deletion stripe for the given node ID. A function rather than
+ * a macro so the shift and mask stay in the ID's native width instead of
+ * being promoted, and so the mask is folded at compile time.
+ *
+ * @param x the node ID
+ * @return the stripe index
+ */
+template <typename T>
+inline constexpr T ll_d_stripe(T x) {
+	return (x >> LL_D_STRIPE_BASE_SHIFT) & (T) (LL_D_STRIPES - 1);
+}
 
 #if defined(LL_MLCSR_LEVEL_ID_WRAP) && !defined(LL_MIN_LEVEL)
 #	error "LL_MLCSR_LEVEL_ID_WRAP requires LL_MIN_LEVEL"
@@ -384,9 +751,101 @@ inline bool ll_is_type_floating_point(short t) {
 // edges in the writable layer when LL_COPY_ADJ_LIST_ON_DELETION is enabled
 
 /*
- * Adjacency list length
+ * Adjacency list length -- pinned to uint32_t rather than the
+ * platform-defined unsigned, so it stays in lockstep with degree_t
  */
-typedef unsigned length_t;
+typedef uint32_t length_t;
+
+
+/**
+ * Exclusive prefix scan of a degree array into 64-bit offsets (the sums
+ * overflow 32 bits past 4B edges). Two-phase: each thread sums its fixed
+ * chunk -- a plain reduction loop the compiler vectorizes -- the chunk
+ * totals are scanned serially, and each thread then writes its chunk of
+ * the output with the running sum. This is the row-pointer construction
+ * of a CSR build, parallel instead of one serial O(V) pass.
+ *
+ * @param in the input counts
+ * @param out the output offsets (out[i] = sum of in[0 .. i-1])
+ * @param n the number of elements
+ * @return the total sum
+ */
+static inline size_t ll_exclusive_scan(const degree_t* in, size_t* out,
+		size_t n) {
+
+	size_t sums[LL_D_STRIPES];
+	size_t total = 0;
+
+#pragma omp parallel
+	{
+		int nt = omp_get_num_threads();
+		int tid = omp_get_thread_num();
+		if (nt > LL_D_STRIPES) nt = LL_D_STRIPES;
+
+		if (tid < nt) {
+			size_t lo = (n * tid) / nt;
+			size_t hi = (n * (tid + 1)) / nt;
+
+			size_t x = 0;
+			for (size_t i = lo; i < hi; i++) x += in[i];
+			sums[tid] = x;
+		}
+
+#pragma omp barrier
+#pragma omp single
+		{
+			size_t offset = 0;
+			for (int t = 0; t < nt; t++) {
+				size_t x = sums[t];
+				sums[t] = offset;
+				offset += x;
+			}
+			total = offset;
+		}
+
+		if (tid < nt) {
+			size_t lo = (n * tid) / nt;
+			size_t hi = (n * (tid + 1)) / nt;
+
+			size_t running = sums[tid];
+			for (size_t i = lo; i < hi; i++) {
+				out[i] = running;
+				running += in[i];
+			}
+		}
+	}
+
+	return total;
+}
+
+
+/**
+ * Add one to the degree of every node in the given batch, e.g. for the
+ * sources of a streaming ingest batch. The increments are scalar -- a
+ * vector gather/add/scatter silently loses increments when a node
+ * repeats within one vector, and repeats are common in edge batches --
+ * but the upcoming counter lines are prefetched for writing a fixed
+ * distance ahead, which is where the time of this scatter-dominated
+ * loop actually goes.
+ *
+ * @param degrees the degree array
+ * @param nodes the batch of nodes
+ * @param n the batch size
+ */
+static inline void ll_degree_add_scatter(degree_t* degrees,
+		const node_t* nodes, size_t n) {
+
+	const size_t dist = 16;
+
+	size_t i = 0;
+	for (; i + dist < n; i++) {
+		ll_prefetch_w(&degrees[nodes[i + dist]]);
+		degrees[nodes[i]]++;
+	}
+	for (; i < n; i++) {
+		degrees[nodes[i]]++;
+	}
+}
 
 
 
@@ -394,6 +853,58 @@ typedef unsigned length_t;
 // Configuration Helpers                                                    //
 //==========================================================================//
 
+/*
+ * The flavor toggles as compile-time boolean constants. An ordinary
+ * `if` on one of these folds away exactly like an #ifdef, but the dead
+ * branch stays visible to the compiler, so it keeps being type-checked
+ * and can participate in inlining decisions. Usable only where both
+ * branches compile in every flavor -- code that references
+ * flavor-specific symbols still needs the IF_* macros below.
+ */
+
+#ifdef LL_MEMORY_ONLY
+constexpr bool ll_cfg_memory_only = true;
+#else
+constexpr bool ll_cfg_memory_only = false;
+#endif
+
+#ifdef LL_PERSISTENCE
+constexpr bool ll_cfg_persistence = true;
+#else
+constexpr bool ll_cfg_persistence = false;
+#endif
+
+#ifdef LL_SLCSR
+constexpr bool ll_cfg_slcsr = true;
+#else
+constexpr bool ll_cfg_slcsr = false;
+#endif
+
+#ifdef LL_STREAMING
+constexpr bool ll_cfg_streaming = true;
+#else
+constexpr bool ll_cfg_streaming = false;
+#endif
+
+#ifdef LL_DELETIONS
+constexpr bool ll_cfg_deletions = true;
+#else
+constexpr bool ll_cfg_deletions = false;
+#endif
+
+#ifdef LL_SMALL_IDS
+constexpr bool ll_cfg_small_ids = true;
+#else
+constexpr bool ll_cfg_small_ids = false;
+#endif
+
+#ifdef LL_PRECOMPUTED_DEGREE
+constexpr bool ll_cfg_precomputed_degree = true;
+#else
+constexpr bool ll_cfg_precomputed_degree = false;
+#endif
+
+
 #ifdef LL_PRECOMPUTED_DEGREE
 #define IF_LL_PRECOMPUTED_DEGREE(...) __VA_ARGS__
 #else
@@ -38,6 +38,8 @@
 #define LL_CONFIG_H_
 
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <string>
 #include <vector>
 
@@ -55,20 +57,49 @@
  * Features for checking their support
  */
 
-#define LL_L_FEATURE(feature)	(std::string(#feature))
+/*
+ * The feature names are stringified identifiers, i.e. string literals with
+ * static storage, so the vectors hold plain const char* and the checks do
+ * not allocate
+ */
+#define LL_L_FEATURE(feature)	(#feature)
 
-typedef std::vector<std::string> feature_vector_t;
+typedef std::vector<const char*> feature_vector_t;
 
 inline feature_vector_t& operator<< (feature_vector_t& v,
-		const std::string& value) {
+		const char* value) {
 	v.push_back(value);
 	return v;
 }
 
+/**
+ * Determine whether the given feature is in the supported feature list
+ *
+ * @param feature the feature name (use LL_L_FEATURE())
+ * @param features the vector of supported features
+ * @return true if the feature is in the list
+ */
+inline bool feature_supported(const char* feature,
+		const feature_vector_t& features) {
+	for (size_t j = 0; j < features.size(); j++) {
+		if (feature == features[j]
+				|| strcmp(feature, features[j]) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
 
 
 /**
  * The loader configuration
+ *
+ * The scalar fields come first, so all the flags the ingest inner loops
+ * check per edge (direction, deduplicate, max edges, ...) sit together
+ * at the start of the object, away from the cold temporary directory
+ * strings. (No alignas here: configs are heap-allocated all over the
+ * tree, and C++11 new would not honor it anyway.)
  */
 class ll_loader_config {
 
@@ -89,8 +120,13 @@ public:
 	/// Whether to ignore the properties (and load only the graph structure)
 	bool lc_no_properties;
 
-	/// The temporary directories
-	std::vector<std::string> lc_tmp_dirs;
+	/// Whether to relabel the vertices on ingest for cache locality (a
+	/// Gorder-style ordering that packs the high-degree vertices together)
+	bool lc_reorder_gorder;
+
+	/// Whether to interleave the big CSR allocations across the NUMA nodes
+	/// (needs LL_HAVE_NUMA; otherwise ignored)
+	bool lc_numa_interleave;
 
 	/// Whether to print progress while loading
 	bool lc_print_progress;
@@ -98,6 +134,10 @@ public:
 	/// The buffer size in bytes for external sort (0 = auto-configure)
 	size_t lc_xs_buffer_size;
 
+	/// Whether to LZ4-compress the external sort's spilled runs (honored
+	/// only when built with LL_XS_COMPRESS; ignored otherwise)
+	bool lc_xs_compress;
+
 	/// The max number of edges to load
 	size_t lc_max_edges;
 
@@ -107,6 +147,9 @@ public:
 	/// The partial load - the total number of parts
 	size_t lc_partial_load_num_parts;
 
+	/// The temporary directories (cold; only read when a sort run spills)
+	std::vector<std::string> lc_tmp_dirs;
+
 
 public:
 
@@ -120,10 +163,13 @@ public:
 		lc_reverse_edges = false;
 		lc_reverse_maps = false;
 		lc_no_properties = false;
+		lc_reorder_gorder = false;
+		lc_numa_interleave = false;
 
 		lc_tmp_dirs.clear();
 		lc_print_progress = false;
 		lc_xs_buffer_size = 0;
+		lc_xs_compress = false;
 
 		lc_max_edges = 0;
 		lc_partial_load_part = 0;
@@ -143,18 +189,34 @@ public:
 	bool assert_features(bool direct, bool error,
 			const feature_vector_t& features) const {
 
-		feature_vector_t enabled_features;
-		std::vector<std::string> enabled_feature_names;
+		// Check each enabled feature against the supported list right
+		// away rather than accumulating them into a temporary vector
+		// first -- the streaming path runs this on every micro-batch
+		// checkpoint, and this keeps the check heap-allocation-free.
+		// The supported list is a handful of entries, so a loop over
+		// the literal pointers beats building any hashed set of them
+
+		// Note: this header is also included by the standalone tools in
+		// utils/, which do not pick a LLAMA configuration and therefore
+		// cannot include ll_utils.h; like the rest of this file, rely on
+		// the includer's LL_E_PRINT instead of ll_die
 
 #		define FEATURE(x) \
-			if ((ssize_t) (x) != 0) { \
-				enabled_features << LL_L_FEATURE(x); \
-				enabled_feature_names.push_back(std::string(#x)); \
+			if ((ssize_t) (x) != 0 \
+					&& !feature_supported(LL_L_FEATURE(x), features)) { \
+				if (error) { \
+					LL_E_PRINT("Feature not supported: %s\n", \
+							LL_L_FEATURE(x)); \
+					abort(); \
+				} \
+				return false; \
 			}
 
 		FEATURE(lc_direction);
 		FEATURE(lc_deduplicate);
 		FEATURE(lc_no_properties);
+		FEATURE(lc_reorder_gorder);
+		FEATURE(lc_numa_interleave);
 
 		if (direct) FEATURE(lc_reverse_edges);
 		if (direct) FEATURE(lc_reverse_maps);
@@ -165,26 +227,6 @@ public:
 
 #		undef FEATURE
 
-		for (size_t i = 0; i < enabled_features.size(); i++) {
-			bool ok = false;
-			for (size_t k = 0; k < features.size(); k++) {
-				if (enabled_features[i] == features[k]) {
-					ok = true;
-					break;
-				}
-			}
-			if (!ok) {
-				if (error) {
-					LL_E_PRINT("Feature not supported: %s\n",
-							enabled_feature_names[i].c_str());
-					abort();
-				}
-				else {
-					return false;
-				}
-			}
-		}
-
 		if (lc_partial_load_num_parts > 0) {
 			if (lc_partial_load_part <= 0
 					|| lc_partial_load_part > lc_partial_load_num_parts) {
@@ -56,17 +56,25 @@ public:
 	/**
 	 * Create a new database instance, or load it if it exists
 	 *
+	 * The writable graph is created lazily on the first call to graph(),
+	 * so instantiating a database (e.g. in tests that only touch the
+	 * storage or the config) does not pay for the vertex table
+	 *
 	 * @param dir the database directory (if it is a persistent database)
+	 * @param max_nodes the maximum number of nodes (0 = the default)
 	 */
-	ll_database(const char* dir = NULL) {
+	ll_database(const char* dir = NULL, size_t max_nodes = 0) {
 
-		omp_set_num_threads(omp_get_max_threads());
+		// Note: no omp_set_num_threads() here -- the runtime already
+		// defaults to the max, and overriding it clobbered any
+		// OMP_NUM_THREADS setting from the environment; callers that
+		// want a specific count use set_num_threads()
 
 		_dir = IFE_LL_PERSISTENCE(dir == NULL ? "db" : dir, "");
 		IF_LL_PERSISTENCE(_storage = new ll_persistent_storage(_dir.c_str()));
 
-		_graph = new ll_writable_graph(this, IF_LL_PERSISTENCE(_storage,)
-				80 * 1000000 /* XXX */);
+		_graph = NULL;
+		_max_nodes = max_nodes != 0 ? max_nodes : 80 * 1000000 /* XXX */;
 	}
 
 
@@ -120,6 +128,10 @@ public:
 	 * @return the graph
 	 */
 	inline ll_writable_graph* graph() {
+		if (_graph == NULL) {
+			_graph = new ll_writable_graph(this,
+					IF_LL_PERSISTENCE(_storage,) _max_nodes);
+		}
 		return _graph;
 	}
 
@@ -136,9 +148,12 @@ public:
 
 private:
 
-	/// The graph
+	/// The graph (created lazily by graph())
 	ll_writable_graph* _graph;
 
+	/// The maximum number of nodes for the writable graph
+	size_t _max_nodes;
+
 	/// The persistent storage
 	IF_LL_PERSISTENCE(ll_persistent_storage* _storage);
 
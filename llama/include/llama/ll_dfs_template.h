@@ -73,37 +73,123 @@
 
 #include <omp.h>
 #include <string.h>
-#include <set>
-#include <unordered_set>
+#include <algorithm>
 #include <vector>
 
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
 
-template<class Graph, bool has_pre_visit, bool has_post_visit, bool has_navigator, bool use_reverse_edge>
+/*
+ * The visit hooks are dispatched statically (CRTP): Derived is the
+ * concrete algorithm class and must provide visit_pre, visit_post and
+ * check_navigator as accessible non-virtual members. The hooks inline
+ * into main_loop, so a trivial hook costs nothing instead of an
+ * indirect call per visited node.
+ */
+template<class Derived, class Graph, bool has_pre_visit, bool has_post_visit, bool has_navigator, bool use_reverse_edge>
 class ll_dfs_template
 {
-  protected:
-    virtual void visit_pre(node_t t)=0;
-    virtual void visit_post(node_t t)=0;
-    virtual bool check_navigator(node_t t, edge_t idx)=0;
-
   public:
     ll_dfs_template(Graph& _G) :
             G(_G) {
         visited_bitmap = NULL; // bitmap
+        visited_bitmap_size = 0;
+        visited_bitmap_mapped = false;
+        visited_external = false;
+        id_perm = NULL;
+
+        stack_hot = NULL;
+        stack_cold = NULL;
+        stack_top = 0;
+        stack_capacity = 0;
     }
 
     virtual ~ll_dfs_template() {
-        delete visited_bitmap;
+        free_bitmap();
+        free(stack_hot);
+        free(stack_cold);
     }
 
     void prepare(node_t root_node) {
         root = root_node;
         cnt = 0;
-        visited_small.clear();
-
-        is_small = true;
 		iter.node = INVALID_NODE;
-        THRESHOLD_LARGE = std::max((int)(G.max_nodes()*0.1), 4096); 
+
+        // A DFS path can visit every node once, so max_nodes frames is
+        // the exact worst case; the arrays are plain untouched virtual
+        // memory until the traversal actually goes that deep, and a
+        // push is a single store with no capacity branch
+
+        if (stack_capacity < (size_t) G.max_nodes()) {
+            free(stack_hot);
+            free(stack_cold);
+            stack_capacity = G.max_nodes();
+            stack_hot = (hot_state*)
+                malloc(sizeof(hot_state) * stack_capacity);
+            stack_cold = (cold_state*)
+                malloc(sizeof(cold_state) * stack_capacity);
+        }
+        stack_top = 0;
+
+        // A shared bitmap is owned, zeroed and freed by the caller that
+        // attached it (see ll_parallel_dfs)
+
+        if (visited_external) return;
+
+        // The bitmap is the faster membership structure at every size --
+        // a bit test is one L1 load, with no hashing and no is_small
+        // branch per step -- so use it from the start: allocate it once
+        // per graph size and just re-zero it in parallel on every run
+
+        // Rounded up to whole 64-bit words so that next_unvisited() and
+        // the vector zeroing below can read and write full words
+
+        size_t size = ((G.max_nodes() + 63) / 64) * 8;
+        if (visited_bitmap == NULL || visited_bitmap_size < size) {
+            free_bitmap();
+
+            // Prefer 2MB pages: the bitmap is probed at random indices,
+            // so on multi-megabyte bitmaps nearly every probe costs a
+            // dTLB walk with 4KB pages
+
+            visited_bitmap = (unsigned char*) ll_mmap_hugepages(size);
+            visited_bitmap_mapped = visited_bitmap != NULL;
+
+            if (visited_bitmap == NULL) {
+                // Cache-line aligned, so the vector stores below line up
+                if (posix_memalign((void**) &visited_bitmap, 64, size)
+                        != 0) {
+                    visited_bitmap = NULL;
+                    abort();
+                }
+            }
+            visited_bitmap_size = size;
+        }
+
+#ifdef __AVX2__
+        // Non-temporal 32-byte stores: the bitmap is written once and
+        // read much later, so bypass the cache and skip the
+        // read-for-ownership traffic a cached store would cause
+        #pragma omp parallel
+        {
+            #pragma omp for schedule(static) nowait
+            for (ssize_t i = 0; i < (ssize_t) (size & ~(size_t) 31);
+                    i += 32) {
+                _mm256_stream_si256((__m256i*) (visited_bitmap + i),
+                        _mm256_setzero_si256());
+            }
+            _mm_sfence();
+        }
+        memset(visited_bitmap + (size & ~(size_t) 31), 0, size & 31);
+#else
+        #pragma omp parallel for schedule(static)
+        for (ssize_t i = 0; i < (ssize_t) size; i += 16384) {
+            size_t n = size - i < 16384 ? size - i : 16384;
+            memset(visited_bitmap + i, 0, n);
+        }
+#endif
     }
 
     void do_dfs() {
@@ -111,48 +197,158 @@ class ll_dfs_template
         main_loop();
     }
 
-  private:
-    void prepare_large() {
-        delete[] visited_bitmap;
+    /**
+     * Find the first unvisited node at or after the given one, for the
+     * standard "for each unvisited v: run DFS(v)" component driver.
+     * Scans the visited bitmap one 64-bit word at a time and finds the
+     * bit with ctz, so a fully visited megabyte costs a linear word
+     * scan, not a per-node loop. Only meaningful between prepare() and
+     * the next prepare(), and without a visited permutation set (the
+     * scan works in bitmap index space).
+     *
+     * @param from the node to start the scan at
+     * @return the next unvisited node, or INVALID_NODE if none
+     */
+    node_t next_unvisited(node_t from) {
 
-        visited_bitmap = new unsigned char[(G.max_nodes() + 7) / 8];
+        if (visited_bitmap == NULL || from < 0) return INVALID_NODE;
 
-        #pragma omp parallel for schedule(dynamic,16384)
-        for (int i = 0; i < (G.max_nodes() + 7) / 8; i++)
-            visited_bitmap[i] = 0;
+        const uint64_t* b = (const uint64_t*) visited_bitmap;
+        node_t max = G.max_nodes();
+        node_t num_words = (max + 63) >> 6;
+        node_t first = from >> 6;
 
-        std::unordered_set<node_t>::iterator I;
-        for (I = visited_small.begin(); I != visited_small.end(); I++) {
-            node_t u = *I;
-            _ll_set_bit(visited_bitmap, u);
+        for (node_t i = first; i < num_words; i++) {
+            uint64_t w = ~b[i];
+            if (i == first) w &= ~0ull << (from & 63);
+            if (w != 0) {
+                node_t r = (i << 6) + __builtin_ctzll(w);
+                return r < max ? r : INVALID_NODE;
+            }
         }
-        is_small = false;
-        stack.reserve(G.max_nodes());
+
+        return INVALID_NODE;
+    }
+
+
+    /**
+     * Index the visited bitmap through the given node permutation
+     * (length max_nodes), so that frequently visited vertices can share
+     * bitmap cache lines; NULL disables the remapping. The permutation
+     * is only used inside this class -- the graph is untouched -- and
+     * must stay alive for as long as it is set.
+     */
+    void set_visited_permutation(const node_t* perm) {
+        id_perm = perm;
     }
 
-    void enter_node(node_t n) {
-        // push current node
-        stack.push_back(iter);
+    /**
+     * Share an externally owned visited bitmap (see ll_parallel_dfs):
+     * this instance stops allocating, zeroing or freeing the bitmap and
+     * marks bits with an atomic OR, so several instances can traverse
+     * concurrently. Call detach_shared_visited() before the owner frees
+     * the bitmap.
+     */
+    void attach_shared_visited(unsigned char* bitmap, size_t size) {
+        free_bitmap();
+        visited_bitmap = bitmap;
+        visited_bitmap_size = size;
+        visited_external = true;
+    }
+
+    /**
+     * Detach from a shared visited bitmap
+     */
+    void detach_shared_visited() {
+        if (!visited_external) return;
+        visited_bitmap = NULL;
+        visited_bitmap_size = 0;
+        visited_external = false;
+    }
+
+    /**
+     * Build a degree-descending permutation for
+     * set_visited_permutation(): high-degree vertices, which dominate
+     * the membership tests on skewed graphs, get the lowest IDs and
+     * thus cluster into the first bitmap bytes. Build it once per graph
+     * and reuse it across DFS runs.
+     */
+    void build_visited_permutation(std::vector<node_t>& perm) {
+        node_t n = G.max_nodes();
+
+        std::vector<node_t> order(n);
+        for (node_t i = 0; i < n; i++) order[i] = i;
+        std::sort(order.begin(), order.end(), by_degree_desc(G));
+
+        perm.resize(n);
+        for (node_t i = 0; i < n; i++) perm[order[i]] = i;
+    }
+
+  private:
+
+    /**
+     * Comparator for build_visited_permutation()
+     */
+    struct by_degree_desc {
+        Graph& G;
+        by_degree_desc(Graph& g) : G(g) {}
+        bool operator() (node_t a, node_t b) {
+            return G.out_degree(a) > G.out_degree(b);
+        }
+    };
+
+    void enter_node(node_t n, bool mark = true) {
+        // push current node, hot and cold halves separately
+        hot_state& h = stack_hot[stack_top];
+        h.node = iter.node;
+        h.edge = iter.edge;
+
+        cold_state& c = stack_cold[stack_top];
+        c.owner = iter.owner;
+        c.left = iter.left;
+        c.ptr = iter.ptr;
+        c.last_node = iter.last_node;
+#ifdef LL_DELETIONS
+        c.max_level = iter.max_level;
+#endif
+        stack_top++;
 
 		if (use_reverse_edge)
 			G.in_iter_begin_fast(iter, n);
 		else
 			G.out_iter_begin(iter, n);
 
-        // mark visited
-        add_visited(n);
+        // mark visited (unless main_loop already did, fused with the
+        // membership test)
+        if (mark) add_visited(n);
         cnt++;
-        if (cnt == THRESHOLD_LARGE) {
-            prepare_large();
-        }
 
-        if (has_pre_visit) visit_pre(n);
+        if (has_pre_visit) static_cast<Derived*>(this)->visit_pre(n);
     }
 
     void exit_node(node_t n) {
-        if (has_post_visit) visit_post(n);
-        iter = stack.back();
-        stack.pop_back();
+        if (has_post_visit) static_cast<Derived*>(this)->visit_post(n);
+
+        stack_top--;
+
+        const hot_state& h = stack_hot[stack_top];
+        iter.node = h.node;
+        iter.edge = h.edge;
+
+        // An exhausted parent (edge == LL_NIL_EDGE) will be exited right
+        // away by main_loop, which only looks at node and edge -- so skip
+        // pulling its cold line into the cache at all
+
+        if (h.edge == LL_NIL_EDGE) return;
+
+        const cold_state& c = stack_cold[stack_top];
+        iter.owner = c.owner;
+        iter.left = c.left;
+        iter.ptr = c.ptr;
+        iter.last_node = c.last_node;
+#ifdef LL_DELETIONS
+        iter.max_level = c.max_level;
+#endif
     }
 
     void main_loop() {
@@ -182,52 +378,183 @@ class ll_dfs_template
 				assert(e != LL_NIL_EDGE);
 				z = iter.last_node;
 
-                if (has_visited(z)) {
-                    continue;
+                // Peek at the neighbor one step ahead -- for a read-only
+                // CSR iterator, iter.ptr already points at the next
+                // adjacency slot, which the iterator itself keeps warm --
+                // and prefetch its visited-bitmap byte, so the membership
+                // test of the next iteration does not stall on a random
+                // DRAM load
+
+                if (iter.edge != LL_NIL_EDGE && iter.ptr != NULL
+                        && iter.owner == LL_I_OWNER_RO_CSR) {
+                    node_t z_next = (node_t)
+                        LL_VALUE_PAYLOAD(*((node_t*) iter.ptr));
+                    if (id_perm != NULL) z_next = id_perm[z_next];
+                    __builtin_prefetch(&visited_bitmap[z_next >> 3], 0, 0);
                 }
+
                 if (has_navigator) {
-                    if (check_navigator(z, e) == false) {
+                    if (has_visited(z)) {
+                        continue;
+                    }
+                    if (static_cast<Derived*>(this)->check_navigator(z, e)
+                            == false) {
+                        continue;
+                    }
+                    enter_node(z);
+                }
+                else {
+                    // Without a navigator the test and the mark fuse
+                    // into one read-modify-write of the bitmap byte,
+                    // instead of a load here and a second round-trip
+                    // inside enter_node. (With a navigator the mark must
+                    // wait: a rejected node has to stay unvisited.)
+                    if (visited_test_and_set(z)) {
                         continue;
                     }
+                    enter_node(z, false);
                 }
-                enter_node(z);
                 continue;
             }
         }
     }
 
+    void free_bitmap() {
+        if (visited_external) {
+            detach_shared_visited();
+            return;
+        }
+        if (visited_bitmap == NULL) return;
+        if (visited_bitmap_mapped)
+            munmap(visited_bitmap, visited_bitmap_size);
+        else
+            free(visited_bitmap);
+        visited_bitmap = NULL;
+        visited_bitmap_size = 0;
+    }
+
     void add_visited(node_t n) {
-        if (is_small)
-            visited_small.insert(n);
+        if (id_perm != NULL) n = id_perm[n];
+        if (visited_external) {
+            // Concurrent traversals share the bitmap; only the mark
+            // needs to be atomic
+            __sync_fetch_and_or(&visited_bitmap[n >> 3],
+                    (unsigned char) (1u << (n & 7)));
+        }
         else
             _ll_set_bit(visited_bitmap, n);
     }
 
     bool has_visited(node_t n) {
-        if (is_small) {
-            return (visited_small.find(n) != visited_small.end());
-        } else {
-            return _ll_get_bit(visited_bitmap, n);
+        if (id_perm != NULL) n = id_perm[n];
+        return _ll_get_bit(visited_bitmap, n);
+    }
+
+    bool visited_test_and_set(node_t n) {
+        if (id_perm != NULL) n = id_perm[n];
+        unsigned char m = (unsigned char) (1u << (n & 7));
+        if (visited_external) {
+            return __sync_fetch_and_or(&visited_bitmap[n >> 3], m) & m;
         }
+        unsigned char& c = visited_bitmap[n >> 3];
+        bool was = c & m;
+        c |= m;
+        return was;
     }
 
   protected:
     node_t root;
     Graph& G;
 
-    // stack implementation
-    node_t stack_ptr;
-    std::vector<ll_edge_iterator> stack;
+    // stack implementation: the node/edge pair that main_loop probes on
+    // every iteration is kept apart from the cold remainder of the saved
+    // iterator, so the hot stack packs four entries per cache line
+    // instead of one and a half
+
+    struct hot_state {
+        node_t node;
+        edge_t edge;
+    };
+
+    struct cold_state {
+        int owner;
+        size_t left;
+        const void* ptr;
+        node_t last_node;
+#ifdef LL_DELETIONS
+        size_t max_level;
+#endif
+    };
+
+    hot_state* stack_hot;
+    cold_state* stack_cold;
+    size_t stack_top;
+    size_t stack_capacity;
 	ll_edge_iterator iter;
 
     // visited set implementation
     node_t cnt;
     unsigned char* visited_bitmap;
-    std::unordered_set<node_t> visited_small;
-    bool is_small;
-    int THRESHOLD_LARGE;
+    size_t visited_bitmap_size;
+    bool visited_bitmap_mapped;
+    bool visited_external;
+    const node_t* id_perm;
     static const node_t INVALID_NODE = -1;
 
 };
 
+
+/**
+ * Run DFS traversals from many sub-roots in parallel: one worker
+ * instance per thread, each with its private stack and iterator, all
+ * sharing a single visited bitmap with atomic marking. Sub-roots are
+ * claimed from a shared cursor, so an already-covered root is skipped
+ * cheaply.
+ *
+ * This trades DFS ordering for parallelism: visits across workers are
+ * unordered, and two workers racing on the same node can occasionally
+ * both visit it, so the algorithm's hooks must tolerate duplicate
+ * visits. Use it for coverage-style computations (reachability,
+ * component seeding), not for algorithms that rely on depth-first
+ * pre/post order.
+ *
+ * @param workers one DFS instance per thread, all over the same graph
+ * @param roots the sub-roots to cover
+ * @param max_nodes the graph's max_nodes()
+ */
+template <class DFS>
+void ll_parallel_dfs(std::vector<DFS*>& workers,
+        const std::vector<node_t>& roots, size_t max_nodes) {
+
+    size_t bytes = (max_nodes + 7) / 8;
+
+    unsigned char* bitmap = (unsigned char*) ll_mmap_hugepages(bytes);
+    bool mapped = bitmap != NULL;
+    if (!mapped) bitmap = (unsigned char*) calloc(bytes, 1);
+    // (a fresh anonymous mapping is already zero-filled)
+
+    volatile size_t cursor = 0;
+
+    #pragma omp parallel num_threads((int) workers.size())
+    {
+        DFS* d = workers[omp_get_thread_num()];
+        d->attach_shared_visited(bitmap, bytes);
+
+        for (;;) {
+            size_t i = __sync_fetch_and_add(&cursor, 1);
+            if (i >= roots.size()) break;
+
+            node_t r = roots[i];
+            if (_ll_get_bit(bitmap, r)) continue;
+
+            d->prepare(r);
+            d->do_dfs();
+        }
+
+        d->detach_shared_visited();
+    }
+
+    if (mapped) munmap(bitmap, bytes); else free(bitmap);
+}
+
 #endif
@@ -57,6 +57,32 @@ template <typename T> struct ll_et_array {
 	T _values[1];		/* must be the ONLY member */
 
 
+	/**
+	 * Get the value array with its alignment made known to the compiler:
+	 * new_ll_et_array() places _values on a 64-byte boundary, and telling
+	 * the optimizer lets loops over edge values use aligned vector loads.
+	 * (The persistence manager makes no such promise, so the hint is
+	 * only given for the in-memory tables.)
+	 *
+	 * @return the value array
+	 */
+	inline T* values() {
+#ifdef LL_PERSISTENCE
+		return _values;
+#else
+		return (T*) __builtin_assume_aligned(_values, 64);
+#endif
+	}
+
+	inline const T* values() const {
+#ifdef LL_PERSISTENCE
+		return _values;
+#else
+		return (const T*) __builtin_assume_aligned(_values, 64);
+#endif
+	}
+
+
 	/**
 	 * Access an element based on the index
 	 *
@@ -64,7 +90,7 @@ template <typename T> struct ll_et_array {
 	 * @return the reference to the element
 	 */
 	inline T& operator[] (edge_t index) {
-		return _values[index];
+		return values()[index];
 	}
 
 
@@ -75,7 +101,7 @@ template <typename T> struct ll_et_array {
 	 * @return the reference to the element
 	 */
 	inline const T& operator[] (edge_t index) const {
-		return _values[index];
+		return values()[index];
 	}
 
 
@@ -87,7 +113,7 @@ template <typename T> struct ll_et_array {
 	 * @return the reference to the element
 	 */
 	inline T& edge_value(node_t node, edge_t edge) {
-		return _values[edge];
+		return values()[edge];
 	}
 
 
@@ -99,7 +125,7 @@ template <typename T> struct ll_et_array {
 	 * @return the reference to the element
 	 */
 	inline const T& edge_value(node_t node, edge_t edge) const {
-		return _values[edge];
+		return values()[edge];
 	}
 
 
@@ -111,7 +137,7 @@ template <typename T> struct ll_et_array {
 	 * @return the pointer to the element
 	 */
 	inline T* edge_ptr(node_t node, edge_t edge) {
-		return &_values[edge];
+		return &values()[edge];
 	}
 
 
@@ -123,7 +149,7 @@ template <typename T> struct ll_et_array {
 	 * @return the pointer to the element
 	 */
 	inline const T* edge_ptr(node_t node, edge_t edge) const {
-		return &_values[edge];
+		return &values()[edge];
 	}
 
 
@@ -174,16 +200,43 @@ template <typename T> struct ll_et_array {
 #else
 
 		if (advice == LL_ADV_WILLNEED) {
-			__builtin_prefetch(&_values[from]);
-			__builtin_prefetch(&_values[from+1]);
+
+			// One prefetch per cache line over the whole range -- the
+			// old two-element version only warmed the first line. Cap
+			// the number of lines so a huge range does not flood the
+			// fill buffers with prefetches that will be evicted before
+			// the caller gets to them anyway.
+
+			const size_t per_line = 64 / sizeof(T) > 0 ? 64 / sizeof(T) : 1;
+			const size_t max_lines = 4096;
+
+			edge_t end = to;
+			if ((size_t) (to - from) > per_line * max_lines)
+				end = from + per_line * max_lines;
+
+			for (edge_t i = from; i < end; i += per_line)
+				__builtin_prefetch(&_values[i], 0, 1);
 		}
 #endif
 	}
 };
 
 
+/*
+ * Large edge tables go on hugepages. The struct cannot carry any member
+ * besides _values, so the allocation size and kind are recorded in one
+ * cache line in front of the returned struct, written and read only by
+ * the new/delete pair below.
+ */
+#define LL_ET_ALLOC_PREFIX			64
+#define LL_ET_HUGEPAGE_THRESHOLD	(2ul * 1048576)
+
+
 /**
- * Create a new instance of ll_et_array
+ * Create a new instance of ll_et_array. Allocations of 2MB and above are
+ * placed on hugepages (see ll_mmap_hugepages) -- the edge table is the
+ * main memory-bound structure, so it benefits the most from the lower
+ * TLB pressure.
  *
  * @param capacity the capacity
  * @param max_nodes the number of nodes
@@ -191,9 +244,34 @@ template <typename T> struct ll_et_array {
  */
 template <typename T>
 ll_et_array<T>* new_ll_et_array(size_t capacity, size_t max_nodes) {
-	ll_et_array<T>* et = (ll_et_array<T>*) malloc(sizeof(ll_et_array<T>)
-			+ capacity * sizeof(T));
-	return et;
+
+	size_t bytes = LL_ET_ALLOC_PREFIX + sizeof(ll_et_array<T>)
+		+ capacity * sizeof(T);
+
+	void* p = NULL;
+	size_t mapped = 0;
+
+	if (bytes >= LL_ET_HUGEPAGE_THRESHOLD) {
+		p = ll_mmap_hugepages(bytes);
+		if (p != NULL) {
+			mapped = 1;
+			if (ll_numa_interleave_enabled()) ll_numa_interleave(p, bytes);
+		}
+	}
+	if (p == NULL) {
+		// 64-byte aligned so that _values (at the prefix offset) lands
+		// on a cache-line boundary; see ll_et_array::values()
+		if (posix_memalign(&p, LL_ET_ALLOC_PREFIX, bytes) != 0) p = NULL;
+	}
+	if (p == NULL) {
+		LL_E_PRINT("** OUT OF MEMORY **\n");
+		abort();
+	}
+
+	((size_t*) p)[0] = bytes;
+	((size_t*) p)[1] = mapped;
+
+	return (ll_et_array<T>*) (((char*) p) + LL_ET_ALLOC_PREFIX);
 }
 
 
@@ -204,7 +282,68 @@ ll_et_array<T>* new_ll_et_array(size_t capacity, size_t max_nodes) {
  */
 template <typename T>
 void delete_ll_et_array(ll_et_array<T>* et) {
-	free(et);
+	void* p = ((char*) et) - LL_ET_ALLOC_PREFIX;
+	if (((size_t*) p)[1]) {
+		munmap(p, ((size_t*) p)[0]);
+	}
+	else {
+		free(p);
+	}
+}
+
+
+
+//==========================================================================//
+// Class: ll_et_quant                                                       //
+//==========================================================================//
+
+/**
+ * A compact edge table that stores values in a narrow type and promotes
+ * them on read. For algorithms whose edge values are small counts, storing
+ * them as e.g. int8_t instead of int moves a quarter of the bytes from
+ * DRAM in edge-weight scans, which is where the time goes once the rest
+ * of the graph fits in cache. The layout is exactly ll_et_array<Tstore>,
+ * so the new/delete helpers and the rest of the edge table machinery
+ * apply unchanged; get() is the promoting accessor for compute loops.
+ */
+template <typename Tstore, typename Tcompute>
+struct ll_et_quant : ll_et_array<Tstore> {
+
+	/**
+	 * Get an element promoted to the compute type
+	 *
+	 * @param edge the edge index
+	 * @return the value as Tcompute
+	 */
+	inline Tcompute get(edge_t edge) const {
+		return (Tcompute) this->values()[edge];
+	}
+};
+
+
+/**
+ * Create a new instance of ll_et_quant
+ *
+ * @param capacity the capacity
+ * @param max_nodes the number of nodes
+ * @return the new instance
+ */
+template <typename Tstore, typename Tcompute>
+ll_et_quant<Tstore, Tcompute>* new_ll_et_quant(size_t capacity,
+		size_t max_nodes) {
+	return (ll_et_quant<Tstore, Tcompute>*)
+		new_ll_et_array<Tstore>(capacity, max_nodes);
+}
+
+
+/**
+ * Destroy an instance of ll_et_quant
+ *
+ * @param et the edge table
+ */
+template <typename Tstore, typename Tcompute>
+void delete_ll_et_quant(ll_et_quant<Tstore, Tcompute>* et) {
+	delete_ll_et_array<Tstore>(et);
 }
 
 
@@ -37,18 +37,15 @@
 #ifndef LL_EXTERNAL_SORT_H_
 #define LL_EXTERNAL_SORT_H_
 
-#if defined(__linux__)
-#	include <sys/sysinfo.h>
-#elif defined(__NetBSD__)
-#	include <sys/param.h>
-#  	include <sys/sysctl.h>
-#	include <uvm/uvm_extern.h>
-#elif defined(__APPLE__)
+#if defined(__APPLE__)
 #	include <mach/mach.h>
-#else
 #endif
 
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/time.h>
+#include <fcntl.h>
+#include <pthread.h>
 
 #include <algorithm>
 #include <cassert>
@@ -65,14 +62,43 @@
 #include <omp.h>
 
 #include "llama/ll_config.h"
+#include "llama/ll_lock.h"
 
 
 // Low-level configuration
 
 //#define LL_XS_DEBUG_PERFORMANCE
-//#define LL_XS_HIERARCHICAL_MERGE
 #define LL_XS_MULTICORE_SORT
 
+/*
+ * The maximum merge fan-in. Merging more runs than this at once costs one
+ * run buffer per input, and the pages backing the active block of every
+ * run compete for the same cache; above the cap, sort() first reduces the
+ * run count with intermediate merge rounds of this fan-in. With the loser
+ * tree the extra rounds cost O(log_F N) passes over the data, which beats
+ * thrashing the buffers once N is in the hundreds.
+ */
+#define LL_XS_MAX_FAN_IN 16
+
+
+/*
+ * Define LL_XS_COMPRESS (and link with -llz4) to compile in optional LZ4
+ * compression of the spilled runs; see XS_COMPRESS in benchmark/Makefile.
+ * It is off by default so the tree keeps building without the library.
+ * When compiled in, compression is still opt-in at runtime through
+ * ll_loader_config::lc_xs_compress: each spill is cut into frames of a
+ * pair of uint32 lengths (compressed, raw) followed by the compressed
+ * payload, halving the disk bandwidth of the merge phase for typical
+ * edge data at a fraction of the disk's throughput in CPU cost.
+ */
+#ifdef LL_XS_COMPRESS
+#	include <lz4.h>
+
+// The maximum uncompressed payload of one spill frame, in bytes (rounded
+// down to whole elements; see frame_bytes())
+#	define LL_XS_FRAME_RAW		65536
+#endif
+
 
 #ifdef LL_XS_DEBUG_PERFORMANCE
 
@@ -88,6 +114,200 @@ inline double __get_time_ms() {
 #endif
 
 
+/**
+ * Detect whether the comparator exposes a static uint64_t key64(const T&)
+ * accessor: an order-preserving 64-bit key prefix of the sort order
+ * (key64(a) < key64(b) must imply that a sorts before b; equal keys are
+ * tie-broken by the comparator itself). Comparators that provide it get
+ * the radix-based partition sort below instead of std::sort.
+ */
+template <typename Comparator, typename T>
+class ll_xs_has_key64 {
+
+	template <typename X>
+	static char test(int (*)[sizeof(decltype(X::key64(*(const T*) 0)))]);
+
+	template <typename X>
+	static int test(...);
+
+public:
+
+	static const bool value = sizeof(test<Comparator>(0)) == sizeof(char);
+};
+
+
+/**
+ * Extract the comparator's 64-bit key prefix of a record, or 0 when the
+ * comparator has none (so cached-key compares degenerate to a tie and
+ * fall through to the comparator)
+ */
+template <typename T, class Comparator, bool HasKey>
+struct ll_xs_key_of {
+	static inline uint64_t key(const T& x) { return 0; }
+};
+
+template <typename T, class Comparator>
+struct ll_xs_key_of<T, Comparator, true> {
+	static inline uint64_t key(const T& x) { return Comparator::key64(x); }
+};
+
+
+/**
+ * The length of the sorted prefix of a buffer
+ *
+ * @param buffer the buffer
+ * @param n the number of elements
+ * @param comparator the comparator
+ * @return the number of leading elements already in order (at least 1)
+ */
+template <typename T, class Comparator>
+inline size_t ll_xs_sorted_prefix(const T* buffer, size_t n,
+		Comparator& comparator) {
+	size_t k = 1;
+	while (k < n && !comparator(buffer[k], buffer[k - 1])) k++;
+	return k;
+}
+
+
+/**
+ * Sort one in-memory partition. The generic version is a plain
+ * comparator-based std::sort; the specialization below kicks in when the
+ * comparator provides key64() and replaces the O(n log n) comparison sort
+ * with an LSD radix sort on 8-bit digits of the key -- counting passes
+ * stream sequentially and never mispredict, the same trade
+ * ll_sort_edges_radix makes for raw edge lists.
+ *
+ * Both versions first look for a long pre-sorted (or reversed) prefix:
+ * edge lists are commonly already ordered by source vertex, and one
+ * sequential comparison pass is far cheaper than re-sorting data that is
+ * in order.
+ */
+template <typename T, class Comparator, bool HasKey>
+struct ll_xs_partition_sort {
+
+	static void sort(T* buffer, size_t n, Comparator& comparator) {
+
+		if (n < 2) return;
+
+		if (comparator(buffer[1], buffer[0])) {
+
+			// A strictly descending run reverses into a sorted prefix
+
+			size_t k = 2;
+			while (k < n && comparator(buffer[k], buffer[k - 1])) k++;
+			if (k >= n / 2) std::reverse(buffer, buffer + k);
+		}
+
+		size_t k = ll_xs_sorted_prefix(buffer, n, comparator);
+		if (k == n) return;
+
+		if (k >= n / 2) {
+
+			// Long sorted prefix: sort only the tail and merge it in
+
+			std::sort(buffer + k, buffer + n, comparator);
+			std::inplace_merge(buffer, buffer + k, buffer + n, comparator);
+			return;
+		}
+
+		std::sort(buffer, buffer + n, comparator);
+	}
+};
+
+template <typename T, class Comparator>
+struct ll_xs_partition_sort<T, Comparator, true> {
+
+	static void sort(T* buffer, size_t n, Comparator& comparator) {
+
+		if (n < 2) return;
+
+		if (ll_xs_sorted_prefix(buffer, n, comparator) == n) return;
+
+
+		// Find the largest key, so digit positions above it are skipped
+
+		uint64_t max_key = 0;
+		for (size_t i = 0; i < n; i++) {
+			uint64_t k = Comparator::key64(buffer[i]);
+			if (k > max_key) max_key = k;
+		}
+
+		T* scratch = (T*) malloc(sizeof(T) * n);
+		if (scratch == NULL) {
+			// Better slow than dead
+			std::sort(buffer, buffer + n, comparator);
+			return;
+		}
+
+		T* src = buffer;
+		T* dst = scratch;
+
+		size_t count[256];
+
+		// Software write-combining staging for the scatter: the naive
+		// scatter keeps 256 partially-written cache lines live at once
+		// and thrashes L1/the fill buffers. Instead, stage eight records
+		// per bucket in a cache-line-aligned block and flush them with
+		// one bulk copy, so each bucket writes one burst at a time.
+
+		T swc[256][8] __attribute__((aligned(64)));
+		unsigned char swc_n[256];
+
+		for (int shift = 0; (max_key >> shift) != 0; shift += 8) {
+
+			memset(count, 0, sizeof(count));
+			for (size_t i = 0; i < n; i++) {
+				count[(Comparator::key64(src[i]) >> shift) & 0xff]++;
+			}
+
+			size_t offset = 0;
+			for (size_t b = 0; b < 256; b++) {
+				size_t c = count[b];
+				count[b] = offset;
+				offset += c;
+			}
+
+			memset(swc_n, 0, sizeof(swc_n));
+
+			for (size_t i = 0; i < n; i++) {
+				size_t b = (Comparator::key64(src[i]) >> shift) & 0xff;
+				swc[b][swc_n[b]++] = src[i];
+				if (swc_n[b] == 8) {
+					memcpy(dst + count[b], swc[b], 8 * sizeof(T));
+					count[b] += 8;
+					swc_n[b] = 0;
+				}
+			}
+
+			for (size_t b = 0; b < 256; b++) {
+				if (swc_n[b] > 0) {
+					memcpy(dst + count[b], swc[b], swc_n[b] * sizeof(T));
+					count[b] += swc_n[b];
+				}
+			}
+
+			T* x = src; src = dst; dst = x;
+		}
+
+		if (src != buffer) memcpy(buffer, src, sizeof(T) * n);
+		free(scratch);
+
+
+		// The key is only a prefix of the sort order; fix up runs of
+		// equal keys with the full comparator (they are typically tiny)
+
+		size_t i = 0;
+		while (i < n) {
+			uint64_t k = Comparator::key64(buffer[i]);
+			size_t j = i + 1;
+			while (j < n && Comparator::key64(buffer[j]) == k) j++;
+			if (j - i > 1) std::sort(buffer + i, buffer + j, comparator);
+			i = j;
+		}
+	}
+};
+
+
 /**
  * External sort
  */
@@ -108,10 +328,51 @@ class ll_external_sort {
 
 	std::vector<int> _tmp_files;
 
-#ifndef LL_XS_HIERARCHICAL_MERGE
-	std::vector<T*> _tmp_buffers;
-	std::vector<size_t> _tmp_buffer_sizes;
-	std::vector<size_t> _tmp_buffer_index;
+	/**
+	 * All per-stream merge state packed into one cache line, so a loser
+	 * tree match touches a single line per contender instead of one line
+	 * for each of several parallel arrays. For in-memory streams (the
+	 * chunk merge in sort_buffer), index/size delimit the stream's range
+	 * in the shared buffer and block/offset/fd are unused.
+	 */
+	struct merge_cursor {
+		T* cur;			///< The current element; NULL when exhausted
+		uint64_t key;	///< The cached key prefix of *cur
+		T* block;		///< The run buffer (NULL for padding leaves)
+		size_t index;	///< The position of cur within the block
+		size_t size;	///< The number of elements in the block
+		size_t offset;	///< The file offset of the block's end
+		size_t map_bytes;	///< Nonzero when block is an mmap of the run
+		int fd;			///< The backing file; -1 if none
+#ifdef LL_XS_COMPRESS
+		char* cbuf;		///< The compressed-frame scratch, if compressing
+#endif
+	} __attribute__((aligned(64)));
+
+	// The run cursors (padded to _merge_p) and the loser tree over them;
+	// see build_merge_tree()
+
+	std::vector<merge_cursor> _cursors;
+	std::vector<uint32_t> _merge_losers;
+	size_t _merge_p;
+
+	// The spill pipeline: a background thread that sorts and writes a
+	// full buffer while the ingest thread keeps filling the other one
+	// (see spill_async). Handoff is single-producer/single-consumer
+	// through the two volatile pointers.
+
+	pthread_t _spill_thread;
+	bool _spill_started;
+	volatile bool _spill_exit;
+	T* volatile _spill_pending;
+	size_t _spill_pending_size;
+	T* volatile _spill_spare;
+	ll_spinlock_t _tmp_files_lock;
+
+#ifdef LL_XS_COMPRESS
+	// Optional LZ4 compression of the spilled runs (lc_xs_compress)
+	bool _compress;
+	char* _comp_scratch;
 #endif
 
 
@@ -131,6 +392,11 @@ public:
 
 		size_t xs_buffer_size = lc->lc_xs_buffer_size;
 
+#ifdef LL_XS_COMPRESS
+		_compress = lc->lc_xs_compress;
+		_comp_scratch = NULL;
+#endif
+
 		for (size_t i = 0; i < lc->lc_tmp_dirs.size(); i++) {
 			const char* d = lc->lc_tmp_dirs[i].c_str();
 			if (*d == '\0') {
@@ -163,44 +429,25 @@ public:
 
 			// Auto-tune
 
-#if defined(__linux__)
-			struct sysinfo s;
-			if (sysinfo(&s) < 0) {
-				perror("sysinfo");
-				abort();
-			}
+#if defined(_SC_AVPHYS_PAGES)
 
-			char buf[128];
-			FILE* f = fopen("/proc/meminfo", "r");
-			for (int i = 0; i <= 3; i++) {
-				if (fgets(buf, 128, f) == NULL) {
-					perror("fgets");
-					abort();
-				}
+			long pages = sysconf(_SC_AVPHYS_PAGES);
+			long page_size = sysconf(_SC_PAGESIZE);
+			if (pages < 0 || page_size < 0) {
+				perror("sysconf");
+				LL_E_PRINT("Cannot determine the amount of free memory\n");
+				abort();
 			}
-			char *p = strchr(buf, ':');
-			size_t cachedram = strtoull(p+1, NULL, 10) * 1024ull;
-			fclose(f);
-
-			size_t max = (((size_t) s.mem_unit) * (s.freeram + s.bufferram))
-				+ cachedram;
 
-#elif defined(__NetBSD__)
+			size_t max = (size_t) pages * (size_t) page_size;
 
-			struct uvmexp_sysctl u;
-			size_t u_len = sizeof(u);
 
-			int m[2];
-			m[0] = CTL_VM;
-			m[1] = VM_UVMEXP2;
-			
-			if (sysctl(m, 2, &u, &u_len, NULL, 0) != 0) {
-				perror("sysctl");
-				LL_E_PRINT("Cannot determine the amount of free memory\n");
-				abort();
-			}
+			// Respect the cgroup memory limit: under a container the
+			// host's free memory is meaningless, and sizing the buffer
+			// from it gets the process OOM-killed
 
-			size_t max = u.pagesize * (u.free + u.filepages);
+			size_t cg = cgroup_available_memory();
+			if (cg > 0 && cg < max) max = cg;
 
 #elif defined(__APPLE__)
 
@@ -242,19 +489,29 @@ public:
 #ifdef LL_XS_MULTICORE_SORT
 			b /= 2;
 #endif
+			// The spill pipeline fills a second buffer while the first
+			// is sorted and written, so budget for two of them
+			b /= 2;
 			//LL_I_PRINT("Buffer %0.2lf MB\n", b / 1048576.0);
 			_buffer_capacity = b / sizeof(T);
 		}
 
+		_spill_started = false;
+		_spill_exit = false;
+		_spill_pending = NULL;
+		_spill_pending_size = 0;
+		_spill_spare = NULL;
+		_tmp_files_lock = 0;
+
 		_buffer_size = 0;
-		_buffer = (T*) malloc(sizeof(T) * _buffer_capacity);
+		_buffer = alloc_buffer(_buffer_capacity);
 
 		if (_buffer == NULL) {
 			if (xs_buffer_size == 0) {
 				while (_buffer == NULL) {
 					LL_W_PRINT("Not enough memory, trying half\n");
 					_buffer_capacity /= 2;
-					_buffer = (T*) malloc(sizeof(T) * _buffer_capacity);
+					_buffer = alloc_buffer(_buffer_capacity);
 				}
 			}
 			else {
@@ -276,13 +533,17 @@ public:
 	 */
 	~ll_external_sort() {
 
-#ifndef LL_XS_HIERARCHICAL_MERGE
-		for (size_t i = 0; i < _tmp_buffers.size(); i++) {
-			free(_tmp_buffers[i]);
+		stop_spill_thread();
+
+		for (size_t i = 0; i < _cursors.size(); i++) {
+			release_cursor(_cursors[i]);
 		}
-#endif
 
-		free(_buffer);
+		free_buffer(_buffer);
+
+#ifdef LL_XS_COMPRESS
+		if (_comp_scratch != NULL) free(_comp_scratch);
+#endif
 
 		for (size_t i = 0; i < _tmp_files.size(); i++) {
 			close(_tmp_files[i]);
@@ -312,10 +573,8 @@ public:
 			fprintf(stderr, "ll_external_sort::operator<<: buffer >= capacity "
 					"(%lu >= %lu)\n", _buffer_size, _buffer_capacity);
 #endif
-			T* b = sort_buffer();
-			_tmp_files.push_back(write_buffer(b, _buffer_size));
+			spill_async(_buffer, _buffer_size);
 			_buffer_size = 0;
-			if (b != _buffer) free(b);
 		}
 
 		_buffer[_buffer_size++] = element;
@@ -328,224 +587,92 @@ public:
 	 */
 	void sort() {
 
+		stop_spill_thread();
+
 		if (_tmp_files.size() == 0) {
-			T* b = sort_buffer();
-			if (b != _buffer) free(_buffer);
-			_buffer = (T*) realloc(b, sizeof(T) * _buffer_size);	// shrink
+			T* b = sort_buffer(_buffer, _buffer_size);
+			if (b != _buffer) {
+				free_buffer(_buffer);
+				_buffer = b;
+			}
+
+			// The arena may be hugepage-mapped and cannot be realloc'd;
+			// give the dead tail back to the OS in place instead
+
+			shrink_buffer_to(_buffer_size);
 		}
 		else {
-			T* b = sort_buffer();
+			T* b = sort_buffer(_buffer, _buffer_size);
 			_tmp_files.push_back(write_buffer(b, _buffer_size));
 			_buffer_size = 0;
-			if (b != _buffer) free(b);
+			if (b != _buffer) free_buffer(b);
 		}
 
 
-#ifdef LL_XS_HIERARCHICAL_MERGE
+		// Too many runs: reduce their number with intermediate merge
+		// rounds before handing the rest to next_block. Each round walks
+		// groups of up to LL_XS_MAX_FAN_IN runs through the loser tree
+		// and spills each group into one new run, cycling through the
+		// temp dirs per round.
 
-		size_t block_size = _tmp_buffer_capacity;
-		size_t block_bytes = sizeof(T) * block_size;
-		T* blockA = (T*) malloc(block_bytes);
-		T* blockB = (T*) malloc(block_bytes);
-		T* outBuf = (T*) malloc(block_bytes * 2);
+		while (_tmp_files.size() > LL_XS_MAX_FAN_IN) {
 
-		while (_tmp_files.size() > 1) {
 			std::vector<int> new_tmp_files;
 			_phase++;
 
-			for (size_t i = 0; i + 1 < _tmp_files.size(); i += 2) {
-				ssize_t rA, rB, r;
-
-				size_t iA = 1;
-				size_t iB = 1;
-				size_t nA = 1;
-				size_t nB = 1;
-
-				size_t w = 0;
-				int f = temporary_file();
-
-				size_t num_read = 0;
-				size_t num_written = 0;
-
-				while (nA > 0 && nB > 0) {
-
-					// If ran out of A and there is more left, load more
-
-					if (iA >= nA && nA > 0) {
-						rA = read(_tmp_files[i], blockA, block_bytes);
-						if (rA < 0) {
-							perror("read");
-							LL_E_PRINT("read failed\n");
-							abort();
-						}
-						iA = 0;
-						nA = rA / sizeof(T);
-						num_read += nA;
-					}
-
-
-					// If ran out of B and there is more left, load more
-
-					if (iB >= nB && nB > 0) {
-						rB = read(_tmp_files[i+1], blockB, block_bytes);
-						if (rB < 0) {
-							perror("read");
-							LL_E_PRINT("read failed\n");
-							abort();
-						}
-						iB = 0;
-						nB = rB / sizeof(T);
-						num_read += nB;
-					}
-
-
-					// Merge loaded blocks A and B until we run out of
-					// at least one of them, or until the data needs to
-					// be written
-
-					while (iA < nA && iB < nB && w < block_size) {
-
-						if (_comparator(blockA[iA], blockB[iB])) {
-							outBuf[w++] = blockA[iA++];
-						}
-						else {
-							outBuf[w++] = blockB[iB++];
-						}
-					}
-
-
-					// Write the data if we the buffer is full
-
-					if (w >= block_size) {
-						r = write(f, outBuf, sizeof(T) * w);
-						if (r < sizeof(T) * w) {
-							perror("write");
-							LL_E_PRINT("write failed: returned %ld; "
-									"expected %ld\n", r, sizeof(T) * w);
-							abort();
-						}
-						num_written += w;
-						w = 0;
-					}
-				}
-
-
-				// Finish
-
-				int copy_from = 0;
-
-				if (nA > 0) {
-					assert(nA >= iA);
-					if (nA > iA) {
-						memcpy(&outBuf[w], &blockA[iA], sizeof(T)*(nA-iA));
-						w += nA - iA;
-					}
-					copy_from = _tmp_files[i];
-				}
-
-				if (nB > 0) {
-					assert(copy_from == 0);
-					assert(nB >= iB);
-					if (nB > iB) {
-						memcpy(&outBuf[w], &blockB[iB], sizeof(T)*(nB-iB));
-						w += nB - iB;
-					}
-					copy_from = _tmp_files[i+1];
-				}
-
-				if (w > 0) {
-					r = write(f, outBuf, sizeof(T) * w);
-					if (r < sizeof(T) * w) {
-						perror("write");
-						LL_E_PRINT("write failed: returned %ld; "
-								"expected %ld\n", r, sizeof(T) * w);
-						abort();
-					}
-					num_written += w;
-				}
-
-				if (copy_from != 0) {
-					while ((rA = read(copy_from, outBuf, block_bytes)) > 0) {
-						r = write(f, outBuf, rA);
-						if (r < rA) {
-							perror("write");
-							LL_E_PRINT("write failed: returned %ld; "
-									"expected %ld\n", r, rA);
-							abort();
-						}
-						num_read += rA / sizeof(T);
-						num_written += rA / sizeof(T);
-					}
-					if (rA < 0) {
-						perror("read");
-						LL_E_PRINT("read failed\n");
-						abort();
-					}
-				}
+			for (size_t i = 0; i < _tmp_files.size();
+					i += LL_XS_MAX_FAN_IN) {
 
-				close(_tmp_files[i]);
-				close(_tmp_files[i+1]);
+				size_t k = _tmp_files.size() - i;
+				if (k > LL_XS_MAX_FAN_IN) k = LL_XS_MAX_FAN_IN;
 
-				off_t t = lseek(f, 0, SEEK_SET);
-				if (t == (off_t) -1) {
-					perror("lseek");
-					LL_E_PRINT("lseek failed\n");
-					abort();
+				if (k == 1) {
+					new_tmp_files.push_back(_tmp_files[i]);
+					continue;
 				}
-				new_tmp_files.push_back(f);
-			}
 
-			if ((_tmp_files.size() & 1) == 1) {
-				new_tmp_files.push_back(_tmp_files[_tmp_files.size() - 1]);
+				new_tmp_files.push_back(merge_files(&_tmp_files[i], k));
+				for (size_t j = 0; j < k; j++) close(_tmp_files[i + j]);
 			}
 
 			_tmp_files.clear();
 			for (size_t i = 0; i < new_tmp_files.size(); i++)
 				_tmp_files.push_back(new_tmp_files[i]);
-			new_tmp_files.clear();
-		}
-
-		free(outBuf);
-		free(blockB);
-		free(blockA);
-
-		if (_tmp_files.size() >= 1) {
-			free(_buffer);
-			_buffer_capacity = _tmp_buffer_capacity;
-			_buffer = (T*) malloc(sizeof(T) * _buffer_capacity);
 		}
 
-#else
-
 		if (_tmp_files.size() >= 1) {
 
-			// Shrink the buffer
+			// Shrink the buffer in place: dropping and reallocating the
+			// arena would discard its page mappings and make the first
+			// next_block pay a soft-fault storm to build them back up
 
-			free(_buffer);
-			_buffer_capacity = _tmp_buffer_capacity;
-			_buffer = (T*) malloc(sizeof(T) * _buffer_capacity);
+			if (_tmp_buffer_capacity <= _buffer_capacity) {
+				shrink_buffer_to(_tmp_buffer_capacity);
+				_buffer_capacity = _tmp_buffer_capacity;
+			}
+			else {
+				free_buffer(_buffer);
+				_buffer_capacity = _tmp_buffer_capacity;
+				_buffer = alloc_buffer(_buffer_capacity);
+				if (_buffer == NULL) {
+					LL_E_PRINT("** OUT OF MEMORY **\n");
+					abort();
+				}
+			}
 
 
 			// Start the cursor for each file
 
-			for (size_t i = 0; i < _tmp_files.size(); i++) {
-
-				T* block = (T*) malloc(sizeof(T) * _tmp_buffer_capacity);
-
-				size_t r = read(_tmp_files[i], block,
-						sizeof(T) * _tmp_buffer_capacity);
-				if (r < 0) {
-					perror("read");
-					LL_E_PRINT("read failed\n");
-					abort();
-				}
+			_cursors.clear();
 
-				_tmp_buffers.push_back(block);
-				_tmp_buffer_sizes.push_back(r / sizeof(T));
-				_tmp_buffer_index.push_back(0);
+			for (size_t i = 0; i < _tmp_files.size(); i++) {
+				merge_cursor c;
+				prime_cursor(c, _tmp_files[i], _tmp_buffer_capacity);
+				_cursors.push_back(c);
 			}
+
+			build_merge_tree();
 		}
-#endif
 	}
 
 
@@ -555,12 +682,12 @@ public:
 	 */
 	void clear() {
 
-#ifndef LL_XS_HIERARCHICAL_MERGE
-		for (size_t i = 0; i < _tmp_buffers.size(); i++) {
-			free(_tmp_buffers[i]);
+		stop_spill_thread();
+
+		for (size_t i = 0; i < _cursors.size(); i++) {
+			release_cursor(_cursors[i]);
 		}
-		_tmp_buffers.clear();
-#endif
+		_cursors.clear();
 
 		for (size_t i = 0; i < _tmp_files.size(); i++) {
 			close(_tmp_files[i]);
@@ -581,36 +708,43 @@ public:
 
 		_done = false;
 
-#ifdef LL_XS_HIERARCHICAL_MERGE
-		LL_NOT_IMPLEMENTED;
-#else
+		for (size_t i = 0; i < _tmp_files.size(); i++) {
 
-		_tmp_buffer_sizes.clear();
-		_tmp_buffer_index.clear();
+			merge_cursor& c = _cursors[i];
 
-		for (size_t i = 0; i < _tmp_files.size(); i++) {
+			if (c.map_bytes != 0) {
 
-			int f = _tmp_files[i];
-			T* block = _tmp_buffers[i];
+				// The whole run is mapped; just go back to the start
 
-			off_t r = lseek(f, 0, SEEK_SET);
+				c.index = 0;
+				c.cur = c.size > 0 ? &c.block[0] : NULL;
+				c.key = c.cur == NULL ? 0 : key_of::key(*c.cur);
+#ifdef MADV_SEQUENTIAL
+				madvise(c.block, c.map_bytes, MADV_SEQUENTIAL);
+#endif
+				continue;
+			}
+
+			off_t r = lseek(c.fd, 0, SEEK_SET);
 			if (r == (off_t) -1) {
 				perror("lseek");
 				LL_E_PRINT("lseek failed\n");
 				abort();
 			}
 
-			size_t r2 = read(f, block, sizeof(T) * _tmp_buffer_capacity);
-			if (r2 < 0) {
-				perror("read");
-				LL_E_PRINT("read failed\n");
-				abort();
-			}
+			size_t cap = cursor_capacity(sizeof(T) * _tmp_buffer_capacity);
+			c.offset = 0;
+			ssize_t r2 = cursor_read(c, cap);
+
+			c.index = 0;
+			c.size = r2 / sizeof(T);
+			c.cur = c.size > 0 ? &c.block[0] : NULL;
+			c.key = c.cur == NULL ? 0 : key_of::key(*c.cur);
 
-			_tmp_buffer_sizes.push_back(r2 / sizeof(T));
-			_tmp_buffer_index.push_back(0);
+			advise_readahead(c.fd, c.offset, cap);
 		}
-#endif
+
+		build_merge_tree();
 	}
 
 
@@ -626,53 +760,113 @@ public:
 
 		if (_tmp_files.size() == 1) {
 			int f = _tmp_files[0];
-			ssize_t r = read(f, _buffer, sizeof(T) * _buffer_capacity);
-			if (r < 0) {
-				perror("read");
-				LL_E_PRINT("read failed\n");
-				abort();
+
+#ifdef LL_XS_COMPRESS
+			if (_compress) {
+
+				if (_comp_scratch == NULL) {
+					_comp_scratch = (char*) malloc(
+							LZ4_compressBound(frame_bytes()));
+					if (_comp_scratch == NULL) {
+						LL_E_PRINT("** OUT OF MEMORY **\n");
+						abort();
+					}
+				}
+
+				size_t fe = frame_bytes() / sizeof(T);
+				_buffer_size = 0;
+
+				while (_buffer_size + fe <= _buffer_capacity) {
+					ssize_t raw = read_frame(f, _buffer + _buffer_size,
+							frame_bytes(), _comp_scratch, NULL);
+					if (raw == 0) break;
+					_buffer_size += raw / sizeof(T);
+				}
+
+				if (_buffer_size == 0) _done = true;
 			}
-			_buffer_size = r / sizeof(T);
+			else
+#endif
+			{
+				ssize_t r = read(f, _buffer, sizeof(T) * _buffer_capacity);
+				if (r < 0) {
+					perror("read");
+					LL_E_PRINT("read failed\n");
+					abort();
+				}
+				_buffer_size = r / sizeof(T);
 
-			if (r == 0) _done = true;
+				if (r == 0) _done = true;
+				else {
+					off_t pos = lseek(f, 0, SEEK_CUR);
+					advise_readahead(f, pos, sizeof(T) * _buffer_capacity);
+					if (pos > r) advise_consumed(f, pos - r);
+				}
+			}
 		}
 		else if (_tmp_files.size() > 1) {
 
-#ifndef LL_XS_HIERARCHICAL_MERGE
+			// Pop the minimum from the loser tree: each element costs
+			// O(log K) comparisons along one leaf-to-root path instead of
+			// the old O(K) scan over all runs
 
 			_buffer_size = 0;
-			for (size_t w = 0; w < _buffer_capacity; w++) {
-				T* v = NULL;
-				size_t tx = 0;
-				for (size_t t = 0; t < _tmp_buffers.size(); t++) {
-					if (_tmp_buffer_sizes[t] <= 0) continue;
-					if (_tmp_buffer_index[t] >= _tmp_buffer_sizes[t]) {
-						size_t r = read(_tmp_files[t], _tmp_buffers[t],
-								sizeof(T) * _tmp_buffer_capacity);
-						if (r < 0) {
-							perror("read");
-							LL_E_PRINT("read failed\n");
-							abort();
-						}
-						_tmp_buffer_index[t] = 0;
-						_tmp_buffer_sizes[t] = r / sizeof(T);
-						if (_tmp_buffer_sizes[t] <= 0) continue;
+
+			merge_cursor* cs = &_cursors[0];
+			uint32_t* losers = &_merge_losers[0];
+
+			while (_buffer_size < _buffer_capacity) {
+
+				uint32_t w = losers[0];
+				merge_cursor& c = cs[w];
+				if (c.cur == NULL) break;		// all runs exhausted
+
+				_buffer[_buffer_size++] = *c.cur;
+
+				if (++c.index >= c.size) {
+					if (c.map_bytes != 0) {
+						// The run is fully mapped; it is simply exhausted
+						c.cur = NULL;
+						c.key = 0;
+						replay_merge_tree(cs, losers, _merge_p, w);
+						continue;
 					}
-					T* vx = &_tmp_buffers[t][_tmp_buffer_index[t]];
-					if (v == NULL || _comparator(*vx, *v)) {
-						v = vx;
-						tx = t;
+					size_t cap = cursor_capacity(
+							sizeof(T) * _tmp_buffer_capacity);
+					size_t prev = c.offset;
+					ssize_t r = cursor_read(c, cap);
+					c.index = 0;
+					c.size = r / sizeof(T);
+					c.cur = c.size > 0 ? &c.block[0] : NULL;
+
+					if (r > 0) {
+						advise_consumed(c.fd, prev);
+						advise_readahead(c.fd, c.offset, cap);
+
+						// Warm the front of the fresh block before the
+						// tree consults it
+						for (size_t l = 0; l < 4; l++)
+							__builtin_prefetch(((char*) c.block) + 64 * l,
+									0, 1);
 					}
 				}
-				_tmp_buffer_index[tx]++;
+				else {
+					c.cur = &c.block[c.index];
+
+					// With K interleaved streams the hardware prefetcher
+					// loses track of each one, so prefetch ahead in the
+					// stream that just won -- it is the one consulted on
+					// the very next pop
+
+					if (c.index + 8 < c.size)
+						__builtin_prefetch(&c.block[c.index + 8], 0, 0);
+				}
+				c.key = c.cur == NULL ? 0 : key_of::key(*c.cur);
 
-				if (v == NULL) break;
-				_buffer[_buffer_size++] = *v;
+				replay_merge_tree(cs, losers, _merge_p, w);
 			}
 
 			if (_buffer_size == 0) _done = true;
-#endif
-
 		}
 		else {
 			_done = true;
@@ -689,12 +883,14 @@ private:
 
 
 	/**
-	 * Sort the buffer. This will modify the contents of the _buffer, but it
-	 * will not make it entirely sorted by default.
+	 * Sort the given buffer. This will modify the contents of the buffer,
+	 * but it will not make it entirely sorted by default.
 	 *
-	 * @return the sorted buffer; may or may not be equal to the _buffer
+	 * @param buffer the buffer
+	 * @param size the number of elements
+	 * @return the sorted buffer; may or may not be equal to the input
 	 */
-	T* sort_buffer() {
+	T* sort_buffer(T* buffer, size_t size) {
 
 #ifdef LL_XS_DEBUG_PERFORMANCE
 		double t_start = __get_time_ms();
@@ -702,32 +898,32 @@ private:
 
 #ifndef LL_XS_MULTICORE_SORT
 
-		std::sort(_buffer, _buffer + _buffer_size, _comparator);
+		partition_sort(buffer, size);
 
 #	ifdef LL_XS_DEBUG_PERFORMANCE
 		double t = __get_time_ms() - t_start;
 		fprintf(stderr, "ll_external_sort::sort_buffer: %0.3lf ms\n", t);
 #	endif
 
-		return _buffer;
+		return buffer;
 
 #else
 
-		if (_buffer_size < 256*1024) {	// Need to find a good magic number!
-			std::sort(_buffer, _buffer + _buffer_size, _comparator);
+		if (size < 256*1024) {	// Need to find a good magic number!
+			partition_sort(buffer, size);
 #	ifdef LL_XS_DEBUG_PERFORMANCE
 			double t = __get_time_ms() - t_start;
 			fprintf(stderr, "ll_external_sort::sort_buffer: %0.3lf ms\n", t);
 #	endif
-			return _buffer;
+			return buffer;
 		}
 
 		size_t n = omp_get_max_threads();
 
 		size_t from[n], to[n];
 		for (size_t t = 0; t < n; t++) {
-			from[t] = t * _buffer_size / n;
-			to[t]   = t+1 == n ? _buffer_size : (t+1) * _buffer_size / n;
+			from[t] = t * size / n;
+			to[t]   = t+1 == n ? size : (t+1) * size / n;
 		}
 
 
@@ -736,85 +932,103 @@ private:
 #		pragma omp parallel
 		{
 			size_t t = omp_get_thread_num();
-			std::sort(_buffer + from[t],
-					  _buffer + to[t],
-					  _comparator);
+			partition_sort(buffer + from[t], to[t] - from[t]);
 		}
 
-		if (n == 1) return _buffer;
+		if (n == 1) return buffer;
 
 
 		// Parallel merge:
-		//   1. Divide the first buffer evenly between n threads
+		//   1. Divide the first buffer into m > n chunks
 		//   2. Find the corresponding points in the other n-1 buffers
-		//   3. Merge the n buffers in parallel
-
-		T* r = (T*) malloc(sizeof(T) * _buffer_size);
+		//   3. Merge chunk by chunk, with idle threads claiming the next
+		//      unmerged chunk from a shared cursor
+		//
+		// Over-partitioning by 4x and claiming dynamically keeps all
+		// cores busy even when the splitters land unevenly (skewed key
+		// distributions make some chunks much heavier than others);
+		// with one chunk per thread, the whole merge waits for the
+		// slowest one.
+
+		T* r = alloc_buffer(size);
 		assert(r != NULL);
 
-		size_t merge_from[n /* buffer */][n /* thread */], merge_to[n][n];
-		for (size_t t = 0; t < n; t++) {
-			merge_from[0][t] = t * to[0] / n;
-			merge_to[0][t]   = t+1 == n ? to[0] : (t+1) * to[0] / n;
+		size_t m = 4 * n;
+
+		size_t merge_from[n /* buffer */][m /* chunk */], merge_to[n][m];
+		for (size_t t = 0; t < m; t++) {
+			merge_from[0][t] = t * to[0] / m;
+			merge_to[0][t]   = t+1 == m ? to[0] : (t+1) * to[0] / m;
 		}
 
 		for (size_t i = 1; i < n; i++) {
-			for (size_t t = 0; t < n-1; t++) {
-				merge_to[i][t] = find_first_greater_than(_buffer + from[i],
-						to[i] - from[i], _buffer[merge_to[0][t]-1]) + from[i];
+			for (size_t t = 0; t < m-1; t++) {
+				merge_to[i][t] = find_first_greater_than(buffer + from[i],
+						to[i] - from[i], buffer[merge_to[0][t]-1]) + from[i];
 			}
-			merge_to[i][n-1] = to[i];
+			merge_to[i][m-1] = to[i];
 			merge_from[i][0] = from[i];
-			for (size_t t = 1; t < n; t++) {
+			for (size_t t = 1; t < m; t++) {
 				merge_from[i][t] = merge_to[i][t-1];
 			}
 		}
-		
-		/*for (size_t i = 0; i < n; i++) {
-			fprintf(stderr, "\nSorted buffer #%lu: %lu -- %lu (len = %lu)\n",
-					i, from[i], to[i], to[i] - from[i]);
-			for (size_t t = 0; t < n; t++) {
-				fprintf(stderr, "  Part %lu: %lu -- %lu (len = %lu)\n",
-						t, merge_from[i][t], merge_to[i][t],
-						merge_to[i][t] - merge_from[i][t]);
-			}
-		}*/
 
-		size_t write_index[n+1];
+		size_t write_index[m+1];
 		write_index[0] = 0;
-		for (size_t t = 1; t < n+1; t++) {
+		for (size_t t = 1; t < m+1; t++) {
 			size_t x = 0;
 			for (size_t i = 0; i < n; i++) {
 				x += merge_to[i][t-1] - merge_from[i][t-1];
 			}
 			write_index[t] = write_index[t-1] + x;
 		}
-		assert(write_index[n] == _buffer_size);
+		assert(write_index[m] == size);
+
+		volatile size_t cursor = 0;
 
 #		pragma omp parallel
 		{
-			int t = omp_get_thread_num();
-			size_t index[n], end[n];
-
-			for (size_t i = 0; i < n; i++) {
-				index[i] = merge_from[i][t];
-				end[i] = merge_to[i][t];
-			}
-
-			for (size_t w = write_index[t]; w < write_index[t+1]; w++) {
-				T* v = NULL;
-				size_t tx = 0;
-				for (size_t i = 0; i < n; i++) {
-					if (index[i] < end[i]) {
-						if (v == NULL || _comparator(_buffer[index[i]], *v)) {
-							v = &_buffer[index[i]];
-							tx = i;
-						}
-					}
+			size_t p = 1;
+			while (p < n) p <<= 1;
+
+			merge_cursor mc[p];
+			uint32_t losers[p];
+
+			size_t t;
+			while ((t = __sync_fetch_and_add(&cursor, 1)) < m) {
+
+				// Merge this chunk's slice of the n runs through a
+				// local loser tree -- O(log n) comparisons per element.
+				// For these in-memory streams, index/size delimit the
+				// stream's range within the shared buffer.
+
+				for (size_t i = 0; i < p; i++) {
+					merge_cursor& c = mc[i];
+					c.index = i < n ? merge_from[i][t] : 0;
+					c.size = i < n ? merge_to[i][t] : 0;
+					c.cur = c.index < c.size ? &buffer[c.index] : NULL;
+					c.key = c.cur == NULL ? 0 : key_of::key(*c.cur);
+					c.block = NULL;
+					c.offset = 0;
+					c.fd = -1;
 				}
-				index[tx]++;
+				build_loser_tree(mc, losers, p);
+
+				for (size_t w = write_index[t]; w < write_index[t+1]; w++) {
+					uint32_t x = losers[0];
+					merge_cursor& c = mc[x];
 
-				r[w] = *v;
+					r[w] = *c.cur;
+
+					c.index++;
+					c.cur = c.index < c.size ? &buffer[c.index] : NULL;
+					c.key = c.cur == NULL ? 0 : key_of::key(*c.cur);
+
+					if (c.index + 8 < c.size)
+						__builtin_prefetch(&buffer[c.index + 8], 0, 0);
+
+					replay_merge_tree(mc, losers, p, x);
+				}
 			}
 		}
 
@@ -829,26 +1043,835 @@ private:
 
 
 	/**
-	 * Do a binary search in the buffer and return the first position that
-	 * is greater than the given value
+	 * Hand a full buffer to the background writer and swap in an empty
+	 * one, so ingestion continues while the buffer is sorted and spilled.
+	 * Takes ownership of the buffer and replaces _buffer; the caller only
+	 * resets _buffer_size.
 	 *
-	 * @param buffer the buffer
-	 * @param length the buffer length
-	 * @param key the value to find 
-	 * @return the position
+	 * @param buffer the full buffer
+	 * @param size the number of elements in it
 	 */
-	size_t find_first_greater_than(const T* buffer, size_t length,
-			const T& key) {
+	void spill_async(T* buffer, size_t size) {
 
-		if (length == 0) {
-			return 0;
+		bool first = !_spill_started;
+
+		if (first) {
+			_spill_exit = false;
+			if (pthread_create(&_spill_thread, NULL,
+						spill_thread_entry, this) != 0) {
+				perror("pthread_create");
+				LL_E_PRINT("cannot start the spill thread\n");
+				abort();
+			}
+			_spill_started = true;
 		}
 
-		ssize_t min = 0;
-		ssize_t max = length - 1;
-		ssize_t mid = 0;
 
-		while (max >= min) {
+		// Wait until the writer took the previous buffer, then publish
+		// this one (size first -- the pointer store is what the writer
+		// synchronizes on)
+
+		while (_spill_pending != NULL) usleep(10);
+
+		_spill_pending_size = size;
+		__sync_synchronize();
+		_spill_pending = buffer;
+
+
+		// Take the other buffer for further ingest: freshly allocated on
+		// the first spill, returned by the writer afterwards
+
+		if (first) {
+			_buffer = alloc_buffer(_buffer_capacity);
+			if (_buffer == NULL) {
+				LL_E_PRINT("** OUT OF MEMORY **\n");
+				abort();
+			}
+		}
+		else {
+			while (_spill_spare == NULL) usleep(10);
+			_buffer = _spill_spare;
+			_spill_spare = NULL;
+		}
+	}
+
+
+	/**
+	 * The body of the background writer: sort and write published
+	 * buffers until told to exit, returning each buffer for reuse
+	 */
+	void spill_thread_body() {
+
+		while (true) {
+
+			while (_spill_pending == NULL && !_spill_exit) usleep(10);
+
+			T* b = _spill_pending;
+			if (b == NULL) break;
+			size_t n = _spill_pending_size;
+
+			T* sorted = sort_buffer(b, n);
+			int f = write_buffer(sorted, n);
+			if (sorted != b) free_buffer(sorted);
+
+			ll_spinlock_acquire(&_tmp_files_lock);
+			_tmp_files.push_back(f);
+			ll_spinlock_release(&_tmp_files_lock);
+
+			__sync_synchronize();
+			_spill_spare = b;
+			_spill_pending = NULL;
+		}
+	}
+
+	static void* spill_thread_entry(void* arg) {
+		((ll_external_sort*) arg)->spill_thread_body();
+		return NULL;
+	}
+
+
+	/**
+	 * Drain and join the background writer (a no-op if it never ran), so
+	 * the caller sees a complete _tmp_files and owns all buffers again
+	 */
+	void stop_spill_thread() {
+
+		if (!_spill_started) return;
+
+		while (_spill_pending != NULL) usleep(10);
+
+		_spill_exit = true;
+		pthread_join(_spill_thread, NULL);
+		_spill_started = false;
+
+		if (_spill_spare != NULL) {
+			free_buffer(_spill_spare);
+			_spill_spare = NULL;
+		}
+	}
+
+
+	/**
+	 * Sort one in-memory partition: radix on the comparator's key64()
+	 * when it has one, std::sort otherwise (decided at compile time)
+	 *
+	 * @param buffer the partition
+	 * @param n the number of elements
+	 */
+	inline void partition_sort(T* buffer, size_t n) {
+		ll_xs_partition_sort<T, Comparator,
+			ll_xs_has_key64<Comparator, T>::value>
+				::sort(buffer, n, _comparator);
+	}
+
+
+	/// The key-prefix accessor matching the comparator (0 if it has none)
+	typedef ll_xs_key_of<T, Comparator,
+			ll_xs_has_key64<Comparator, T>::value> key_of;
+
+
+	/**
+	 * Compare two streams of a loser tree by their current elements. An
+	 * exhausted stream (NULL cursor) loses against any live one, so the
+	 * padding leaves above the real fan-in never win. The cached key
+	 * prefixes are consulted first: they sit in a small dense array that
+	 * stays register- or L1-resident, so most compares never touch the
+	 * full records at all; only a prefix tie (always, for comparators
+	 * without key64) dereferences the cursors for the comparator.
+	 *
+	 * @param c the per-stream cursors
+	 * @param a the first stream
+	 * @param b the second stream
+	 * @return true if stream a goes first
+	 */
+	inline bool merge_tree_less(const merge_cursor* c,
+			uint32_t a, uint32_t b) {
+		if (c[a].cur == NULL) return false;
+		if (c[b].cur == NULL) return true;
+		if (c[a].key != c[b].key) return c[a].key < c[b].key;
+		return _comparator(*c[a].cur, *c[b].cur);
+	}
+
+
+	/**
+	 * Build a loser tree over p streams (p must be a power of two; streams
+	 * without data carry a NULL cursor). The internal nodes losers[1..p-1]
+	 * store the loser of the match played at that node, and losers[0] the
+	 * overall winner.
+	 *
+	 * @param c the per-stream cursors
+	 * @param losers the loser array of size p
+	 * @param p the number of leaves
+	 */
+	void build_loser_tree(const merge_cursor* c, uint32_t* losers,
+			size_t p) {
+
+		uint32_t winner[2 * p];
+		for (size_t i = 0; i < p; i++) winner[p + i] = i;
+
+		for (size_t i = p; --i >= 1; ) {
+			uint32_t a = winner[2*i];
+			uint32_t b = winner[2*i + 1];
+			bool l = merge_tree_less(c, b, a);
+			losers[i] = l ? a : b;
+			winner[i] = l ? b : a;
+		}
+
+		losers[0] = winner[1];
+	}
+
+
+	/**
+	 * Replay the matches on the path from the consumed winner's leaf up to
+	 * the root, after its cursor was advanced (or set to NULL on EOF)
+	 *
+	 * @param c the per-stream cursors
+	 * @param losers the loser array
+	 * @param p the number of leaves
+	 * @param w the stream that just won
+	 */
+	inline void replay_merge_tree(const merge_cursor* c,
+			uint32_t* losers, size_t p, uint32_t w) {
+
+		// The match outcome is a coin flip on random data, so select the
+		// winner with conditional moves instead of a branchy swap -- the
+		// indices are uint32_t, which the compiler turns into cmov
+
+		uint32_t x = w;
+		for (size_t i = (w + p) >> 1; i >= 1; i >>= 1) {
+			uint32_t y = losers[i];
+			bool l = merge_tree_less(c, y, x);
+			losers[i] = l ? x : y;
+			x = l ? y : x;
+		}
+		losers[0] = x;
+	}
+
+
+	/**
+	 * Allocate a big sort arena. Allocations of 2MB and above go on
+	 * hugepages when available (the arena is scanned end to end by the
+	 * sort and the merge, so 4KB pages mean constant dTLB misses), with
+	 * an aligned malloc plus MADV_HUGEPAGE as the fallback. The size and
+	 * kind are recorded in a 64-byte prefix so free_buffer can route the
+	 * release -- the same scheme as new_ll_et_array.
+	 *
+	 * @param elems the number of elements
+	 * @return the buffer, or NULL if out of memory
+	 */
+	static T* alloc_buffer(size_t elems) {
+
+		size_t bytes = 64 + sizeof(T) * elems;
+
+		void* p = NULL;
+		size_t mapped = 0;
+
+		// The standalone tools in utils/ use this header without a LLAMA
+		// configuration and hence without ll_common.h; they fall through
+		// to the aligned malloc below
+#ifdef LL_COMMON_H_
+		if (bytes >= 2ul * 1048576) {
+			p = ll_mmap_hugepages(bytes);
+			if (p != NULL) mapped = 1;
+		}
+#endif
+		if (p == NULL) {
+			if (posix_memalign(&p, 64, bytes) != 0) p = NULL;
+#ifdef MADV_HUGEPAGE
+			if (p != NULL) madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+		}
+		if (p == NULL) return NULL;
+
+		((size_t*) p)[0] = bytes;
+		((size_t*) p)[1] = mapped;
+
+		return (T*) (((char*) p) + 64);
+	}
+
+
+	/**
+	 * Release a buffer obtained from alloc_buffer
+	 *
+	 * @param b the buffer (may be NULL)
+	 */
+	static void free_buffer(T* b) {
+		if (b == NULL) return;
+		void* p = ((char*) b) - 64;
+		if (((size_t*) p)[1]) {
+			munmap(p, ((size_t*) p)[0]);
+		}
+		else {
+			free(p);
+		}
+	}
+
+
+	/**
+	 * Give the tail of _buffer beyond the given element count back to the
+	 * OS without moving the data. Hugepage mappings only accept advice at
+	 * 2MB granularity, so the cut is rounded up accordingly.
+	 *
+	 * @param elems the number of elements to keep
+	 */
+	void shrink_buffer_to(size_t elems) {
+#ifdef MADV_DONTNEED
+		void* p = ((char*) _buffer) - 64;
+		size_t bytes = ((size_t*) p)[0];
+		size_t align = ((size_t*) p)[1] ? 2ul * 1048576 : 4096;
+
+		size_t keep = 64 + sizeof(T) * elems;
+		keep = (keep + align - 1) & ~(align - 1);
+
+		if (keep < bytes)
+			madvise(((char*) p) + keep, bytes - keep, MADV_DONTNEED);
+#endif
+	}
+
+
+	/**
+	 * Determine how much memory the process's cgroup still allows it to
+	 * allocate (limit minus current usage), checking cgroup v2 first and
+	 * then v1
+	 *
+	 * @return the available bytes, or 0 if there is no limit
+	 */
+	static size_t cgroup_available_memory() {
+
+		static const char* const limit_files[] = {
+			"/sys/fs/cgroup/memory.max",
+			"/sys/fs/cgroup/memory/memory.limit_in_bytes",
+		};
+		static const char* const usage_files[] = {
+			"/sys/fs/cgroup/memory.current",
+			"/sys/fs/cgroup/memory/memory.usage_in_bytes",
+		};
+
+		for (int i = 0; i < 2; i++) {
+
+			FILE* f = fopen(limit_files[i], "r");
+			if (f == NULL) continue;
+
+			char buf[64];
+			char* r = fgets(buf, sizeof(buf), f);
+			fclose(f);
+
+			// "max" (v2) means no limit; v1 reports a huge number instead,
+			// which strtoull still parses and the caller's min handles
+
+			if (r == NULL || strncmp(buf, "max", 3) == 0) return 0;
+			size_t limit = strtoull(buf, NULL, 10);
+			if (limit == 0) return 0;
+
+			size_t usage = 0;
+			f = fopen(usage_files[i], "r");
+			if (f != NULL) {
+				if (fgets(buf, sizeof(buf), f) != NULL)
+					usage = strtoull(buf, NULL, 10);
+				fclose(f);
+			}
+
+			return usage < limit ? limit - usage : 1;
+		}
+
+		return 0;
+	}
+
+
+#ifdef LL_XS_COMPRESS
+
+	/**
+	 * The frame payload capacity: LL_XS_FRAME_RAW rounded down to whole
+	 * elements (at least one, for records larger than a frame)
+	 *
+	 * @return the capacity in bytes
+	 */
+	static inline size_t frame_bytes() {
+		size_t e = LL_XS_FRAME_RAW / sizeof(T);
+		if (e == 0) e = 1;
+		return e * sizeof(T);
+	}
+
+
+	/**
+	 * Write a buffer as a sequence of LZ4 frames
+	 *
+	 * @param f the file descriptor
+	 * @param buffer the buffer
+	 * @param size the number of elements
+	 */
+	void write_compressed(int f, const T* buffer, size_t size) {
+
+		const char* src = (const char*) buffer;
+		size_t left = size * sizeof(T);
+		size_t cap = frame_bytes();
+
+		int bound = LZ4_compressBound(cap);
+		char* dst = (char*) malloc(2 * sizeof(uint32_t) + bound);
+		if (dst == NULL) {
+			LL_E_PRINT("** OUT OF MEMORY **\n");
+			abort();
+		}
+
+		while (left > 0) {
+
+			uint32_t raw = left > cap ? cap : left;
+			int comp = LZ4_compress_default(src,
+					dst + 2 * sizeof(uint32_t), raw, bound);
+			if (comp <= 0) {
+				LL_E_PRINT("LZ4 compression failed\n");
+				abort();
+			}
+
+			((uint32_t*) dst)[0] = comp;
+			((uint32_t*) dst)[1] = raw;
+
+			size_t bytes = 2 * sizeof(uint32_t) + comp;
+			ssize_t r = write(f, dst, bytes);
+			if (r < (ssize_t) bytes) {
+				perror("write");
+				LL_E_PRINT("write failed; returned %ld\n", r);
+				abort();
+			}
+
+			src += raw;
+			left -= raw;
+		}
+
+		free(dst);
+	}
+
+
+	/**
+	 * Read and decompress one frame
+	 *
+	 * @param fd the file descriptor
+	 * @param dst the destination for the raw payload
+	 * @param cap the destination capacity in bytes
+	 * @param scratch the compressed-payload scratch buffer
+	 * @param file_bytes the file bytes consumed (out; may be NULL)
+	 * @return the raw bytes decompressed, or 0 on EOF
+	 */
+	ssize_t read_frame(int fd, void* dst, size_t cap, char* scratch,
+			size_t* file_bytes) {
+
+		uint32_t hdr[2];
+		ssize_t r = read(fd, hdr, sizeof(hdr));
+		if (r == 0) return 0;
+		if (r != (ssize_t) sizeof(hdr)) {
+			perror("read");
+			LL_E_PRINT("read failed\n");
+			abort();
+		}
+
+		uint32_t comp = hdr[0];
+		uint32_t raw = hdr[1];
+		if (raw > cap || comp > (uint32_t) LZ4_compressBound(frame_bytes())) {
+			LL_E_PRINT("corrupt spill frame\n");
+			abort();
+		}
+
+		r = read(fd, scratch, comp);
+		if (r != (ssize_t) comp) {
+			perror("read");
+			LL_E_PRINT("read failed\n");
+			abort();
+		}
+
+		int d = LZ4_decompress_safe(scratch, (char*) dst, comp, raw);
+		if (d != (int) raw) {
+			LL_E_PRINT("LZ4 decompression failed\n");
+			abort();
+		}
+
+		if (file_bytes != NULL) *file_bytes = sizeof(hdr) + comp;
+		return raw;
+	}
+
+#endif /* LL_XS_COMPRESS */
+
+
+	/**
+	 * The block capacity a cursor should use: one frame when the runs are
+	 * compressed, the caller's block budget otherwise
+	 *
+	 * @param block_bytes the uncompressed block budget in bytes
+	 * @return the capacity in bytes
+	 */
+	inline size_t cursor_capacity(size_t block_bytes) {
+#ifdef LL_XS_COMPRESS
+		if (_compress) return frame_bytes();
+#endif
+		return block_bytes;
+	}
+
+
+	/**
+	 * Refill a cursor's block from its file: one decompressed frame when
+	 * the runs are compressed, a full block read otherwise. Advances
+	 * c.offset by the file bytes consumed.
+	 *
+	 * @param c the cursor
+	 * @param cap_bytes the block capacity in bytes
+	 * @return the raw bytes now in the block (0 on EOF)
+	 */
+	ssize_t cursor_read(merge_cursor& c, size_t cap_bytes) {
+
+#ifdef LL_XS_COMPRESS
+		if (_compress) {
+			size_t fb = 0;
+			ssize_t raw = read_frame(c.fd, c.block, cap_bytes, c.cbuf, &fb);
+			c.offset += fb;
+			return raw;
+		}
+#endif
+
+		ssize_t r = read(c.fd, c.block, cap_bytes);
+		if (r < 0) {
+			perror("read");
+			LL_E_PRINT("read failed\n");
+			abort();
+		}
+		c.offset += r;
+		return r;
+	}
+
+
+	/**
+	 * Write merged output to a run file, compressing when enabled
+	 *
+	 * @param f the file descriptor
+	 * @param buffer the buffer
+	 * @param size the number of elements
+	 */
+	void spill_write(int f, const T* buffer, size_t size) {
+
+#ifdef LL_XS_COMPRESS
+		if (_compress) {
+			write_compressed(f, buffer, size);
+			return;
+		}
+#endif
+
+		ssize_t r = write(f, buffer, sizeof(T) * size);
+		if (r < (ssize_t) (sizeof(T) * size)) {
+			perror("write");
+			LL_E_PRINT("write failed; returned %ld\n", r);
+			abort();
+		}
+	}
+
+
+	/**
+	 * Prime a merge cursor over a run file. The whole run is mapped
+	 * read-only when possible, so the merge reads straight from the page
+	 * cache with no user-kernel copy and no refills; otherwise it falls
+	 * back to a malloc'd block refilled with read().
+	 *
+	 * @param c the cursor
+	 * @param fd the run file, positioned at the beginning
+	 * @param block_elems the block size in elements for the read fallback
+	 */
+	void prime_cursor(merge_cursor& c, int fd, size_t block_elems) {
+
+		c.fd = fd;
+		c.map_bytes = 0;
+#ifdef LL_XS_COMPRESS
+		c.cbuf = NULL;
+
+		if (_compress) {
+			// A compressed run cannot be mapped and merged in place
+			c.cbuf = (char*) malloc(LZ4_compressBound(frame_bytes()));
+			if (c.cbuf == NULL) {
+				LL_E_PRINT("** OUT OF MEMORY **\n");
+				abort();
+			}
+		}
+		else
+#endif
+		{
+			struct stat st;
+			if (fstat(fd, &st) == 0 && st.st_size > 0) {
+
+				void* m = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE,
+						fd, 0);
+				if (m != MAP_FAILED) {
+
+					c.block = (T*) m;
+					c.map_bytes = st.st_size;
+					c.index = 0;
+					c.size = st.st_size / sizeof(T);
+					c.offset = st.st_size;
+					c.cur = c.size > 0 ? &c.block[0] : NULL;
+					c.key = c.cur == NULL ? 0 : key_of::key(*c.cur);
+
+#ifdef MADV_SEQUENTIAL
+					madvise(m, st.st_size, MADV_SEQUENTIAL);
+#endif
+#ifdef MADV_WILLNEED
+					size_t warm = sizeof(T) * block_elems;
+					if (warm > (size_t) st.st_size) warm = st.st_size;
+					madvise(m, warm, MADV_WILLNEED);
+#endif
+					return;
+				}
+			}
+		}
+
+		size_t cap = cursor_capacity(sizeof(T) * block_elems);
+		c.block = (T*) malloc(cap);
+		c.offset = 0;
+
+		ssize_t r = cursor_read(c, cap);
+
+		c.index = 0;
+		c.size = r / sizeof(T);
+		c.cur = c.size > 0 ? &c.block[0] : NULL;
+		c.key = c.cur == NULL ? 0 : key_of::key(*c.cur);
+
+		if (r > 0) advise_readahead(fd, c.offset, cap);
+	}
+
+
+	/**
+	 * Release a cursor's backing memory
+	 *
+	 * @param c the cursor
+	 */
+	void release_cursor(merge_cursor& c) {
+#ifdef LL_XS_COMPRESS
+		if (c.cbuf != NULL) {
+			free(c.cbuf);
+			c.cbuf = NULL;
+		}
+#endif
+		if (c.block == NULL) return;
+		if (c.map_bytes != 0) munmap(c.block, c.map_bytes);
+		else free(c.block);
+		c.block = NULL;
+		c.map_bytes = 0;
+	}
+
+
+	/**
+	 * Merge k sorted runs into one new temporary file using a loser tree.
+	 * The inputs are read from their current position (the beginning);
+	 * the returned file is rewound and ready to be read.
+	 *
+	 * @param files the input file descriptors
+	 * @param k the number of inputs
+	 * @return the output file descriptor
+	 */
+	int merge_files(int* files, size_t k) {
+
+		size_t p = 1;
+		while (p < k) p <<= 1;
+
+		// Split the usual run buffer budget across the inputs, so an
+		// intermediate round does not cost k times the memory of the
+		// final merge
+
+		size_t block_elems = _tmp_buffer_capacity / k;
+		if (block_elems < 1024) block_elems = 1024;
+
+		merge_cursor mc[p];
+		uint32_t losers[p];
+
+		for (size_t t = 0; t < p; t++) {
+
+			merge_cursor& c = mc[t];
+
+			if (t >= k) {
+				c.cur = NULL;
+				c.key = 0;
+				c.block = NULL;
+				c.index = 0;
+				c.size = 0;
+				c.offset = 0;
+				c.map_bytes = 0;
+				c.fd = -1;
+#ifdef LL_XS_COMPRESS
+				c.cbuf = NULL;
+#endif
+				continue;
+			}
+
+			prime_cursor(c, files[t], block_elems);
+		}
+
+		build_loser_tree(mc, losers, p);
+
+		int f = temporary_file();
+		T* out = (T*) malloc(sizeof(T) * _tmp_buffer_capacity);
+		size_t w = 0;
+
+		while (true) {
+
+			uint32_t x = losers[0];
+			merge_cursor& c = mc[x];
+			if (c.cur == NULL) break;		// all inputs exhausted
+
+			out[w++] = *c.cur;
+
+			if (w >= _tmp_buffer_capacity) {
+				spill_write(f, out, w);
+				w = 0;
+			}
+
+			if (++c.index >= c.size) {
+				if (c.map_bytes != 0) {
+					c.cur = NULL;
+					c.key = 0;
+					replay_merge_tree(mc, losers, p, x);
+					continue;
+				}
+				size_t cap = cursor_capacity(sizeof(T) * block_elems);
+				size_t prev = c.offset;
+				ssize_t r = cursor_read(c, cap);
+				c.index = 0;
+				c.size = r / sizeof(T);
+				c.cur = c.size > 0 ? &c.block[0] : NULL;
+
+				if (r > 0) {
+					advise_consumed(c.fd, prev);
+					advise_readahead(c.fd, c.offset, cap);
+
+					for (size_t l = 0; l < 4; l++)
+						__builtin_prefetch(((char*) c.block) + 64 * l,
+								0, 1);
+				}
+			}
+			else {
+				c.cur = &c.block[c.index];
+				if (c.index + 8 < c.size)
+					__builtin_prefetch(&c.block[c.index + 8], 0, 0);
+			}
+			c.key = c.cur == NULL ? 0 : key_of::key(*c.cur);
+
+			replay_merge_tree(mc, losers, p, x);
+		}
+
+		if (w > 0) {
+			spill_write(f, out, w);
+		}
+
+		free(out);
+		for (size_t t = 0; t < k; t++) release_cursor(mc[t]);
+
+		off_t t = lseek(f, 0, SEEK_SET);
+		if (t == (off_t) -1) {
+			perror("lseek");
+			LL_E_PRINT("lseek failed\n");
+			abort();
+		}
+
+		return f;
+	}
+
+
+	/**
+	 * (Re)build the loser tree over the runs after sort() or
+	 * rewind_sorted() primed the run buffers
+	 */
+	void build_merge_tree() {
+
+		size_t k = _tmp_files.size();
+
+		_merge_p = 1;
+		while (_merge_p < k) _merge_p <<= 1;
+
+		// Pad the cursor array to a full set of leaves; the padding
+		// cursors are permanently exhausted
+
+		_cursors.resize(_merge_p);
+		for (size_t i = k; i < _merge_p; i++) {
+			merge_cursor& c = _cursors[i];
+			c.cur = NULL;
+			c.key = 0;
+			c.block = NULL;
+			c.index = 0;
+			c.size = 0;
+			c.offset = 0;
+			c.map_bytes = 0;
+			c.fd = -1;
+#ifdef LL_XS_COMPRESS
+			c.cbuf = NULL;
+#endif
+		}
+
+		_merge_losers.resize(_merge_p);
+		build_loser_tree(&_cursors[0], &_merge_losers[0], _merge_p);
+	}
+
+
+	/**
+	 * Do a binary search in the buffer and return the first position that
+	 * is greater than the given value. When the comparator exposes a key
+	 * prefix, the search first narrows to the run of elements sharing the
+	 * probe's key with integer compares -- the comparator, with its data-
+	 * dependent branches, then only arbitrates inside that (usually tiny)
+	 * run instead of along the whole search path.
+	 *
+	 * @param buffer the buffer
+	 * @param length the buffer length
+	 * @param key the value to find 
+	 * @return the position
+	 */
+	size_t find_first_greater_than(const T* buffer, size_t length,
+			const T& key) {
+
+		if (ll_xs_has_key64<Comparator, T>::value && length > 0) {
+
+			uint64_t ks = key_of::key(key);
+
+			// The first position whose key prefix is >= ks ...
+
+			size_t lo = 0, hi = length;
+			while (lo < hi) {
+				size_t mid = lo + (hi - lo) / 2;
+				if (key_of::key(buffer[mid]) < ks) lo = mid + 1;
+				else hi = mid;
+			}
+			size_t run_lo = lo;
+
+			// ... and the first one whose key prefix is > ks
+
+			hi = length;
+			while (lo < hi) {
+				size_t mid = lo + (hi - lo) / 2;
+				if (key_of::key(buffer[mid]) <= ks) lo = mid + 1;
+				else hi = mid;
+			}
+
+			if (lo == run_lo) return run_lo;
+			return run_lo + find_first_greater_than_cmp(buffer + run_lo,
+					lo - run_lo, key);
+		}
+
+		return find_first_greater_than_cmp(buffer, length, key);
+	}
+
+
+	/**
+	 * The comparator-based search behind find_first_greater_than
+	 *
+	 * @param buffer the buffer
+	 * @param length the buffer length
+	 * @param key the value to find 
+	 * @return the position
+	 */
+	size_t find_first_greater_than_cmp(const T* buffer, size_t length,
+			const T& key) {
+
+		if (length == 0) {
+			return 0;
+		}
+
+		ssize_t min = 0;
+		ssize_t max = length - 1;
+		ssize_t mid = 0;
+
+		while (max >= min) {
 			
 			mid = min + (max - min) / 2;
 
@@ -871,6 +1894,43 @@ private:
 	}
 
 
+	/**
+	 * Ask the kernel to start reading the given range in the background,
+	 * so the next block of a run is (mostly) in the page cache by the
+	 * time the merge loop drains the current one. Purely advisory; a
+	 * no-op where posix_fadvise is unavailable.
+	 *
+	 * @param fd the file descriptor
+	 * @param offset the offset in bytes
+	 * @param bytes the number of bytes
+	 */
+	inline void advise_readahead(int fd, size_t offset, size_t bytes) {
+#ifdef POSIX_FADV_WILLNEED
+		posix_fadvise(fd, offset, bytes, POSIX_FADV_WILLNEED);
+#else
+		(void) fd; (void) offset; (void) bytes;
+#endif
+	}
+
+
+	/**
+	 * Tell the kernel everything before the given offset has been
+	 * consumed and will not be read again, so the page cache gives the
+	 * memory back instead of competing with the sort buffers -- spill
+	 * runs are written once and read once. Purely advisory.
+	 *
+	 * @param fd the file descriptor
+	 * @param offset the end of the consumed prefix, in bytes
+	 */
+	inline void advise_consumed(int fd, size_t offset) {
+#ifdef POSIX_FADV_DONTNEED
+		posix_fadvise(fd, 0, offset, POSIX_FADV_DONTNEED);
+#else
+		(void) fd; (void) offset;
+#endif
+	}
+
+
 	/**
 	 * Create and open a temporary file
 	 *
@@ -892,6 +1952,13 @@ private:
 		}
 
 		unlink(n);
+
+#ifdef POSIX_FADV_SEQUENTIAL
+		// The runs are written and read strictly sequentially; a larger
+		// kernel readahead window hides more of the read latency
+		posix_fadvise(f, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
 		return f;
 	}
 
@@ -907,20 +1974,81 @@ private:
 
 		int f = temporary_file();
 
-		size_t t = size * sizeof(T);
-		while (t > 0) {
-			size_t s = t;
-			if (s > sizeof(T) * 1048576ul) s = sizeof(T) * 1048576ul;
-			t -= s;
+#ifdef LL_XS_COMPRESS
+		if (_compress) {
 
-			ssize_t r = write(f, buffer, s);
-			if (r < (ssize_t) s) {
-				perror("write");
-				LL_E_PRINT("write failed; returned %ld\n", r);
+			write_compressed(f, buffer, size);
+
+			off_t r = lseek(f, 0, SEEK_SET);
+			if (r == (off_t) -1) {
+				perror("lseek");
+				LL_E_PRINT("lseek failed\n");
+				abort();
+			}
+
+			return f;
+		}
+#endif
+
+		size_t total = size * sizeof(T);
+
+		if (total >= 4ul * 1048576 && omp_get_max_threads() > 1) {
+
+			// Large spills: preallocate the file and write disjoint
+			// ranges concurrently with pwrite, so an NVMe device sees
+			// more than queue depth one instead of a single sequential
+			// writer stream
+
+			if (ftruncate(f, total) != 0) {
+				perror("ftruncate");
+				LL_E_PRINT("ftruncate failed\n");
 				abort();
 			}
 
-			buffer += s / sizeof(T);
+			int nchunks = omp_get_max_threads();
+			size_t chunk = (total + nchunks - 1) / nchunks;
+			chunk = (chunk + 4095) & ~((size_t) 4095);
+
+			#pragma omp parallel for schedule(static)
+			for (int i = 0; i < nchunks; i++) {
+
+				size_t off = (size_t) i * chunk;
+				if (off >= total) continue;
+
+				size_t len = total - off < chunk ? total - off : chunk;
+				char* p = ((char*) buffer) + off;
+
+				while (len > 0) {
+					ssize_t r = pwrite(f, p, len, off);
+					if (r <= 0) {
+						perror("pwrite");
+						LL_E_PRINT("write failed; returned %ld\n",
+								(long) r);
+						abort();
+					}
+					p += r;
+					off += r;
+					len -= r;
+				}
+			}
+		}
+		else {
+
+			size_t t = total;
+			while (t > 0) {
+				size_t s = t;
+				if (s > sizeof(T) * 1048576ul) s = sizeof(T) * 1048576ul;
+				t -= s;
+
+				ssize_t r = write(f, buffer, s);
+				if (r < (ssize_t) s) {
+					perror("write");
+					LL_E_PRINT("write failed; returned %ld\n", r);
+					abort();
+				}
+
+				buffer += s / sizeof(T);
+			}
 		}
 
 		off_t r = lseek(f, 0, SEEK_SET);
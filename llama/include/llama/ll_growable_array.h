@@ -64,8 +64,222 @@ template <typename T> struct ll_nop_deallocator {
 };
 
 
+// The slab size used by ll_slab_block_allocator
+#define LL_SLAB_BYTES		(2ul * 1048576)
+
+
+/**
+ * The backing store of ll_slab_block_allocator: a process-lifetime pool
+ * that carves 2 MB slabs (hugepage-backed when available) into fixed-size
+ * slots. Each thread keeps its own free list, so the common case -- pop a
+ * recycled slot, push it back on free -- takes no lock and no malloc at
+ * all; only carving fresh slots from the shared slab bump pointer
+ * serializes, and that is amortized by refilling a batch of slots at a
+ * time. Slots freed by a different thread than the one that allocated
+ * them simply migrate to the freeing thread's list. Slabs are never
+ * returned to the OS; the pool is meant for block sizes that the
+ * workload allocates millions of times.
+ */
+template <size_t BlockBytes>
+class ll_slab_block_source {
+
+	/// The slot size: the block, its origin tag, 16-byte alignment
+	static const size_t SLOT_BYTES = (BlockBytes + 16 + 15) & ~((size_t) 15);
+
+	/// The number of slots carved per free-list refill
+	static const size_t REFILL = 32;
+
+	static ll_spinlock_t _lock;
+	static char* _bump;
+	static char* _end;
+	static __thread void* _tl_free;
+
+
+public:
+
+	/**
+	 * Allocate one slot
+	 *
+	 * @return the slot
+	 */
+	static void* allocate() {
+
+		void* x = _tl_free;
+		if (x == NULL) {
+			refill();
+			x = _tl_free;
+		}
+
+		_tl_free = *(void**) x;
+		return x;
+	}
+
+
+	/**
+	 * Return a slot to the calling thread's free list
+	 *
+	 * @param p the slot
+	 */
+	static void release(void* p) {
+		*(void**) p = _tl_free;
+		_tl_free = p;
+	}
+
+
+private:
+
+	/**
+	 * Carve a batch of fresh slots into the calling thread's free list
+	 */
+	static void refill() {
+
+		ll_spinlock_acquire(&_lock);
+
+		for (size_t i = 0; i < REFILL; i++) {
+
+			if (_bump == NULL || _bump + SLOT_BYTES > _end) {
+
+				char* s = (char*) ll_mmap_hugepages(LL_SLAB_BYTES);
+				if (s == NULL) s = (char*) malloc(LL_SLAB_BYTES);
+				if (s == NULL) {
+					if (i > 0) break;
+					LL_E_PRINT("** OUT OF MEMORY **\n");
+					abort();
+				}
+
+				_bump = s;
+				_end = s + LL_SLAB_BYTES;
+			}
+
+			void* p = _bump;
+			_bump += SLOT_BYTES;
+
+			*(void**) p = _tl_free;
+			_tl_free = p;
+		}
+
+		ll_spinlock_release(&_lock);
+	}
+};
+
+template <size_t B> ll_spinlock_t ll_slab_block_source<B>::_lock = 0;
+template <size_t B> char* ll_slab_block_source<B>::_bump = NULL;
+template <size_t B> char* ll_slab_block_source<B>::_end = NULL;
+template <size_t B> __thread void* ll_slab_block_source<B>::_tl_free = NULL;
+
+
+/**
+ * Slab Allocator: serves requests of exactly BlockBytes from the slab
+ * pool above and anything else (e.g. the growable array's pointer table)
+ * from malloc. A 16-byte prefix records where each allocation came from,
+ * so the paired deallocator can route the free without knowing the size.
+ */
+template <size_t BlockBytes>
+struct ll_slab_block_allocator {
+
+	inline void* operator() (size_t bytes) {
+
+		char* p;
+
+		if (bytes == BlockBytes) {
+			p = (char*) ll_slab_block_source<BlockBytes>::allocate();
+			((size_t*) p)[0] = 1;
+		}
+		else {
+			p = (char*) malloc(bytes + 16);
+			if (p == NULL) return NULL;
+			((size_t*) p)[0] = 0;
+		}
+
+		return p + 16;
+	}
+};
+
+
 /**
- * A growable block array
+ * Slab Deallocator
+ */
+template <size_t BlockBytes>
+struct ll_slab_block_deallocator {
+
+	inline void operator() (void* buffer) {
+		char* p = ((char*) buffer) - 16;
+		if (((size_t*) p)[0]) {
+			ll_slab_block_source<BlockBytes>::release(p);
+		}
+		else {
+			free(p);
+		}
+	}
+};
+
+
+// The allocation size above which ll_hugepage_block_allocator uses hugepages
+#define LL_HUGEPAGE_BLOCK_THRESHOLD		(2ul * 1048576)
+
+
+/**
+ * Hugepage Block Allocator
+ *
+ * A drop-in block_allocator for instantiations whose blocks are large (a
+ * high _block_size2 with a wide element type): allocations of 2 MB and
+ * above are backed by hugepages via ll_mmap_hugepages, which cuts DTLB
+ * misses in later scans of the array, while small requests -- including
+ * the pointer table -- fall through to malloc. The allocation size and
+ * kind go into a 16-byte prefix so that the matching deallocator can pair
+ * munmap/free correctly, like ll_slab_block_deallocator does.
+ */
+struct ll_hugepage_block_allocator {
+
+	inline void* operator() (size_t bytes) {
+
+		size_t total = bytes + 16;
+		void* p = NULL;
+		size_t mapped = 0;
+
+		if (total >= LL_HUGEPAGE_BLOCK_THRESHOLD) {
+			p = ll_mmap_hugepages(total);
+			if (p != NULL) mapped = 1;
+		}
+		if (p == NULL) p = malloc(total);
+		if (p == NULL) {
+			LL_E_PRINT("** OUT OF MEMORY **\n");
+			abort();
+		}
+
+		((size_t*) p)[0] = total;
+		((size_t*) p)[1] = mapped;
+
+		return ((char*) p) + 16;
+	}
+};
+
+
+/**
+ * Hugepage Block Deallocator
+ */
+struct ll_hugepage_block_deallocator {
+
+	inline void operator() (void* buffer) {
+		char* p = ((char*) buffer) - 16;
+		if (((size_t*) p)[1]) {
+			munmap(p, ((size_t*) p)[0]);
+		}
+		else {
+			free(p);
+		}
+	}
+};
+
+
+/**
+ * A growable block array. Concurrent appends are lock-free in the common
+ * case: the slot index is claimed with an atomic fetch-and-add, and only
+ * the rare block allocation / pointer table growth takes the spinlock.
+ * Readers that run concurrently with appenders must tolerate in-flight
+ * appends, whose values are not yet stored (this was already the case
+ * with the fully locked version, which released the lock before the
+ * caller initialized the new cell).
  */
 template <typename T, int _block_size2, class deallocator,
 		 bool use_deallocator=true,
@@ -76,15 +290,41 @@ class ll_growable_array {
 
 private:
 
+	// The append counter lives on its own cache line: every append
+	// dirties it with an atomic RMW, and letting it share a line with
+	// the block directory would keep invalidating _arrays for the
+	// readers. The remaining fields share the second line -- full
+	// per-field padding is not worth it here, since the writable graph
+	// embeds two of these arrays in every node.
+
+	// 64-bit: large graphs exceed 2^31 writable elements, and a 32-bit
+	// counter would silently wrap under the size_t cast on the read path.
+	// The counter is kept off the directory's cache line with explicit
+	// pads, not aligned(64): growable arrays sit inside heap-allocated
+	// owners (page managers, the persistence context), and C++11 new
+	// does not honor extended member alignment
+	char _size_pad0[64];
+	int64_t _size;
+	char _size_pad1[64 - sizeof(int64_t)];
+
 	int _blocks;
-	int _size;
 	T** _arrays;
 
 	deallocator _deallocator;
 	block_allocator _block_allocator;
 	block_deallocator _block_deallocator;
 
-	ll_spinlock_t _lock;
+	// The grow-path lock: a queued (MCS) lock, since when many loader
+	// threads cross block boundaries together the contenders pile up
+	// here and a test-and-set lock's line would bounce across sockets
+	ll_mcs_lock_t _lock;
+
+	// Pointer tables retired by directory growth; they are freed only on
+	// destruction, so a concurrent append can keep dereferencing a stale
+	// table without holding any lock. Allocated lazily -- most instances
+	// never outgrow their initial table
+	T*** _retired;
+	int _num_retired;
 
 
 public:
@@ -97,7 +337,9 @@ public:
 	ll_growable_array(int blocks = 16) {
 		_blocks = blocks;
 		_size = 0;
-		_lock = 0;
+		_lock = NULL;
+		_retired = NULL;
+		_num_retired = 0;
 		_arrays = (T**) _block_allocator(sizeof(T*) * _blocks);
 		memset(_arrays, 0, sizeof(T*) * _blocks);
 		_arrays[0] = (T*) _block_allocator(sizeof(T) * (1 << _block_size2));
@@ -123,9 +365,14 @@ public:
 					_block_deallocator(_arrays[i]);
 			}
 
-			if (use_block_deallocator)
+			if (use_block_deallocator) {
+				for (int i = 0; i < _num_retired; i++)
+					_block_deallocator(_retired[i]);
 				_block_deallocator(_arrays);
+			}
 		}
+
+		if (_retired != NULL) free(_retired);
 	}
 
 
@@ -164,30 +411,68 @@ public:
 	 * @return a pointer to the new uninitialized cell
 	 */
 	T* append(void) {
-		ll_spinlock_acquire(&_lock);
 
-		T* p = &_arrays[_size >> _block_size2][_size & ((1 << _block_size2) - 1)];
-		_size++;
+		int64_t idx = __sync_fetch_and_add(&_size, (int64_t) 1);
+		int b = (int) (idx >> _block_size2);
 
-		if ((_size & ((1 << _block_size2) - 1)) == 0) {
-			int newBlock = _size >> _block_size2;
-			if (newBlock == _blocks) {
-				int n = _blocks * 2;
-				T** a = (T**) _block_allocator(sizeof(T*) * n);
-				memcpy(a, _arrays, sizeof(T*) * _blocks);
-				memset(&a[_blocks], 0, sizeof(T*) * (n - _blocks));
-				if (use_block_deallocator)
-					_block_deallocator(_arrays);
-				_arrays = a;
-				_blocks = n;
-			}
-			if (_arrays[newBlock] == NULL) {
-				_arrays[newBlock] = (T*) _block_allocator(sizeof(T) * (1 << _block_size2));
-			}
+		if (((idx + 1) & ((1 << _block_size2) - 1)) == 0) {
+			publish_block(b + 1);
 		}
 
-		ll_spinlock_release(&_lock);
-		return p;
+		// The claimed slot's block might not be published yet if the
+		// claimant of the previous block's last slot is still inside
+		// publish_block() -- and that holds even when we just published
+		// b + 1 ourselves, so the wait is unconditional
+
+		wait_for_block(b);
+
+		T** a = *((T** volatile*) &_arrays);
+		return &a[b][idx & ((1 << _block_size2) - 1)];
+	}
+
+
+	/**
+	 * Append a batch of values, reserving all the slots with a single
+	 * atomic operation and copying block-sized spans with memcpy. The
+	 * caller takes over the publishing duties for every block boundary
+	 * inside the reserved range, just as if it had claimed the
+	 * corresponding slots one by one.
+	 *
+	 * @param src the values to append
+	 * @param n the number of values
+	 */
+	void append_batch(const T* src, size_t n) {
+
+		if (n == 0) return;
+
+		int64_t start = __sync_fetch_and_add(&_size, (int64_t) n);
+		int64_t end = start + (int64_t) n;
+		int64_t mask = (1 << _block_size2) - 1;
+
+		// Publish the successor of every block whose last slot we
+		// claimed (there is exactly one publisher per block index, so
+		// this mirrors the scalar path)
+
+		for (int64_t e = start | mask; e < end; e += mask + 1)
+			publish_block((int) (e >> _block_size2) + 1);
+
+		// The first touched block is published by whoever claimed the
+		// slot just before ours (or by the constructor for block 0)
+
+		wait_for_block((int) (start >> _block_size2));
+
+		size_t copied = 0;
+		int64_t idx = start;
+		while (copied < n) {
+			int b = (int) (idx >> _block_size2);
+			int off = (int) (idx & mask);
+			size_t chunk = (size_t) (mask + 1 - off);
+			if (chunk > n - copied) chunk = n - copied;
+			T** a = *((T** volatile*) &_arrays);
+			memcpy(&a[b][off], src + copied, chunk * sizeof(T));
+			copied += chunk;
+			idx += (int64_t) chunk;
+		}
 	}
 
 
@@ -203,6 +488,34 @@ public:
 	}
 
 
+	/**
+	 * Try to grow by one without entering the slow path: fails, without
+	 * reserving anything, when the tail block is not published yet --
+	 * i.e. when an append would have to allocate a block or wait for a
+	 * publisher. The caller can fall back to the blocking append() or do
+	 * other work first.
+	 *
+	 * A claimed slot can never be handed back (un-claiming by
+	 * decrementing the counter would let a later claimant's index escape
+	 * the published size), so the check happens before the claim and a
+	 * lost race simply takes the slow path inside append().
+	 *
+	 * @param out the reserved uninitialized cell on success
+	 * @return true if a slot was reserved
+	 */
+	bool try_append(T*& out) {
+
+		int64_t s = *((volatile int64_t*) &_size);
+		int b = (int) (s >> _block_size2);
+
+		if (b >= *((volatile int*) &_blocks)) return false;
+		if ((*((T** volatile*) &_arrays))[b] == NULL) return false;
+
+		out = append();
+		return true;
+	}
+
+
 	/**
 	 * Read from the array
 	 *
@@ -251,6 +564,102 @@ public:
 			? 1 << _block_size2
 			: (_size & ((1 << _block_size2) - 1));
 	}
+
+
+	/**
+	 * Visit the elements block by block: the functor is called with a raw
+	 * base pointer and the number of valid elements in that block. Scan
+	 * loops should prefer this to operator[] -- the inner loop becomes a
+	 * contiguous traversal that the hardware prefetcher can stream and
+	 * the compiler can vectorize, instead of re-loading the directory
+	 * entry for every element.
+	 *
+	 * @param f the functor called as f(T* base, size_t count)
+	 */
+	template <typename F>
+	inline void for_each_block(F f) const {
+		size_t n = _size;
+		for (size_t b = 0; n > 0; b++) {
+			size_t k = n < (size_t) (1 << _block_size2)
+				? n : (size_t) (1 << _block_size2);
+			f(_arrays[b], k);
+			n -= k;
+		}
+	}
+
+
+private:
+
+	/**
+	 * Publish the given block, growing the pointer table if needed. The
+	 * thread that claimed the last slot of a block publishes the next
+	 * one, matching the eager allocation of the locked version. Only
+	 * growing the pointer table itself takes the lock; publishing into
+	 * an already-covering table is done with plain stores, since there
+	 * is exactly one publisher per block index (the unique last-slot
+	 * claimant).
+	 *
+	 * @param newBlock the block number to publish
+	 */
+	void publish_block(int newBlock) {
+
+		if (newBlock >= *((volatile int*) &_blocks)) {
+
+			ll_mcs_node mcs;
+			ll_mcs_acquire(&_lock, &mcs);
+
+			if (newBlock >= _blocks) {
+				int n = _blocks;
+				while (newBlock >= n) n *= 2;
+				T** a = (T**) _block_allocator(sizeof(T*) * n);
+				memcpy(a, _arrays, sizeof(T*) * _blocks);
+				memset(&a[_blocks], 0, sizeof(T*) * (n - _blocks));
+				if (use_block_deallocator) {
+					if (_retired == NULL)
+						_retired = (T***) malloc(sizeof(T**) * 64);
+					assert(_num_retired < 64);
+					_retired[_num_retired++] = _arrays;
+				}
+				__sync_synchronize();
+				_arrays = a;
+				_blocks = n;
+			}
+
+			ll_mcs_release(&_lock, &mcs);
+		}
+
+		// The directory may be swapped for a bigger one while we
+		// store, and the grower's copy can miss our slot -- so
+		// re-publish until the table we wrote is still the current
+		// one. Stale tables are retired, never freed, so a late
+		// store into one is harmless.
+
+		T* block = NULL;
+		T** a;
+		do {
+			a = *((T** volatile*) &_arrays);
+			if (a[newBlock] == NULL) {
+				if (block == NULL) {
+					block = (T*) _block_allocator(
+							sizeof(T) * (1 << _block_size2));
+				}
+				__sync_synchronize();
+				a[newBlock] = block;
+			}
+			__sync_synchronize();
+		} while (a != *((T** volatile*) &_arrays));
+	}
+
+
+	/**
+	 * Wait until the given block is published
+	 *
+	 * @param b the block number
+	 */
+	inline void wait_for_block(int b) {
+		while (b >= *((volatile int*) &_blocks));
+		while ((*((T** volatile*) &_arrays))[b] == NULL);
+	}
 };
 
 #endif
@@ -38,6 +38,7 @@
 #define _LL_LOCK_H
 
 #include <stdint.h>
+#include <sched.h>
 
 /**
  * Spinlock
@@ -52,6 +53,10 @@ typedef volatile int32_t ll_spinlock_t;
  * @return true if acquired
  */
 inline bool ll_spinlock_try_acquire(ll_spinlock_t* ptr) {
+    // Test-and-test-and-set: a plain load first, so a try against a held
+    // lock stays a shared cache hit instead of a bus-locked xchg that
+    // steals the line from the holder
+    if (*ptr != 0) return false;
     int ret = __sync_lock_test_and_set(ptr, 1);
     return ret == 0; // 0 means success
 }
@@ -63,9 +68,27 @@ inline bool ll_spinlock_try_acquire(ll_spinlock_t* ptr) {
  * @param ptr the spinlock
  */
 inline void ll_spinlock_acquire(ll_spinlock_t* ptr) {
+    int backoff = 1;
+    int saturated = 0;
     while (__sync_lock_test_and_set(ptr, 1)) {
+        // Exponential backoff: each failed attempt doubles the pause
+        // window, so the waiters stop hammering the lock's cache line
+        // with coherence traffic while the holder works
         while (*ptr == 1) {
-			asm volatile ("pause" ::: "memory");
+            for (int i = 0; i < backoff; i++) {
+				asm volatile ("pause" ::: "memory");
+            }
+            if (backoff < 1024) {
+                backoff <<= 1;
+            }
+            else if (++saturated >= 16) {
+                // Still held after ~16K pauses: the holder is likely
+                // preempted (more runnable threads than cores), and no
+                // amount of spinning helps -- give up the CPU so it can
+                // actually run
+                sched_yield();
+                saturated = 0;
+            }
         }
     }
 }
@@ -77,12 +100,89 @@ inline void ll_spinlock_acquire(ll_spinlock_t* ptr) {
  * @param ptr the spinlock
  */
 inline void ll_spinlock_release(ll_spinlock_t* ptr) {
-	__sync_synchronize();
-    *ptr = 0;
+    // Release-ordered store: pairs with the acquire barrier of
+    // __sync_lock_test_and_set and compiles to a plain store on x86,
+    // where the old explicit __sync_synchronize() cost a full mfence
+    // on every unlock
+    __sync_lock_release(ptr);
 }
 
 
-#define LL_CACHELINE            8
+/**
+ * A waiter node for the MCS queued lock below. Stack-allocated at the
+ * acquisition site; padded to a cache line so two queued waiters never
+ * spin on the same line.
+ */
+struct ll_mcs_node {
+	struct ll_mcs_node* volatile next;
+	volatile int locked;
+} __attribute__((aligned(64)));
+
+
+/**
+ * MCS queued lock: the lock word holds the tail of the waiter queue.
+ * Each contender spins on its own node instead of the shared lock word,
+ * so a handoff costs one remote cache miss regardless of how many
+ * threads are queued -- unlike a test-and-set lock, whose line bounces
+ * across every waiting socket. Use it where contenders pile up; the
+ * plain spinlock remains cheaper when contention is rare.
+ */
+typedef struct ll_mcs_node* volatile ll_mcs_lock_t;
+
+
+/**
+ * Acquire an MCS lock
+ *
+ * @param lock the lock
+ * @param node this contender's waiter node (usually on the stack; must
+ *             stay alive until the matching release)
+ */
+inline void ll_mcs_acquire(ll_mcs_lock_t* lock, ll_mcs_node* node) {
+
+	node->next = NULL;
+	node->locked = 1;
+
+	ll_mcs_node* prev = (ll_mcs_node*)
+		__sync_lock_test_and_set(lock, node);
+	if (prev == NULL) return;
+
+	prev->next = node;
+	while (node->locked) {
+		asm volatile ("pause" ::: "memory");
+	}
+}
+
+
+/**
+ * Release an MCS lock
+ *
+ * @param lock the lock
+ * @param node the waiter node passed to the acquire
+ */
+inline void ll_mcs_release(ll_mcs_lock_t* lock, ll_mcs_node* node) {
+
+	if (node->next == NULL) {
+
+		// No known successor: try to close the queue; if that fails,
+		// someone is mid-enqueue -- wait for them to link in
+
+		if (__sync_bool_compare_and_swap(lock, node, NULL)) return;
+		while (node->next == NULL) {
+			asm volatile ("pause" ::: "memory");
+		}
+	}
+
+	__sync_lock_release(&node->next->locked);
+}
+
+
+/*
+ * The number of ll_spinlock_t slots per table entry: one full 64-byte
+ * cache line, so two logically distinct locks never share a line and
+ * ping it between cores on unrelated acquisitions. (The previous value
+ * of 8 slots was only 32 bytes -- half a line on x86-64 and ARM.)
+ */
+#define LL_CACHELINE            16
 
 
 /**
@@ -91,7 +191,48 @@ inline void ll_spinlock_release(ll_spinlock_t* ptr) {
 template <int size>					// Must be a power of 2
 class ll_spinlock_table_ext {
 
-	ll_spinlock_t ll_spinlock_tab[size * LL_CACHELINE];
+	// One extra entry of slack so the rounded-up base below always fits.
+	// An __attribute__((aligned(64))) member is not enough here: C++11
+	// operator new only guarantees alignof(max_align_t), so the attribute
+	// silently fails for every heap-allocated owner of a table (and GCC
+	// flags each such allocation with -Waligned-new). Rounding the base
+	// pointer up by hand guarantees the alignment no matter how the
+	// owner was allocated.
+	ll_spinlock_t ll_spinlock_storage[(size + 1) * LL_CACHELINE];
+
+
+	/**
+	 * Return the 64-byte-aligned base of the lock table. Recomputed from
+	 * the storage address on each use, so it stays correct even if the
+	 * owning object is copied or moved.
+	 *
+	 * @return the aligned table base
+	 */
+	inline ll_spinlock_t* tab() {
+		return (ll_spinlock_t*) (((uintptr_t) ll_spinlock_storage + 63)
+				& ~(uintptr_t) 63);
+	}
+
+
+	/**
+	 * Map a key to its table entry. Keys here are mostly sequential node
+	 * IDs, and taking the low bits directly would map neighboring nodes
+	 * -- which different threads tend to work on at the same time -- to
+	 * neighboring table entries. A Fibonacci multiplicative hash spreads
+	 * adjacent keys across the whole table instead; the top bits of the
+	 * product are the well-mixed ones, so the index comes from there.
+	 * Both acquire and release go through this, so the mapping stays
+	 * consistent and mutual exclusion per key is unaffected.
+	 *
+	 * @param x the value
+	 * @return the entry index
+	 */
+	template <typename T>
+	static inline uint32_t entry_for(T x) {
+		if (size <= 1) return 0;
+		uint32_t h = ((uint32_t) x) * 2654435761u;
+		return h >> (32 - __builtin_ctz((unsigned) size));
+	}
 
 
 public:
@@ -100,8 +241,9 @@ public:
 	 * Initialize
 	 */
 	ll_spinlock_table_ext() {
+		ll_spinlock_t* t = tab();
 		for (int i = 0; i < size * LL_CACHELINE; i++)
-			ll_spinlock_tab[i] = 0;
+			t[i] = 0;
 	}
 
 
@@ -112,9 +254,8 @@ public:
 	 */
 	template <typename T>
 	void acquire_for(T x) {
-		uint32_t entry_idx = (uint32_t)(x & (size - 1));
-		uint32_t tab_idx = entry_idx * LL_CACHELINE;
-		ll_spinlock_acquire(&ll_spinlock_tab[tab_idx]);
+		uint32_t tab_idx = entry_for(x) * LL_CACHELINE;
+		ll_spinlock_acquire(&tab()[tab_idx]);
 	}
 
 
@@ -125,9 +266,8 @@ public:
 	 */
 	template <typename T>
 	void release_for(T x) {
-		uint32_t entry_idx = (uint32_t)(x & (size - 1));
-		uint32_t tab_idx = entry_idx * LL_CACHELINE;
-		ll_spinlock_release(&ll_spinlock_tab[tab_idx]);
+		uint32_t tab_idx = entry_for(x) * LL_CACHELINE;
+		ll_spinlock_release(&tab()[tab_idx]);
 	}
 };
 
@@ -54,6 +54,7 @@
 #include <fcntl.h>
 #include <unistd.h>
 
+#include <limits>
 #include <unordered_map>
 #include <vector>
 
@@ -77,6 +78,59 @@ typedef struct {
 } ll_vertex_iterator;
 
 
+/**
+ * Find the first element in [from, to) at which the two arrays differ.
+ *
+ * Integral elements compare equal exactly when their bytes do, so the scan
+ * runs four machine words at a time instead of one element at a time --
+ * the modified-node iterators spend most of their time in this compare.
+ * Floating point must not take the word path (-0.0 == 0.0 and NaN != NaN),
+ * and neither may element types with their own operator==, so those fall
+ * back to the element-wise loop; the choice folds at compile time.
+ *
+ * @param d the first array
+ * @param p the second array
+ * @param from the first index to compare
+ * @param to the index at which to stop (exclusive)
+ * @return the first differing index, or to if the ranges are equal
+ */
+template <typename T>
+inline size_t ll_vt_first_diff(const T* d, const T* p, size_t from, size_t to) {
+
+	if (std::numeric_limits<T>::is_integer) {
+
+		const unsigned char* a = (const unsigned char*) (const void*) d;
+		const unsigned char* b = (const unsigned char*) (const void*) p;
+		size_t o = from * sizeof(T);
+		size_t bytes = to * sizeof(T);
+
+		while (o + 32 <= bytes) {
+			uint64_t x0 = *(const uint64_t*) (const void*) (a + o)
+				^ *(const uint64_t*) (const void*) (b + o);
+			uint64_t x1 = *(const uint64_t*) (const void*) (a + o + 8)
+				^ *(const uint64_t*) (const void*) (b + o + 8);
+			uint64_t x2 = *(const uint64_t*) (const void*) (a + o + 16)
+				^ *(const uint64_t*) (const void*) (b + o + 16);
+			uint64_t x3 = *(const uint64_t*) (const void*) (a + o + 24)
+				^ *(const uint64_t*) (const void*) (b + o + 24);
+			if ((x0 | x1 | x2 | x3) != 0) break;
+			o += 32;
+		}
+		while (o + 8 <= bytes
+				&& *(const uint64_t*) (const void*) (a + o)
+					== *(const uint64_t*) (const void*) (b + o))
+			o += 8;
+		while (o < bytes && a[o] == b[o]) o++;
+
+		return o / sizeof(T);
+	}
+
+	size_t i = from;
+	while (i < to && d[i] == p[i]) i++;
+	return i;
+}
+
+
 
 //==========================================================================//
 // Class: ll_mem_array_collection                                           //
@@ -92,6 +146,17 @@ class ll_mem_array_collection {
 	ll_page_manager<T>* _page_manager;
 	bool _own_page_manager;
 
+	/// Cache of the latest level, so the hot read path does not reload
+	/// _max_level and the _levels vector on every access
+	VT* _latest;
+
+#ifdef LL_ONE_VT
+	/// The single shared data array (all flat levels read through this
+	/// slot, so growing the array updates one pointer here instead of
+	/// patching every level)
+	T* _one_vt_array;
+#endif
+
 	ll_mem_array_collection<VT, T>* _master;
 	
 #ifdef LL_MIN_LEVEL
@@ -123,6 +188,11 @@ public:
 		_own_page_manager = true;
 		_max_level = -1;
 		_master = NULL;
+		_latest = NULL;
+
+#ifdef LL_ONE_VT
+		_one_vt_array = NULL;
+#endif
 
 #ifdef LL_MIN_LEVEL
 		_min_level = 0;
@@ -142,6 +212,11 @@ public:
 		_own_page_manager = true;
 		_max_level = -1;
 		_master = NULL;
+		_latest = NULL;
+
+#ifdef LL_ONE_VT
+		_one_vt_array = NULL;
+#endif
 
 #ifdef LL_MIN_LEVEL
 		_min_level = 0;
@@ -161,6 +236,11 @@ public:
 		_own_page_manager = own_page_manager;
 		_max_level = -1;
 		_master = NULL;
+		_latest = NULL;
+
+#ifdef LL_ONE_VT
+		_one_vt_array = NULL;
+#endif
 
 #ifdef LL_MIN_LEVEL
 		_min_level = 0;
@@ -182,6 +262,11 @@ public:
 		_own_page_manager = false;
 		_page_manager = master->_page_manager;
 		_max_level = master->_max_level;
+		_latest = master->_latest;
+
+#ifdef LL_ONE_VT
+		_one_vt_array = master->_one_vt_array;
+#endif
 
 		if (level >= (int) master->size()) level = (int) master->size() - 1;
 		if (level < 0) level = 0;
@@ -228,6 +313,41 @@ public:
 	}
 
 
+#ifdef LL_ONE_VT
+
+	/**
+	 * Get the slot through which the levels read the shared array
+	 *
+	 * @return the slot
+	 */
+	inline T* const* one_vt_slot() {
+		return &_one_vt_array;
+	}
+
+
+	/**
+	 * Get the shared array
+	 *
+	 * @return the shared array
+	 */
+	inline T* one_vt_get() {
+		return _one_vt_array;
+	}
+
+
+	/**
+	 * Publish a new shared array: a single store that every level
+	 * observes through its slot pointer
+	 *
+	 * @param a the new array
+	 */
+	inline void one_vt_set(T* a) {
+		*((T* volatile*) &_one_vt_array) = a;
+	}
+
+#endif
+
+
 	/**
 	 * Get the appropriate level
 	 *
@@ -380,8 +500,7 @@ public:
 	 * @return the latest level if available, or NULL otherwise
 	 */
 	VT* latest_level() {
-		if (_max_level < 0) return NULL;
-		return (*this)[_max_level];
+		return _latest;
 	}
 
 
@@ -391,8 +510,19 @@ public:
 	 * @return the latest level if available, or NULL otherwise
 	 */
 	const VT* latest_level() const {
-		if (_max_level < 0) return NULL;
-		return (*this)[_max_level];
+		return _latest;
+	}
+
+
+	/**
+	 * Read a value from the latest level: a fused form of
+	 * latest_level()->operator[] that skips the level lookup
+	 *
+	 * @param node the node
+	 * @return the value
+	 */
+	inline const T& at(node_t node) const {
+		return (*_latest)[node];
 	}
 
 
@@ -405,19 +535,24 @@ public:
 		
 #ifdef LL_MLCSR_LEVEL_ID_WRAP
 		
+		// Compute the wrap and the two full-table conditions without
+		// cascaded branches: one predictable select for the wrap, and a
+		// single combined predicted-not-taken branch for the abort.
+		// (LL_MAX_LEVEL + 1 is not a power of two, so the wrap cannot be
+		// a plain mask.)
+
 		int new_level_id = _max_level + 1;
-		if (new_level_id > (int) LL_MAX_LEVEL) {
-			new_level_id = 0;
-			if (_min_level == 0) {
-				LL_E_PRINT("Maximum number of levels reached (%ld)\n",
-						(ssize_t) LL_MAX_LEVEL + 1);
-				LL_E_PRINT("Min level = %ld, max level = %ld\n",
-						(ssize_t) _min_level, (ssize_t) _max_level);
-				abort();
-			}
-		}
+		bool wrapped = new_level_id > (int) LL_MAX_LEVEL;
+		new_level_id = wrapped ? 0 : new_level_id;
+
+		// Full if the ID wrapped onto an un-vacated level 0, or if the
+		// write position, already below _min_level, would catch up to it
 
-		if (_max_level >= 0 && _max_level < _min_level && new_level_id >= _min_level) {
+		bool full = (wrapped & (_min_level == 0))
+			| ((_max_level >= 0) & (_max_level < _min_level)
+					& (new_level_id >= _min_level));
+
+		if (__builtin_expect(full, 0)) {
 			LL_E_PRINT("Maximum number of levels reached (%ld)\n",
 						(ssize_t) LL_MAX_LEVEL + 1);
 			LL_E_PRINT("Min level = %ld, max level = %ld\n",
@@ -428,7 +563,7 @@ public:
 #else
 
 		int new_level_id = _levels.size();
-		if (new_level_id > (int) LL_MAX_LEVEL) {
+		if (__builtin_expect(new_level_id > (int) LL_MAX_LEVEL, 0)) {
 			LL_E_PRINT("Maximum number of levels reached (%ld)\n",
 						(ssize_t) LL_MAX_LEVEL + 1);
 			abort();
@@ -466,6 +601,8 @@ public:
 		_levels.push_back(v);
 #endif
 
+		_latest = v;
+
 		return v;
 	}
 
@@ -494,6 +631,8 @@ public:
 
 		delete _levels[level];
 		_levels[level] = NULL;
+
+		if ((int) level == _max_level) _latest = NULL;
 	}
 
 
@@ -571,36 +710,55 @@ public:
 		
 #ifdef LL_ONE_VT
 
+		// All levels read the shared array through the collection's slot,
+		// so a realloc that moves the buffer is published with a single
+		// store -- no O(levels) fixup, and no window in which another
+		// level still holds the stale pointer
+
+		_array_slot = levels->one_vt_slot();
+
 		if (level == 0) {
-			_array = (T*) malloc(sizeof(T) * (size + LL_ENTRIES_PER_PAGE));
-			memset(_array, 0xff, sizeof(T) * (size + LL_ENTRIES_PER_PAGE));
+			T* a = (T*) malloc(sizeof(T) * (size + LL_ENTRIES_PER_PAGE));
+			memset(a, 0xff, sizeof(T) * (size + LL_ENTRIES_PER_PAGE));
+			levels->one_vt_set(a);
 		}
 		else {
 			ll_mem_array_flat<T>* p = (*_levels)[level-1];
 			if (size < p->_size) {
 				LL_NOT_IMPLEMENTED;
 			}
-			else if (size == p->_size) {
-				_array = p->_array;
-			}
-			else {
-				_array = (T*) realloc(p->_array, (size + 4) * sizeof(T));
-				memset(&_array[p->_size + 4], 0xff,
+			else if (size != p->_size) {
+				T* a = (T*) realloc(levels->one_vt_get(),
+						(size + 4) * sizeof(T));
+				memset(&a[p->_size + 4], 0xff,
 						sizeof(T) * (size - p->_size));
-				if (_array != p->_array) {
-					for (int l = 0; l < _level; l++) {
-						(*_levels)[l]->_array = _array;
-					}
-				}
+				levels->one_vt_set(a);
 			}
 		}
 
 #else
 
-		_array = (T*) malloc(sizeof(T) * (size + LL_ENTRIES_PER_PAGE));
+		// Large tables go on hugepages: the table is scanned end to end by
+		// the iterators and the CSR builders, and 4 KB pages thrash the
+		// DTLB on every pass. No MAP_POPULATE is needed -- the 0xff fill
+		// below faults every page anyway.
+
+		size_t bytes = sizeof(T) * (size + LL_ENTRIES_PER_PAGE);
+		_mapped_bytes = 0;
+		_array = NULL;
+
+		if (bytes >= LL_HUGEPAGE_BLOCK_THRESHOLD) {
+			_array = (T*) ll_mmap_hugepages(bytes);
+			if (_array != NULL) _mapped_bytes = bytes;
+		}
+		if (_array == NULL) _array = (T*) malloc(bytes);
+		if (_array == NULL) {
+			LL_E_PRINT("** OUT OF MEMORY **\n");
+			abort();
+		}
 
 		// TODO How to configure this? This is assumed by ll_slcsr
-		memset(_array, 0xff, sizeof(T) * (size + LL_ENTRIES_PER_PAGE));
+		memset(_array, 0xff, bytes);
 
 #endif
 		
@@ -614,9 +772,14 @@ public:
 	~ll_mem_array_flat(void) {
 
 #ifdef LL_ONE_VT
-		if (_level == 0) free(_array);
+		if (_level == 0) free(*_array_slot);
 #else
-		free(_array);
+		if (_mapped_bytes != 0) {
+			munmap(_array, _mapped_bytes);
+		}
+		else {
+			free(_array);
+		}
 #endif
 	}
 
@@ -647,7 +810,8 @@ public:
 		if (_levels->has_prev_level(_level)) {
 			ll_mem_array_flat<T>* p = _levels->prev_level(_level);
 			size_t l = std::min(_size, p->_size) + 4;
-			if (_array != p->_array) memcpy(_array, p->_array, l * sizeof(T));
+			if (data() != p->data())
+				memcpy(data(), p->data(), l * sizeof(T));
 		}
 	}
 
@@ -680,7 +844,7 @@ public:
 	 * @return the associated value
 	 */
 	inline const T& operator[] (node_t node) const {
-		return _array[node];
+		return data()[node];
 	}
 
 
@@ -692,7 +856,7 @@ public:
 	 */
 	void append_node(node_t node, const T& value) {
 		assert(_write == node);
-		_array[_write++] = value;
+		data()[_write++] = value;
 	}
 
 
@@ -715,7 +879,7 @@ public:
 	 */
 	void update_node(node_t node, const T& value) {
 		assert(node < _size);
-		_array[node] = value;
+		data()[node] = value;
 	}
 
 
@@ -739,14 +903,11 @@ public:
 
 		if (_levels->has_prev_level(_level)) {
 			auto prev = _levels->prev_level(_level);
-			while (iter.vi_next_node < (node_t) prev->_size
-					&& iter.vi_next_node < iter.vi_end) {
-				if (_array[iter.vi_next_node] == prev->_array[iter.vi_next_node]) {
-					iter.vi_next_node++;
-				}
-				else {
-					break;
-				}
+			node_t lim = std::min<node_t>((node_t) prev->_size, iter.vi_end);
+			if (iter.vi_next_node < lim) {
+				iter.vi_next_node = (node_t) ll_vt_first_diff(data(),
+						prev->data(), (size_t) iter.vi_next_node,
+						(size_t) lim);
 			}
 		}
 	}
@@ -766,18 +927,16 @@ public:
 			return LL_NIL_NODE;
 		}
 		else {
-			iter.vi_value = &_array[r];
+			iter.vi_value = &data()[r];
 
 			if (_levels->has_prev_level(_level)) {
 				auto prev = _levels->prev_level(_level);
-				while (iter.vi_next_node < (node_t) prev->_size
-						&& iter.vi_next_node < iter.vi_end) {
-					if (_array[iter.vi_next_node] == prev->_array[iter.vi_next_node]) {
-						iter.vi_next_node++;
-					}
-					else {
-						break;
-					}
+				node_t lim = std::min<node_t>((node_t) prev->_size,
+						iter.vi_end);
+				if (iter.vi_next_node < lim) {
+					iter.vi_next_node = (node_t) ll_vt_first_diff(data(),
+							prev->data(), (size_t) iter.vi_next_node,
+							(size_t) lim);
 				}
 			}
 		}
@@ -802,6 +961,78 @@ public:
 	}
 
 
+	/**
+	 * Get a batch of next (maybe) modified nodes: equivalent to calling
+	 * modified_node_iter_next() up to max times, but with the previous
+	 * level hoisted out of the per-node work. Does not set vi_value; use
+	 * operator[] on the returned IDs instead.
+	 *
+	 * @param iter the iterator variable
+	 * @param out the output array for the node IDs
+	 * @param max the maximum number of nodes to return
+	 * @return the number of nodes written to out
+	 */
+	size_t modified_node_iter_next_batch(ll_vertex_iterator& iter,
+			node_t* out, size_t max) {
+
+		size_t count = 0;
+
+		if (!_levels->has_prev_level(_level)) {
+			while (count < max && iter.vi_next_node < iter.vi_end)
+				out[count++] = iter.vi_next_node++;
+			return count;
+		}
+
+		auto prev = _levels->prev_level(_level);
+		node_t lim = std::min<node_t>((node_t) prev->_size, iter.vi_end);
+
+		while (count < max) {
+			node_t r = iter.vi_next_node++;
+			if (r >= iter.vi_end) break;
+			out[count++] = r;
+
+			if (iter.vi_next_node < lim) {
+				iter.vi_next_node = (node_t) ll_vt_first_diff(data(),
+						prev->data(), (size_t) iter.vi_next_node,
+						(size_t) lim);
+			}
+		}
+
+		return count;
+	}
+
+
+	/**
+	 * Get the next run of consecutive (maybe) modified nodes, so that the
+	 * caller can process [out_start, out_end) with a raw loop over the
+	 * values instead of one iterator call per node.
+	 *
+	 * @param iter the iterator variable
+	 * @param out_start the first node of the run
+	 * @param out_end the end of the run (exclusive)
+	 * @return true if a run was found, false if the iterator is exhausted
+	 */
+	bool next_modified_run(ll_vertex_iterator& iter,
+			node_t& out_start, node_t& out_end) {
+
+		node_t n = modified_node_iter_next(iter);
+		if (n == LL_NIL_NODE) return false;
+
+		out_start = n;
+		node_t expect = n + 1;
+
+		while (iter.vi_next_node == expect && expect < iter.vi_end) {
+			node_t m = modified_node_iter_next(iter);
+			assert(m == expect);
+			(void) m;
+			expect++;
+		}
+
+		out_end = expect;
+		return true;
+	}
+
+
 	/**
 	 * Direct write into a dense table
 	 *
@@ -809,7 +1040,7 @@ public:
 	 * @param value the value
 	 */
 	void dense_direct_write(node_t node, const T& value) {
-		_array[node] = value;
+		data()[node] = value;
 	}
 
 
@@ -828,7 +1059,7 @@ public:
 	 * @param value the value
 	 */
 	void cow_write(node_t node, const T& value) {
-		_array[node] = value;
+		data()[node] = value;
 	}
 
 
@@ -858,7 +1089,31 @@ public:
 		if (_size < size) return;
 
 		_size = size;
-		_array = (T*) realloc(_array, sizeof(T) * (_size + LL_ENTRIES_PER_PAGE));
+
+#ifndef LL_ONE_VT
+		if (_mapped_bytes != 0) {
+
+			// A mapped table cannot be realloc-ed; return the tail to the
+			// OS instead and keep the mapping (and the pointer) intact
+
+			size_t keep = sizeof(T) * (_size + LL_ENTRIES_PER_PAGE);
+			keep = (keep + LL_HUGEPAGE_BLOCK_THRESHOLD - 1)
+				& ~(LL_HUGEPAGE_BLOCK_THRESHOLD - 1);
+			if (keep < _mapped_bytes) {
+				madvise(((char*) _array) + keep, _mapped_bytes - keep,
+						MADV_DONTNEED);
+			}
+			return;
+		}
+#endif
+
+#ifdef LL_ONE_VT
+		_levels->one_vt_set((T*) realloc(_levels->one_vt_get(),
+				sizeof(T) * (_size + LL_ENTRIES_PER_PAGE)));
+#else
+		_array = (T*) realloc(_array,
+				sizeof(T) * (_size + LL_ENTRIES_PER_PAGE));
+#endif
 	}
 
 
@@ -880,16 +1135,38 @@ public:
 	 * @param index the page index
 	 */
 	inline T* page(size_t index) {
-		return &_array[index << LL_ENTRIES_PER_PAGE_BITS];
+		return &data()[index << LL_ENTRIES_PER_PAGE_BITS];
 	}
 
 
 
 private:
 
+	/**
+	 * Get the data array
+	 *
+	 * @return the data array
+	 */
+	inline T* data() const {
+#ifdef LL_ONE_VT
+		return *_array_slot;
+#else
+		return _array;
+#endif
+	}
+
+
+#ifdef LL_ONE_VT
+	/// The collection's slot holding the shared array
+	T* const* _array_slot;
+#else
 	/// The array
 	T* _array;
 
+	/// The size of the mapping if _array is mmap-ed, or 0 if malloc-ed
+	size_t _mapped_bytes;
+#endif
+
 	/// The array size
 	size_t _size;
 
@@ -1042,8 +1319,8 @@ public:
 		assert(_indirection == NULL && _page_ids == NULL);
 		_indirection = (T**) malloc(sizeof(T*) * (_pages + 1));
 		memset(_indirection, 0, sizeof(T*) * (_pages + 1));
-		_page_ids = (size_t*) malloc(sizeof(size_t) * (_pages + 1));
-		memset(_page_ids, 0xff, sizeof(size_t) * (_pages + 1));
+		_page_ids = (ll_page_id_t*) malloc(sizeof(ll_page_id_t) * (_pages + 1));
+		memset(_page_ids, 0xff, sizeof(ll_page_id_t) * (_pages + 1));
 
 		// TODO Make sure this allocates contiguous memory for FORCE_L0
 		_levels->page_manager()->allocate(_indirection, _page_ids, _pages + 1);
@@ -1103,8 +1380,9 @@ public:
 		else {
 			_indirection = (T**) malloc(sizeof(T*) * (_pages + 1));
 			memset(_indirection, 0, sizeof(T*) * (_pages + 1));
-			_page_ids = (size_t*) malloc(sizeof(size_t) * (_pages + 1));
-			memset(_page_ids, 0xff, sizeof(size_t) * (_pages + 1));
+			_page_ids = (ll_page_id_t*) malloc(
+					sizeof(ll_page_id_t) * (_pages + 1));
+			memset(_page_ids, 0xff, sizeof(ll_page_id_t) * (_pages + 1));
 			copy_indirection_range(0, _pages + 1);
 		}
 	}
@@ -1127,9 +1405,11 @@ public:
 				auto vt = _levels->prev_level(_level);
 				if (_indirection == vt->_indirection) {
 					_indirection = (T**) malloc(sizeof(T*) * (_pages + 1));
-					_page_ids = (size_t*) malloc(sizeof(size_t) * (_pages + 1));
+					_page_ids = (ll_page_id_t*) malloc(
+							sizeof(ll_page_id_t) * (_pages + 1));
 					memcpy(_indirection, vt->_indirection, sizeof(T*) * (_pages + 1));
-					memcpy(_page_ids, vt->_page_ids, sizeof(size_t) * (_pages + 1));
+					memcpy(_page_ids, vt->_page_ids,
+							sizeof(ll_page_id_t) * (_pages + 1));
 				}
 			}
 			ll_spinlock_release(&_cow_spinlock);
@@ -1260,33 +1540,55 @@ public:
 				assert(page < _pages);
 				T* d = _indirection[page];
 
+				// Overlap the next page boundary's table lookups with this
+				// page's scan -- the page_id -> page_ptr -> contents chain
+				// is otherwise a serial dependent-load sequence
+
+				__builtin_prefetch(&_indirection[page + 1], 0, 1);
+				__builtin_prefetch(&prev->_indirection[page + 1], 0, 1);
+
 
 				// If there is a corresponding page in prev
 
 				if (d != zp && page < prev->_pages) {
 					T* p = prev->_indirection[page];
 					
-					// If the page in prev is identical
+					// If the page in prev is identical: walk the two page
+					// tables directly while the pages stay shared -- one
+					// pointer compare per page instead of re-running the
+					// full set of outer checks per page boundary
 
 					if (d == p) {
-						iter.vi_next_node = (iter.vi_next_node + LL_ENTRIES_PER_PAGE)
-							& ~(LL_ENTRIES_PER_PAGE - 1);
+						size_t max_page = _pages < prev->_pages
+							? _pages : prev->_pages;
+						do {
+							page++;
+						} while (page < max_page
+								&& _indirection[page]
+									== prev->_indirection[page]
+								&& _indirection[page] != zp);
+						iter.vi_next_node = (node_t)
+							(page << LL_ENTRIES_PER_PAGE_BITS);
 						continue;
 					}
 					else {
 
 						// The page in prev is different
 
+						if (page + 1 < _pages)
+							__builtin_prefetch(_indirection[page + 1], 0, 0);
+
 						size_t i = iter.vi_next_node
 							& (LL_ENTRIES_PER_PAGE - 1);
 
-						while (i < LL_ENTRIES_PER_PAGE && iter.vi_next_node < iter.vi_end) {
-
-							if (d[i] != p[i]) return r;
+						size_t lim = LL_ENTRIES_PER_PAGE;
+						size_t left = (size_t)
+							(iter.vi_end - iter.vi_next_node);
+						if (lim - i > left) lim = i + left;
 
-							iter.vi_next_node++;
-							i++;
-						}
+						size_t j = ll_vt_first_diff(d, p, i, lim);
+						iter.vi_next_node += j - i;
+						if (j < lim) return r;
 					}
 				}
 				else {
@@ -1318,6 +1620,119 @@ public:
 	}
 
 
+	/**
+	 * Get a batch of next (maybe) modified nodes: equivalent to calling
+	 * modified_node_iter_next() up to max times, but the previous level,
+	 * its page table and the zero page are loaded once per batch instead
+	 * of once per node. Does not set vi_value; use operator[] on the
+	 * returned IDs instead.
+	 *
+	 * @param iter the iterator variable
+	 * @param out the output array for the node IDs
+	 * @param max the maximum number of nodes to return
+	 * @return the number of nodes written to out
+	 */
+	size_t modified_node_iter_next_batch(ll_vertex_iterator& iter,
+			node_t* out, size_t max) {
+
+		size_t count = 0;
+
+		if (!_levels->has_prev_level(_level)) {
+			while (count < max && iter.vi_next_node < iter.vi_end)
+				out[count++] = iter.vi_next_node++;
+			return count;
+		}
+
+		auto prev = _levels->prev_level(_level);
+		T* zp = _levels->page_manager()->zero_page_ptr();
+
+		while (count < max) {
+			node_t r = iter.vi_next_node++;
+			if (r >= iter.vi_end) break;
+			out[count++] = r;
+
+			// Advance to the next differing element -- same scan as
+			// modified_node_iter_next(), with prev and zp hoisted
+
+			while (iter.vi_next_node < (node_t) _size
+					&& iter.vi_next_node < iter.vi_end) {
+				size_t page = iter.vi_next_node >> LL_ENTRIES_PER_PAGE_BITS;
+				assert(page < _pages);
+				T* d = _indirection[page];
+
+				__builtin_prefetch(&_indirection[page + 1], 0, 1);
+				__builtin_prefetch(&prev->_indirection[page + 1], 0, 1);
+
+				if (d != zp && page < prev->_pages) {
+					T* p = prev->_indirection[page];
+
+					if (d == p) {
+						size_t max_page = _pages < prev->_pages
+							? _pages : prev->_pages;
+						do {
+							page++;
+						} while (page < max_page
+								&& _indirection[page]
+									== prev->_indirection[page]
+								&& _indirection[page] != zp);
+						iter.vi_next_node = (node_t)
+							(page << LL_ENTRIES_PER_PAGE_BITS);
+						continue;
+					}
+
+					size_t i = iter.vi_next_node
+						& (LL_ENTRIES_PER_PAGE - 1);
+
+					size_t lim = LL_ENTRIES_PER_PAGE;
+					size_t left = (size_t)
+						(iter.vi_end - iter.vi_next_node);
+					if (lim - i > left) lim = i + left;
+
+					size_t j = ll_vt_first_diff(d, p, i, lim);
+					iter.vi_next_node += j - i;
+					if (j < lim) break;
+				}
+				else {
+					break;
+				}
+			}
+		}
+
+		return count;
+	}
+
+
+	/**
+	 * Get the next run of consecutive (maybe) modified nodes, so that the
+	 * caller can process [out_start, out_end) with a raw loop over the
+	 * values instead of one iterator call per node.
+	 *
+	 * @param iter the iterator variable
+	 * @param out_start the first node of the run
+	 * @param out_end the end of the run (exclusive)
+	 * @return true if a run was found, false if the iterator is exhausted
+	 */
+	bool next_modified_run(ll_vertex_iterator& iter,
+			node_t& out_start, node_t& out_end) {
+
+		node_t n = modified_node_iter_next(iter);
+		if (n == LL_NIL_NODE) return false;
+
+		out_start = n;
+		node_t expect = n + 1;
+
+		while (iter.vi_next_node == expect && expect < iter.vi_end) {
+			node_t m = modified_node_iter_next(iter);
+			assert(m == expect);
+			(void) m;
+			expect++;
+		}
+
+		out_end = expect;
+		return true;
+	}
+
+
 	/**
 	 * Get the number of pages
 	 *
@@ -1394,7 +1809,7 @@ private:
 	std::vector<T*> _data;
 
 	/// The page IDs
-	size_t* _page_ids;
+	ll_page_id_t* _page_ids;
 
 	/// The zero page
 	T* _zero_page;
@@ -1453,22 +1868,10 @@ private:
 		auto prev = _levels->prev_level(_level);
 		size_t mp = prev->_pages;
 		if (end <= mp) {
-			memcpy(&_indirection[start],
-					&prev->_indirection[start],
-					sizeof(T*) * (end - start));
-			memcpy(&_page_ids[start],
-					&prev->_page_ids[start],
-					sizeof(size_t) * (end - start));
-			_levels->page_manager()->acquire_pages(&_page_ids[start], end-start);
+			copy_and_acquire_range(prev, start, end);
 		}
 		else if (start < mp) {
-			memcpy(&_indirection[start],
-					&prev->_indirection[start],
-					sizeof(T*) * (mp - start));
-			memcpy(&_page_ids[start],
-					&prev->_page_ids[start],
-					sizeof(size_t) * (mp - start));
-			_levels->page_manager()->acquire_pages(&_page_ids[start], mp-start);
+			copy_and_acquire_range(prev, start, mp);
 
 			T* zp_ptr;
 			size_t zp = _levels->page_manager()->zero_page(&zp_ptr, end-mp);
@@ -1482,6 +1885,33 @@ private:
 			for (size_t i = start; i < end; i++) _page_ids[i] = zp;
 		}
 	}
+
+
+	/**
+	 * Copy a range of the indirection table and the page IDs from the
+	 * previous level and take references on the copied pages. Works in
+	 * 512-entry tiles (4 KB per array), so acquire_pages reads each ID
+	 * while it is still in L1 from the copy, instead of streaming the
+	 * whole range through the cache twice on large tables.
+	 * 
+	 * @param prev the previous level
+	 * @param start where to start (page number)
+	 * @param end where to end (exclusive; at most prev->_pages)
+	 */
+	void copy_and_acquire_range(ll_mem_array_swcow<T>* prev, size_t start,
+			size_t end) {
+
+		const size_t TILE = 512;
+
+		for (size_t i = start; i < end; i += TILE) {
+			size_t n = std::min(TILE, end - i);
+			memcpy(&_indirection[i], &prev->_indirection[i],
+					sizeof(T*) * n);
+			memcpy(&_page_ids[i], &prev->_page_ids[i],
+					sizeof(ll_page_id_t) * n);
+			_levels->page_manager()->acquire_pages(&_page_ids[i], n);
+		}
+	}
 };
 
 
@@ -39,6 +39,7 @@
 
 #include <cassert>
 #include <cstdlib>
+#include <sys/mman.h>
 #include <vector>
 
 #include "llama/ll_lock.h"
@@ -47,6 +48,15 @@
 #define LL_MEM_POOL_ALIGN_BITS				3
 #define	LL_MEM_POOL_ALIGN					(1 << (LL_MEM_POOL_ALIGN_BITS))
 
+/*
+ * The split of the memory pool's packed allocation cursor: the low bits
+ * hold the byte offset within the current chunk, the high bits the chunk
+ * index. 40 offset bits allow chunks up to 1 TB; 24 index bits allow 16M
+ * chunks.
+ */
+#define LL_MEM_POOL_OFFSET_BITS				40
+#define LL_MEM_POOL_OFFSET_MASK				((1ull << LL_MEM_POOL_OFFSET_BITS) - 1)
+
 
 /**
  * Memory pool
@@ -58,10 +68,33 @@ class ll_memory_pool {
 
 	std::vector<void*> _buffers;
 
+	/// Whether the corresponding chunk is a huge-page mapping (munmap)
+	/// rather than a malloc-ed buffer (free)
+	std::vector<char> _buffer_mapped;
+
+	/// The packed allocation cursor: (chunk_index << OFFSET_BITS) | offset.
+	/// Bumped with a CAS, so concurrent allocations within a chunk do not
+	/// take the lock at all; the lock only covers chunk turnover. On a
+	/// cache line together with _current (the pair is always read
+	/// together), away from the read-mostly fields above so the CAS
+	/// traffic does not invalidate them. Padded explicitly rather than
+	/// with aligned(64): pools are created with plain new, which does not
+	/// honor extended alignment under C++11.
+	char _cursor_pad0[64];
+	volatile uint64_t _cursor;
+
+	/// The chunk the cursor points into. Written (before the cursor, under
+	/// the lock) only when the cursor moves to a new chunk, so a reader
+	/// that loads the cursor and then this pointer either sees a matching
+	/// pair or fails its CAS and retries.
+	char* volatile _current;
+
+	/// The chunk-turnover lock, padded away from the cursor pair so
+	/// slow-path waiters do not steal the cursor's line from fast-path
+	/// allocations
+	char _lock_pad0[64 - sizeof(uint64_t) - sizeof(char*)];
 	ll_spinlock_t _lock;
-
-	size_t _last_used;
-	size_t _chunk_index;
+	char _lock_pad1[64 - sizeof(ll_spinlock_t)];
 
 
 public:
@@ -78,8 +111,8 @@ public:
 		_chunk_size = chunk_size;
 		_retain_max = retain_max;
 
-		_chunk_index = 0;
-		_last_used = 0;
+		_cursor = 0;
+		_current = NULL;
 		_lock = 0;
 	}
 
@@ -90,7 +123,7 @@ public:
 	~ll_memory_pool() {
 
 		for (int i = ((int) _buffers.size()) - 1; i >= 0; i--) {
-			::free(_buffers[i]);
+			free_chunk(i);
 		}
 	}
 
@@ -115,15 +148,18 @@ public:
 		ll_spinlock_acquire(&_lock);
 
 		if (_retain_max >= 0 || !retain) {
-			ssize_t m = retain ? _retain_max : 0;
-			for (ssize_t i = ((ssize_t) _buffers.size()) - 1; i >= m; i--) {
-				::free(_buffers[i]);
+			size_t keep = retain ? (size_t) _retain_max : 0;
+			if (keep > _buffers.size()) keep = _buffers.size();
+			for (size_t i = _buffers.size(); i > keep; i--) {
+				free_chunk(i - 1);
 			}
-			_buffers.resize(std::min((size_t) _retain_max, _buffers.size()));
+			_buffers.resize(keep);
+			_buffer_mapped.resize(keep);
 		}
 
-		_chunk_index = 0;
-		_last_used = 0;
+		_current = _buffers.empty() ? NULL : (char*) _buffers[0];
+		__sync_synchronize();
+		_cursor = 0;
 
 		ll_spinlock_release(&_lock);
 	}
@@ -137,7 +173,8 @@ public:
 	 * @return the pointer
 	 */
 	void* pointer(size_t chunk, size_t offset) {
-		assert(chunk <= _chunk_index && offset < _chunk_size);
+		assert(chunk <= (size_t) (_cursor >> LL_MEM_POOL_OFFSET_BITS));
+		assert(offset < _chunk_size);
 		return ((char*) _buffers[chunk]) + offset;
 	}
 
@@ -153,52 +190,117 @@ public:
 	template<typename T> T* allocate(size_t num=1, size_t* o_chunk=NULL,
 			size_t* o_offset=NULL) {
 		
-		size_t bytes = sizeof(T) * num;
-		ll_spinlock_acquire(&_lock);
+		// Rounding the size up front keeps every offset the cursor ever
+		// holds aligned, which is what the old post-hoc correction of
+		// _last_used achieved
+
+		size_t bytes = (sizeof(T) * num + LL_MEM_POOL_ALIGN - 1)
+			& ~((size_t) LL_MEM_POOL_ALIGN - 1);
 
 		if (bytes > _chunk_size) {
 			LL_E_PRINT("The allocation is too large\n");
 			abort();
 		}
 
-		if (_buffers.empty()) {
-			void* b = malloc(_chunk_size);
-			if (b == NULL) {
-				LL_E_PRINT("** OUT OF MEMORY **\n");
-				abort();
+		while (true) {
+
+			// Fast path: claim [offset, offset + bytes) in the current
+			// chunk with a single CAS. A concurrent chunk turnover is
+			// caught by the CAS, since it changes the chunk-index bits.
+
+			uint64_t cur = _cursor;
+			char* base = _current;
+			uint64_t offset = cur & LL_MEM_POOL_OFFSET_MASK;
+
+			if (base != NULL && offset + bytes <= _chunk_size) {
+				if (__sync_bool_compare_and_swap(&_cursor, cur, cur + bytes)) {
+					if (o_chunk  != NULL)
+						*o_chunk  = (size_t) (cur >> LL_MEM_POOL_OFFSET_BITS);
+					if (o_offset != NULL) *o_offset = (size_t) offset;
+					return (T*) (base + offset);
+				}
+				continue;
 			}
-			_buffers.push_back(b);
-			_last_used = 0;
-		}
 
-		void* p = ((char*) _buffers[_chunk_index]) + _last_used;
-		_last_used += bytes;
 
-		size_t lu_remainder = _last_used & ((1ul << LL_MEM_POOL_ALIGN_BITS) - 1);
-		if (lu_remainder != 0) _last_used += LL_MEM_POOL_ALIGN - lu_remainder;
+			// Slow path: the chunk is exhausted (or the pool is empty), so
+			// move the cursor to the next chunk under the lock. Everyone
+			// who raced here behind us sees the moved cursor and retries.
+
+			ll_spinlock_acquire(&_lock);
 
-		if (_last_used > _chunk_size) {
-			_chunk_index++;
-			if (_chunk_index < _buffers.size()) {
-				p = _buffers[_chunk_index];
+			if (_cursor != cur || _current != base) {
+				ll_spinlock_release(&_lock);
+				continue;
+			}
+
+			size_t next = (base == NULL)
+				? 0 : (size_t) (cur >> LL_MEM_POOL_OFFSET_BITS) + 1;
+
+			void* p;
+			if (next < _buffers.size()) {
+				p = _buffers[next];
 			}
 			else {
-				p = malloc(_chunk_size);
-				if (p == NULL) {
-					LL_E_PRINT("** OUT OF MEMORY **\n");
-					abort();
-				}
-				_buffers.push_back(p);
+				p = alloc_chunk();
 			}
-			_last_used = bytes;
+
+			_current = (char*) p;
+			__sync_synchronize();
+			_cursor = ((uint64_t) next << LL_MEM_POOL_OFFSET_BITS) | bytes;
+
+			ll_spinlock_release(&_lock);
+
+			if (o_chunk  != NULL) *o_chunk  = next;
+			if (o_offset != NULL) *o_offset = 0;
+			return (T*) p;
 		}
+	}
 
-		if (o_chunk  != NULL) *o_chunk  = _chunk_index;
-		if (o_offset != NULL) *o_offset = _last_used - bytes;
-		
-		ll_spinlock_release(&_lock);
 
-		return (T*) p;
+private:
+
+	/**
+	 * Allocate and register a new chunk, backed by huge pages when the
+	 * chunk size warrants it
+	 *
+	 * @return the chunk
+	 */
+	void* alloc_chunk() {
+
+		void* p = NULL;
+		char mapped = 0;
+
+		if (_chunk_size >= 2ul * 1048576) {
+			p = ll_mmap_hugepages(_chunk_size);
+			if (p != NULL) mapped = 1;
+		}
+
+		if (p == NULL) p = malloc(_chunk_size);
+		if (p == NULL) {
+			LL_E_PRINT("** OUT OF MEMORY **\n");
+			abort();
+		}
+
+		_buffers.push_back(p);
+		_buffer_mapped.push_back(mapped);
+
+		return p;
+	}
+
+
+	/**
+	 * Free the given chunk
+	 *
+	 * @param i the chunk index
+	 */
+	void free_chunk(size_t i) {
+		if (_buffer_mapped[i]) {
+			munmap(_buffers[i], _chunk_size);
+		}
+		else {
+			::free(_buffers[i]);
+		}
 	}
 };
 
@@ -235,7 +337,9 @@ public:
 	 */
 	~ll_memory_pool_for_large_allocations() {
 		for (size_t i = 0; i < _buffers.size(); i++) {
-			if (_buffers[i].b_buffer != NULL) ::free(_buffers[i].b_buffer);
+			if (_buffers[i].b_buffer != NULL) {
+				munmap(_buffers[i].b_buffer, _buffers[i].b_size);
+			}
 		}
 	}
 
@@ -251,78 +355,90 @@ public:
 		ll_spinlock_acquire(&_lock);
 
 
-		// Find the smallest available buffer that would work
+		// One pass: find the smallest available buffer that fits, and at
+		// the same time the largest available buffer to recycle if none
+		// fits -- instead of rescanning the vector for the second answer
+
+		size_t best_fit = (size_t) -1;
+		size_t best_fit_size = (size_t) -1;
+		size_t largest = (size_t) -1;
+		size_t largest_size = 0;
 
-		size_t best = (size_t) -1;
 		for (size_t i = 0; i < _buffers.size(); i++) {
 			buffer_t& b = _buffers[i];
 			if (b.b_in_use || b.b_buffer == NULL) continue;
 
-			if (size <= b.b_size) {
-				if (best == (size_t) -1) {
-					best = i;
-				}
-				else {
-					if (b.b_size < _buffers[best].b_size) {
-						best = i;
-					}
-				}
+			if (size <= b.b_size && b.b_size < best_fit_size) {
+				best_fit = i;
+				best_fit_size = b.b_size;
+			}
+			if (largest == (size_t) -1 || b.b_size > largest_size) {
+				largest = i;
+				largest_size = b.b_size;
 			}
 		}
 
-		if (best != (size_t) -1) {
-			buffer_t& b = _buffers[best];
+		if (best_fit != (size_t) -1) {
+			buffer_t& b = _buffers[best_fit];
 			b.b_in_use = true;
 			ll_spinlock_release(&_lock);
 			return b.b_buffer;
 		}
 
+		size_t best = largest;
 
-		// Find the largest buffer to realloc - or make a new allocation
+		// Nothing fits: claim a record under the lock, but do the actual
+		// mapping work -- which can take milliseconds for these sizes --
+		// outside of it, so other allocators are not stalled behind the
+		// kernel. The claimed record has b_buffer == NULL until the new
+		// buffer is installed; free() cannot race with that, since the
+		// buffer has not been returned to anyone yet.
 
-		for (size_t i = 0; i < _buffers.size(); i++) {
-			buffer_t& b = _buffers[i];
-			if (b.b_in_use || b.b_buffer == NULL) continue;
+		size_t s = (size_t) ((1 + _overprovision) * size);
+		void* old = NULL;
+		size_t old_size = 0;
 
-			if (best == (size_t) -1) {
-				best = i;
-			}
-			else {
-				if (b.b_size > _buffers[best].b_size) {
-					best = i;
-				}
-			}
+		if (best == (size_t) -1) {
+			buffer_t nb;
+			memset(&nb, 0, sizeof(nb));
+			_buffers.push_back(nb);
+			best = _buffers.size() - 1;
+		}
+		else {
+			old = _buffers[best].b_buffer;
+			old_size = _buffers[best].b_size;
 		}
 
-		size_t s = (size_t) ((1 + _overprovision) * size);
-		void* p = NULL;
+		_buffers[best].b_in_use = true;
+		_buffers[best].b_size = s;
+		_buffers[best].b_buffer = NULL;
+
+		ll_spinlock_release(&_lock);
 
-		if (best != (size_t) -1) {
-			buffer_t& b = _buffers[best];
 
-			::free(b.b_buffer);
+		// Grow the recycled mapping in place where the kernel allows it:
+		// the contents are garbage by contract, but the already-faulted
+		// pages are kept, so the consumer does not pay a fresh round of
+		// zero-fill faults over the whole buffer
 
-			b.b_in_use = true;
-			b.b_size = s;
-			b.b_buffer = p = malloc(s);
+		void* p;
+		if (old != NULL) {
+			p = mremap(old, old_size, s, MREMAP_MAYMOVE);
 		}
 		else {
-			buffer_t nb;
-			memset(&nb, 0, sizeof(nb));
-			_buffers.push_back(nb);
-			buffer_t& b = _buffers[_buffers.size()-1];
-
-			b.b_in_use = true;
-			b.b_size = s;
-			b.b_buffer = p = malloc(s);
+			p = mmap(NULL, s, PROT_READ | PROT_WRITE,
+					MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
 		}
 
-		ll_spinlock_release(&_lock);
-
-		if (p == NULL) {
+		if (p == MAP_FAILED) {
 			LL_E_PRINT("** Out of memory **\n");
 			abort();
 		}
+		madvise(p, s, MADV_HUGEPAGE);
+
+		ll_spinlock_acquire(&_lock);
+		_buffers[best].b_buffer = p;
+		ll_spinlock_release(&_lock);
 
 		return p;
 	}
@@ -356,12 +472,16 @@ public:
 
 
 /**
- * Memory helper
+ * Memory helper: a grab-bag of allocations freed together when the
+ * helper goes out of scope. Each block carries an intrusive link in a
+ * 16-byte header, and blocks are chained with a CAS push, so concurrent
+ * allocations from an OpenMP region need no lock and no shared vector.
  */
 class ll_memory_helper {
 
-	std::vector<void*> _buffers;
-	ll_spinlock_t _lock;
+	/// The head of the intrusive chain of allocated blocks. Push-only
+	/// while the helper is alive, so there is no ABA to guard against.
+	void* volatile _head;
 
 
 public:
@@ -370,7 +490,7 @@ public:
 	 * Initialize
 	 */
 	ll_memory_helper() {
-		_lock = 0;
+		_head = NULL;
 	}
 
 
@@ -378,8 +498,11 @@ public:
 	 * Destroy
 	 */
 	~ll_memory_helper() {
-		for (int i = ((int) _buffers.size()) - 1; i >= 0; i--) {
-			free(_buffers[i]);
+		void* p = _head;
+		while (p != NULL) {
+			void* next = *(void**) p;
+			free(p);
+			p = next;
 		}
 	}
 
@@ -391,11 +514,24 @@ public:
 	 * @return the allocated memory
 	 */
 	template<typename T> T* allocate(size_t num) {
-		T* p = (T*) malloc(sizeof(T) * num);
-		ll_spinlock_acquire(&_lock);
-		_buffers.push_back(p);
-		ll_spinlock_release(&_lock);
-		return p;
+
+		// The header is 16 bytes -- the link plus padding -- so the
+		// payload keeps malloc's own alignment
+
+		char* raw = (char*) malloc(2 * sizeof(void*) + sizeof(T) * num);
+		if (raw == NULL) {
+			LL_E_PRINT("** OUT OF MEMORY **\n");
+			abort();
+		}
+
+		void* old;
+		do {
+			old = _head;
+			*(void**) raw = old;
+		}
+		while (!__sync_bool_compare_and_swap(&_head, old, (void*) raw));
+
+		return (T*) (raw + 2 * sizeof(void*));
 	}
 };
 
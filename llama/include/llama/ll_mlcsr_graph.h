@@ -100,10 +100,21 @@ class ll_mlcsr_ro_graph {
 	LL_CSR _in;
 
 	/// All graph CSRs (user tables + out, in)
-	std::unordered_map<std::string, LL_CSR*> _csrs;
+	ll_flat_name_map<LL_CSR*> _csrs;
 
-	/// The _csrs map update lock
+	/// The _csrs map update lock, padded away from its neighbors so
+	/// lookups that take it do not invalidate the CSR table around it for
+	/// readers. Explicit pads rather than aligned(64): the graph is
+	/// heap-allocated, and C++11 new would not honor the attribute.
+	char _csrs_update_lock_pad0[64];
 	ll_spinlock_t _csrs_update_lock;
+	char _csrs_update_lock_pad1[64 - sizeof(ll_spinlock_t)];
+
+#ifdef LL_DELETIONS
+	/// Per-edge locks pairing the out- and in-CSR max-visible-level
+	/// updates of one logical edge, keyed by the out edge
+	ll_spinlock_table _mvl_pair_lt;
+#endif
 
 	/// The memory pool for sparse node IDs
 	ll_memory_pool_for_large_allocations* _pool_for_sparse_node_ids;
@@ -118,19 +129,19 @@ class ll_mlcsr_ro_graph {
 	 *-----------------------------------------------------------------------*/
 
 	/// The node 32-bit properties
-	std::unordered_map<std::string, ll_mlcsr_node_property<uint32_t>*>
+	ll_flat_name_map<ll_mlcsr_node_property<uint32_t>*>
 		_node_properties_32;
 
 	/// The node 64-bit properties
-	std::unordered_map<std::string, ll_mlcsr_node_property<uint64_t>*>
+	ll_flat_name_map<ll_mlcsr_node_property<uint64_t>*>
 		_node_properties_64;
 
 	/// The edge 32-bit properties
-	std::unordered_map<std::string, ll_mlcsr_edge_property<uint32_t>*>
+	ll_flat_name_map<ll_mlcsr_edge_property<uint32_t>*>
 		_edge_properties_32;
 
 	/// The edge 64-bit properties
-	std::unordered_map<std::string, ll_mlcsr_edge_property<uint64_t>*>
+	ll_flat_name_map<ll_mlcsr_edge_property<uint64_t>*>
 		_edge_properties_64;
 
 	/// The edge 32-bit properties - get by ID
@@ -151,20 +162,22 @@ class ll_mlcsr_ro_graph {
 
 #endif
 
-	/// The next node property ID
+	/// The next node property ID. The two ID counters share one cache
+	/// line of their own: they are bumped only on property creation, but
+	/// that can run concurrently with lookups of the neighboring maps.
+	/// Padded explicitly for the same reason as the update lock above.
+	char _property_id_pad0[64];
 	std::atomic<int> _next_node_property_id;
 
 	/// The next edge property ID
 	std::atomic<int> _next_edge_property_id;
+	char _property_id_pad1[64 - 2 * sizeof(std::atomic<int>)];
 
 
 	/*-----------------------------------------------------------------------*
 	 * Common                                                                *
 	 *-----------------------------------------------------------------------*/
 
-	/// The update lock
-	ll_spinlock_t _update_lock;
-
 	/// The persistent storage
 	IF_LL_PERSISTENCE(ll_persistent_storage* _storage);
 
@@ -185,7 +198,6 @@ public:
 
 		_database = database;
 		_csrs_update_lock = 0;
-		_update_lock = 0;
 		_master = NULL;
 
 		_next_node_property_id = 0;
@@ -223,27 +235,44 @@ public:
 
 #ifdef LL_PERSISTENCE
 
-		// Open all CSRs
+		// Open all CSRs. Each open reads the CSR's level metadata from
+		// disk and the contexts are independent, so on databases with
+		// many extra CSRs this is worth doing in parallel --
+		// ll_persistent_storage serializes its own file and header
+		// tables internally. Only the map insert needs our lock.
 
 		std::vector<std::string> csrs = storage->list_context_names("csr");
+#		pragma omp parallel for schedule(dynamic)
 		for (size_t i = 0; i < csrs.size(); i++) {
 			if (csrs[i] == "out" || csrs[i] == "in") continue;
 			LL_CSR* csr = new LL_CSR(storage, csrs[i].c_str());
 			csr->set_memory_pools_for_sparse_representaion(
 					_pool_for_sparse_node_ids, _pool_for_sparse_node_data);
+			ll_spinlock_acquire(&_csrs_update_lock);
 			_csrs[csrs[i]] = csr;
+			ll_spinlock_release(&_csrs_update_lock);
 		}
 
 
-		// Open all node properties
+		// Open all node properties. The header reads are small
+		// independent I/Os, so issue them in parallel; the actual
+		// property creation stays serial below so that the property
+		// IDs keep being assigned in listing order, exactly as before.
 
 		std::vector<std::string> nps = storage->list_context_names("np");
+		std::vector<ll_length_and_data*> np_headers(nps.size(), NULL);
+
+#		pragma omp parallel for schedule(dynamic)
+		for (size_t i = 0; i < nps.size(); i++) {
+			np_headers[i] = ll_persistence_context::read_header(
+					storage, nps[i].c_str(), "np");
+		}
+
 		for (size_t i = 0; i < nps.size(); i++) {
 
 			// Get the property metadata
 
-			ll_length_and_data* ld = ll_persistence_context::read_header(
-					storage, nps[i].c_str(), "np");
+			ll_length_and_data* ld = np_headers[i];
 			if (ld == NULL) {
 				LL_W_PRINT("No property metadata for %s\n", nps[i].c_str());
 				continue;
@@ -389,7 +418,6 @@ public:
 				 : (void*) get_edge_property_64("stream-forward")));
 #endif
 
-		_update_lock = 0;
 		IF_LL_PERSISTENCE(_storage = master->_storage);
 	}
 
@@ -493,7 +521,7 @@ public:
 	 *
 	 * @return the map of graph CSRs
 	 */
-	inline const std::unordered_map<std::string, LL_CSR*>& csrs() const {
+	inline const ll_flat_name_map<LL_CSR*>& csrs() const {
 		return _csrs;
 	}
 
@@ -947,6 +975,49 @@ public:
 	}
 
 
+	/**
+	 * The scatter pass of make_reverse_edges, specialized on whether the
+	 * edge-translation maps are maintained. The flag is invariant over
+	 * billions of iterations, so instantiating the loop twice lets the
+	 * compiler drop the cow_write calls (and the branch) entirely from
+	 * the common no-translation instantiation.
+	 *
+	 * @param level the level being transposed
+	 * @param loc the per-edge position within the target's in-adjacency list
+	 */
+	template <bool has_edge_translation>
+	void scatter_in_edges(size_t level, const int* loc) {
+
+		const size_t PREFETCH_DIST = 8;	// See make_reverse_edges
+
+#		pragma omp parallel for schedule(dynamic,4096)
+		for (node_t source = 0; source < _out.max_nodes(); source++) {
+			ll_edge_iterator iter;
+			_out.iter_begin_within_level(iter, source, level);
+			FOREACH_ITER_WITHIN_LEVEL(e, _out, iter) {
+				node_t target = LL_ITER_OUT_NEXT_NODE(_out, iter, e);
+				if (iter.left > PREFETCH_DIST) {
+					node_t peek = (node_t) LL_VALUE_PAYLOAD(
+							((const node_t*) iter.ptr)
+								[PREFETCH_DIST - 1]);
+					__builtin_prefetch(
+							&(*_in.vertex_table())[peek], 0, 0);
+				}
+				size_t index = loc[LL_EDGE_INDEX(e)];
+				edge_t in_edge = _in.write_value(target, index, source);
+
+				if (has_edge_translation) {
+					_in.edge_translation().cow_write(in_edge, e);
+					_out.edge_translation().cow_write(e, in_edge);
+				}
+				else {
+					(void) in_edge;
+				}
+			}
+		}
+	}
+
+
 	/**
 	 * Make the reverse edges
 	 *
@@ -954,6 +1025,14 @@ public:
 	 */
 	void make_reverse_edges(degree_t* deletedInEdgeCounts=NULL) {
 
+		// How many edges ahead to prefetch in the two scatter passes
+		// below. The edge values are contiguous within an adjacency
+		// list, so peeking at iter.ptr[k] is a sequential read the
+		// hardware prefetcher already covers; the payoff is issuing
+		// the dependent random access (a[target], the in-CSR vertex
+		// table entry) early enough to hide its DRAM miss.
+		const size_t PREFETCH_DIST = 8;
+
 		for (size_t level = _in.num_levels();
 				level < _out.num_levels(); level++) {
 
@@ -962,11 +1041,27 @@ public:
 
 			// Compute the in-degrees
 
-			degree_t* a = (degree_t*) malloc(sizeof(degree_t) * max_nodes);
-			memset(a, 0, sizeof(degree_t) * max_nodes);
+			// Both buffers are hit at random offsets by the scatter
+			// passes, so back them with hugepages when they are large
+			// enough to matter (2MB pages need 512x fewer TLB entries);
+			// anonymous mappings come back zero-filled, so only the
+			// malloc fallback needs the explicit memset
+
+			size_t a_bytes = sizeof(degree_t) * max_nodes;
+			degree_t* a = a_bytes >= LL_ET_HUGEPAGE_THRESHOLD
+				? (degree_t*) ll_mmap_hugepages(a_bytes) : NULL;
+			bool a_mapped = a != NULL;
+			if (!a_mapped) {
+				a = (degree_t*) malloc(a_bytes);
+				memset(a, 0, a_bytes);
+			}
 
 			// Add max_nodes just in case sometimes in the future
-			int* loc = (int*) malloc(sizeof(int) * _out.edge_table_length(level));
+			size_t loc_bytes = sizeof(int) * _out.edge_table_length(level);
+			int* loc = loc_bytes >= LL_ET_HUGEPAGE_THRESHOLD
+				? (int*) ll_mmap_hugepages(loc_bytes) : NULL;
+			bool loc_mapped = loc != NULL;
+			if (!loc_mapped) loc = (int*) malloc(loc_bytes);
 
 #			pragma omp parallel for schedule(dynamic,4096)
 			for (node_t source = 0; source < _out.max_nodes(); source++) {
@@ -974,6 +1069,12 @@ public:
 				_out.iter_begin_within_level(iter, source, level);
 				FOREACH_ITER_WITHIN_LEVEL(e, _out, iter) {
 					node_t target = LL_ITER_OUT_NEXT_NODE(_out, iter, e);
+					if (iter.left > PREFETCH_DIST) {
+						node_t peek = (node_t) LL_VALUE_PAYLOAD(
+								((const node_t*) iter.ptr)
+									[PREFETCH_DIST - 1]);
+						__builtin_prefetch(&a[peek], 1, 0);
+					}
 					loc[LL_EDGE_INDEX(e)]
 						= __sync_fetch_and_add(&a[target], 1);
 				}
@@ -1009,35 +1110,17 @@ public:
 			}
 
 
-			// Copy the data
-
-#ifdef _DEBUG
-			degree_t* degrees = a; a = (degree_t*) malloc(sizeof(degree_t)
-					* _out.max_nodes());
-			/*fprintf(stderr, "\n");
-			for (size_t i = 0; i < _out.max_nodes(); i++) {
-				if ((i+0) % 25 == 0) fprintf(stderr, "%4lu:", i);
-				fprintf(stderr, " %3lu", degrees[i]);
-				if ((i+1) % 25 == 0) fprintf(stderr, "\n");
-			}*/
-#endif
-			memset(a, 0, sizeof(degree_t) * _out.max_nodes());
+			// Copy the data. The scatter indexes through loc[] and does
+			// not read the degree array, so there is no need to re-zero
+			// it (or, in debug builds, to allocate a second one) --
+			// that was an O(max_nodes) write pass that only evicted
+			// the arrays the scatter is about to use.
 
-#			pragma omp parallel for schedule(dynamic,4096)
-			for (node_t source = 0; source < _out.max_nodes(); source++) {
-				ll_edge_iterator iter;
-				_out.iter_begin_within_level(iter, source, level);
-				FOREACH_ITER_WITHIN_LEVEL(e, _out, iter) {
-					node_t target = LL_ITER_OUT_NEXT_NODE(_out, iter, e);
-					size_t index = loc[LL_EDGE_INDEX(e)];
-						//__sync_fetch_and_add(&a[target], 1);
-					edge_t in_edge = _in.write_value(target, index, source);
-
-					if (has_edge_translation) {
-						_in.edge_translation().cow_write(in_edge, e);
-						_out.edge_translation().cow_write(e, in_edge);
-					}
-				}
+			if (has_edge_translation) {
+				scatter_in_edges<true>(level, loc);
+			}
+			else {
+				scatter_in_edges<false>(level, loc);
 			}
 
 			_in.finish_level_edges();
@@ -1050,11 +1133,10 @@ public:
 
 			// Finish
 
-			free(a);
-#ifdef _DEBUG
-			free(degrees);
-#endif
-			if (loc != NULL) free(loc);
+			if (a_mapped) munmap(a, a_bytes); else free(a);
+			if (loc != NULL) {
+				if (loc_mapped) munmap(loc, loc_bytes); else free(loc);
+			}
 		}
 	}
 
@@ -1068,7 +1150,18 @@ public:
 	void update_max_visible_level(edge_t edge, int mlevel) {
 
 		assert(mlevel > (int) LL_MAX_LEVEL);
-		ll_spinlock_acquire(&_update_lock);
+
+		// One per-edge lock, keyed by the out edge, spans both CSR
+		// updates: the CSRs' internal locks use different keys for the
+		// two halves of a logical edge, so on their own they let two
+		// writers interleave and leave a mixed out/in pair. Unrelated
+		// edges still proceed in parallel, unlike under the old global
+		// lock. (The lower-only variant below needs no pairing: it is
+		// monotonic, so any interleaving converges to the minimum.)
+
+#ifdef LL_DELETIONS
+		_mvl_pair_lt.acquire_for(edge);
+#endif
 
 		_out.update_max_visible_level(edge, mlevel);
 
@@ -1077,7 +1170,9 @@ public:
 			_in.update_max_visible_level(in_edge, mlevel);
 		}
 
-		ll_spinlock_release(&_update_lock);
+#ifdef LL_DELETIONS
+		_mvl_pair_lt.release_for(edge);
+#endif
 	}
 
 
@@ -1090,9 +1185,6 @@ public:
 	 */
 	bool update_max_visible_level_lower_only(edge_t edge, int mlevel) {
 
-		// I do not think this needs to be locked...
-		//ll_spinlock_acquire(&_update_lock);
-
 		bool r = _out.update_max_visible_level_lower_only(edge, mlevel);
 
 		if (r) {
@@ -1102,8 +1194,6 @@ public:
 			}
 		}
 
-		//ll_spinlock_release(&_update_lock);
-
 		return r;
 	}
 
@@ -1113,7 +1203,7 @@ public:
 	 *
 	 * @return the map of all such properties
 	 */
-	const std::unordered_map<std::string, ll_mlcsr_node_property<uint32_t>*>&
+	const ll_flat_name_map<ll_mlcsr_node_property<uint32_t>*>&
 	get_all_node_properties_32() {
 		return _node_properties_32;
 	}
@@ -1124,7 +1214,7 @@ public:
 	 *
 	 * @return the map of all such properties
 	 */
-	const std::unordered_map<std::string, ll_mlcsr_node_property<uint64_t>*>&
+	const ll_flat_name_map<ll_mlcsr_node_property<uint64_t>*>&
 	get_all_node_properties_64() {
 		return _node_properties_64;
 	}
@@ -1135,7 +1225,7 @@ public:
 	 *
 	 * @return the map of all such properties
 	 */
-	const std::unordered_map<std::string, ll_mlcsr_edge_property<uint32_t>*>&
+	const ll_flat_name_map<ll_mlcsr_edge_property<uint32_t>*>&
 	get_all_edge_properties_32() {
 		return _edge_properties_32;
 	}
@@ -1146,7 +1236,7 @@ public:
 	 *
 	 * @return the map of all such properties
 	 */
-	const std::unordered_map<std::string, ll_mlcsr_edge_property<uint64_t>*>&
+	const ll_flat_name_map<ll_mlcsr_edge_property<uint64_t>*>&
 	get_all_edge_properties_64() {
 		return _edge_properties_64;
 	}
@@ -1160,8 +1250,7 @@ public:
 	 */
 	ll_mlcsr_node_property<uint32_t>* get_node_property_32(const char* name) {
 
-		std::string s = name;
-		auto it = _node_properties_32.find(s);
+		auto it = _node_properties_32.find(name);
 		if (it == _node_properties_32.end()) return NULL;
 
 		return it->second;
@@ -1180,8 +1269,7 @@ public:
 		create_uninitialized_node_property_32(const char* name,
 			short type, void (*destructor)(const uint32_t&) = NULL) {
 
-		std::string s = name;
-		auto it = _node_properties_32.find(s);
+		auto it = _node_properties_32.find(name);
 		if (it != _node_properties_32.end()) return NULL;
 
 		ll_mlcsr_node_property<uint32_t>* p
@@ -1189,7 +1277,7 @@ public:
 					IF_LL_PERSISTENCE(_storage,)
 					_next_node_property_id++,
 					name, type, destructor);
-		_node_properties_32[s] = p;
+		_node_properties_32[name] = p;
 
 		return p;
 	}
@@ -1203,8 +1291,7 @@ public:
 	 */
 	ll_mlcsr_node_property<uint64_t>* get_node_property_64(const char* name) {
 
-		std::string s = name;
-		auto it = _node_properties_64.find(s);
+		auto it = _node_properties_64.find(name);
 		if (it == _node_properties_64.end()) return NULL;
 
 		return it->second;
@@ -1223,8 +1310,7 @@ public:
 		create_uninitialized_node_property_64(const char* name,
 			short type, void (*destructor)(const uint64_t&) = NULL) {
 
-		std::string s = name;
-		auto it = _node_properties_64.find(s);
+		auto it = _node_properties_64.find(name);
 		if (it != _node_properties_64.end()) return NULL;
 
 		ll_mlcsr_node_property<uint64_t>* p
@@ -1232,7 +1318,7 @@ public:
 					IF_LL_PERSISTENCE(_storage,)
 					_next_node_property_id++,
 					name, type, destructor);
-		_node_properties_64[s] = p;
+		_node_properties_64[name] = p;
 
 		return p;
 	}
@@ -1246,8 +1332,7 @@ public:
 	 */
 	ll_mlcsr_edge_property<uint32_t>* get_edge_property_32(const char* name) {
 
-		std::string s = name;
-		auto it = _edge_properties_32.find(s);
+		auto it = _edge_properties_32.find(name);
 		if (it == _edge_properties_32.end()) return NULL;
 
 		return it->second;
@@ -1262,7 +1347,8 @@ public:
 	 */
 	ll_mlcsr_edge_property<uint32_t>* get_edge_property_32(int id) {
 
-		if (id < 0 || id >= LL_MAX_EDGE_PROPERTY_ID) return NULL;
+		// One unsigned compare covers both the negative and the too-large case
+		if ((unsigned) id >= LL_MAX_EDGE_PROPERTY_ID) return NULL;
 		return _edge_properties_by_id_32[id];
 	}
 
@@ -1302,8 +1388,7 @@ public:
 		create_uninitialized_edge_property_32(const char* name,
 			short type) {
 
-		std::string s = name;
-		auto it = _edge_properties_32.find(s);
+		auto it = _edge_properties_32.find(name);
 		if (it != _edge_properties_32.end()) return NULL;
 
 		int id = _next_edge_property_id++;
@@ -1318,7 +1403,7 @@ public:
 					IF_LL_PERSISTENCE(_storage,) id,
 					name, type, NULL,
 					_out.edge_property_level_creation_callback_32());
-		_edge_properties_32[s] = p;
+		_edge_properties_32[name] = p;
 		_edge_properties_by_id_32[p->id()] = p;
 
 		return p;
@@ -1333,8 +1418,7 @@ public:
 	 */
 	ll_mlcsr_edge_property<uint64_t>* get_edge_property_64(const char* name) {
 
-		std::string s = name;
-		auto it = _edge_properties_64.find(s);
+		auto it = _edge_properties_64.find(name);
 		if (it == _edge_properties_64.end()) return NULL;
 
 		return it->second;
@@ -1349,7 +1433,8 @@ public:
 	 */
 	ll_mlcsr_edge_property<uint64_t>* get_edge_property_64(int id) {
 
-		if (id < 0 || id >= LL_MAX_EDGE_PROPERTY_ID) return NULL;
+		// One unsigned compare covers both the negative and the too-large case
+		if ((unsigned) id >= LL_MAX_EDGE_PROPERTY_ID) return NULL;
 		return _edge_properties_by_id_64[id];
 	}
 
@@ -1366,8 +1451,7 @@ public:
 		create_uninitialized_edge_property_64(const char* name,
 			short type, void (*destructor)(const uint64_t&) = NULL) {
 
-		std::string s = name;
-		auto it = _edge_properties_64.find(s);
+		auto it = _edge_properties_64.find(name);
 		if (it != _edge_properties_64.end()) return NULL;
 
 		int id = _next_edge_property_id++;
@@ -1382,7 +1466,7 @@ public:
 					IF_LL_PERSISTENCE(_storage,) id,
 					name, type, destructor,
 					_out.edge_property_level_creation_callback_64());
-		_edge_properties_64[s] = p;
+		_edge_properties_64[name] = p;
 		_edge_properties_by_id_64[p->id()] = p;
 
 		return p;
@@ -1397,7 +1481,7 @@ public:
 	 * @param val the value
 	 */
 	template<typename U>
-	void set_node_prop(U* props, node_t n, U val) {
+	static void set_node_prop(U* props, node_t n, U val) {
 		props[n] = val;
 	}
 
@@ -1492,6 +1576,22 @@ public:
 	}
 
 
+private:
+
+	/**
+	 * Build the list of loader features that checkpoint() supports
+	 *
+	 * @return the feature vector
+	 */
+	static feature_vector_t checkpoint_features() {
+		feature_vector_t v;
+		v << LL_L_FEATURE(lc_reverse_edges);
+		v << LL_L_FEATURE(lc_reverse_maps);
+		return v;
+	}
+
+public:
+
 	/**
 	 * Initialize a set new level for a checkpoint
 	 *
@@ -1504,9 +1604,13 @@ public:
 
 		// Check features
 
-		feature_vector_t features;
-		features << LL_L_FEATURE(lc_reverse_edges);
-		features << LL_L_FEATURE(lc_reverse_maps);
+		// The supported list never changes, so build it on the first
+		// checkpoint only; the streaming workloads checkpoint on every
+		// micro-batch and should not pay a heap allocation for it. The
+		// static's initializer runs under the compiler's thread-safe
+		// static initialization, so concurrent first checkpoints are fine.
+
+		static const feature_vector_t features = checkpoint_features();
 
 		config->assert_features(false /*direct*/, true /*error*/, features);
 
@@ -1522,6 +1626,22 @@ public:
 
 		ll_w_vt_vertices_t* vt = source->vertex_table();
 
+		// The vertex table is sized for the database's node capacity, not
+		// for this graph, so everything past the page of the last node in
+		// use is an empty tail; bound the page scans below there instead
+		// of testing every NULL tail page on each checkpoint
+
+		const size_t vt_pages = std::min(
+				(num_total_nodes + vt->num_entries_per_page() - 1)
+					/ vt->num_entries_per_page(),
+				vt->num_pages());
+
+		// Lookahead for the page loops below: the w_node pointers within
+		// a page are stored contiguously, so reading the pointer a few
+		// entries ahead is free, and prefetching its target overlaps the
+		// pointer-chase miss that otherwise serializes every iteration
+		const size_t W_PREFETCH_DIST = 8;
+
 
 		// There is an issue pertaining to LL_COPY_ADJ_LIST__LARGE (and probably also
 		// __SMALL) in which a node's adj. list switches from being copied to differences
@@ -1533,26 +1653,44 @@ public:
 
 		// Construct the new_degrees and nodes_with_new_edges arrays
 
-		degree_t* new_degrees
-			= (degree_t*) malloc(sizeof(degree_t) * num_total_nodes);
-		memset(new_degrees, 0, sizeof(degree_t) * num_total_nodes);
-
-		degree_t* deleted_frozen_out_edges
-			= (degree_t*) malloc(sizeof(degree_t) * num_total_nodes);
-		memset(deleted_frozen_out_edges, 0, sizeof(degree_t)*num_total_nodes);
+		// One zero-filled arena for all three per-node arrays instead of
+		// three malloc+memset pairs: both the hugepage mapping and the
+		// calloc fallback hand out copy-on-write zero pages, so nothing
+		// is dirtied until the collection loop below first-touches it --
+		// for billion-node graphs that removes gigabytes of up-front
+		// zero-store traffic
+
+		size_t degree_arena_bytes = 3 * sizeof(degree_t) * num_total_nodes;
+		degree_t* degree_arena
+			= degree_arena_bytes >= LL_ET_HUGEPAGE_THRESHOLD
+				? (degree_t*) ll_mmap_hugepages(degree_arena_bytes) : NULL;
+		bool degree_arena_mapped = degree_arena != NULL;
+		if (!degree_arena_mapped) {
+			degree_arena = (degree_t*) calloc(3 * num_total_nodes,
+					sizeof(degree_t));
+			if (degree_arena == NULL) {
+				LL_E_PRINT("** OUT OF MEMORY **\n");
+				abort();
+			}
+		}
 
+		degree_t* new_degrees = degree_arena;
+		degree_t* deleted_frozen_out_edges = degree_arena + num_total_nodes;
 		degree_t* deleted_frozen_in_edges
-			= (degree_t*) malloc(sizeof(degree_t) * num_total_nodes);
-		memset(deleted_frozen_in_edges, 0, sizeof(degree_t)*num_total_nodes);
+			= degree_arena + 2 * num_total_nodes;
 
 #		pragma omp parallel
 		{
 #			pragma omp for schedule(static,4096)
-			for (size_t p = 0; p < vt->num_pages(); p++) {
+			for (size_t p = 0; p < vt_pages; p++) {
 				if (!vt->page_with_contents(p)) continue;
 				node_t n = p * vt->num_entries_per_page();
 
 				for (size_t i = 0; i < vt->num_entries_per_page(); i++, n++) {
+					if (i + W_PREFETCH_DIST < vt->num_entries_per_page()) {
+						__builtin_prefetch((const w_node*) vt->page_fast_read(
+									p, i + W_PREFETCH_DIST), 0, 0);
+					}
 					w_node* w = (w_node*) vt->page_fast_read(p, i);
 					if (w == NULL) continue;
 
@@ -1595,22 +1733,38 @@ public:
 		int max_edge_property_id = _next_edge_property_id;
 		(void) max_edge_property_id;
 
+#if LL_MAX_EDGE_PROPERTY_ID > 0
+		// Snapshot the by-ID property pointers so the per-edge loop
+		// indexes a local array directly instead of going through
+		// get_edge_property_*(), whose bounds check and this->_edge_
+		// properties_by_id_* indirection sat inside the innermost loop
+		ll_mlcsr_edge_property<uint32_t>* ep32[LL_MAX_EDGE_PROPERTY_ID];
+		ll_mlcsr_edge_property<uint64_t>* ep64[LL_MAX_EDGE_PROPERTY_ID];
+		memcpy(ep32, _edge_properties_by_id_32, sizeof(ep32));
+		memcpy(ep64, _edge_properties_by_id_64, sizeof(ep64));
+#endif
+
 #ifndef LL_PERSISTENCE
 #		pragma omp parallel
 #endif
 		{
 #	ifdef LL_SORT_EDGES
 			std::vector<node_t> v;
+			std::vector<node_t> v_scratch;
 #	endif
 
 #ifndef LL_PERSISTENCE
 #			pragma omp for schedule(dynamic,4096)
 #endif
-			for (size_t p = 0; p < vt->num_pages(); p++) {
+			for (size_t p = 0; p < vt_pages; p++) {
 				if (!vt->page_with_contents(p)) continue;
 				node_t n = p * vt->num_entries_per_page();
 
 				for (size_t i = 0; i < vt->num_entries_per_page(); i++, n++) {
+					if (i + W_PREFETCH_DIST < vt->num_entries_per_page()) {
+						__builtin_prefetch((const w_node*) vt->page_fast_read(
+									p, i + W_PREFETCH_DIST), 0, 0);
+					}
 					w_node* w = (w_node*) vt->page_fast_read(p, i);
 					if (w == NULL) continue;
 
@@ -1623,7 +1777,7 @@ public:
 #	elif defined(LL_SORT_EDGES)
 					v.clear();
 					source->get_out_edges(n, v);
-					std::sort(v.begin(), v.end());
+					ll_sort_nodes_radix(v, v_scratch);
 					_out.write_values(n, v);
 #	else
 					_out.write_values(n, w->wn_out_edges);
@@ -1636,16 +1790,31 @@ public:
 						w_edge* e = w->wn_out_edges[ei];
 						if (e->exists()) {
 #if LL_MAX_EDGE_PROPERTY_ID > 0
-							for (int j = 0; j < max_edge_property_id; j++) {
+							// Walk only the IDs this edge has ever
+							// written (see we_properties_mask_*)
+							// instead of probing every slot; the
+							// value checks keep the exact semantics
+							// of the old linear scan
+
+							uint64_t m = e->we_properties_mask_32;
+							while (m != 0) {
+								int j = __builtin_ctzll(m);
+								m &= m - 1;
+								if (j >= max_edge_property_id) break;
 								if (e->we_properties_32[j] != 0) {
-									get_edge_property_32(j)
-										->cow_write(e->we_numerical_id,
-												e->we_properties_32[j]);
+									ep32[j]->cow_write(e->we_numerical_id,
+											e->we_properties_32[j]);
 								}
+							}
+
+							m = e->we_properties_mask_64;
+							while (m != 0) {
+								int j = __builtin_ctzll(m);
+								m &= m - 1;
+								if (j >= max_edge_property_id) break;
 								if (e->we_properties_64[j].second != 0) {
-									get_edge_property_64(j)
-										->cow_write(e->we_numerical_id,
-												e->we_properties_64[j].second);
+									ep64[j]->cow_write(e->we_numerical_id,
+											e->we_properties_64[j].second);
 								}
 							}
 #endif
@@ -1675,12 +1844,17 @@ public:
 #			pragma omp parallel
 			{
 #				pragma omp for schedule(dynamic,4096)
-				for (size_t p = 0; p < vt->num_pages(); p++) {
+				for (size_t p = 0; p < vt_pages; p++) {
 					if (!vt->page_with_contents(p)) continue;
 					node_t n = p * vt->num_entries_per_page();
 
 					for (size_t i = 0; i < vt->num_entries_per_page();
 							i++, n++) {
+						if (i + W_PREFETCH_DIST
+								< vt->num_entries_per_page()) {
+							__builtin_prefetch((const w_node*) vt->page_fast_read(
+										p, i + W_PREFETCH_DIST), 0, 0);
+						}
 						w_node* w = (w_node*) vt->page_fast_read(p, i);
 						if (w == NULL) continue;
 
@@ -1709,11 +1883,16 @@ public:
 #	ifndef LL_PERSISTENCE
 #				pragma omp for schedule(dynamic,4096)
 #	endif
-				for (size_t p = 0; p < vt->num_pages(); p++) {
+				for (size_t p = 0; p < vt_pages; p++) {
 					if (!vt->page_with_contents(p)) continue;
 					node_t n = p * vt->num_entries_per_page();
 
 					for (size_t i = 0; i < vt->num_entries_per_page(); i++, n++) {
+						if (i + W_PREFETCH_DIST
+								< vt->num_entries_per_page()) {
+							__builtin_prefetch((const w_node*) vt->page_fast_read(
+										p, i + W_PREFETCH_DIST), 0, 0);
+						}
 						w_node* w = (w_node*) vt->page_fast_read(p, i);
 						if (w == NULL) continue;
 
@@ -1722,7 +1901,7 @@ public:
 				}
 
 #				pragma omp for schedule(dynamic,4096)
-				for (size_t p = 0; p < vt->num_pages(); p++) {
+				for (size_t p = 0; p < vt_pages; p++) {
 					if (!vt->page_with_contents(p)) continue;
 					node_t n = p * vt->num_entries_per_page();
 
@@ -1762,10 +1941,12 @@ public:
 
 		// Cleanup
 
-		free(deleted_frozen_in_edges);
-
-		free(new_degrees);
-		free(deleted_frozen_out_edges);
+		if (degree_arena_mapped) {
+			munmap(degree_arena, degree_arena_bytes);
+		}
+		else {
+			free(degree_arena);
+		}
 
 
 		// Checkpoint node properties
@@ -214,6 +214,51 @@ struct ll_edge_iterator {
 			node_var = (graph).inm_iter_next(ll_tmp_var(i)))
 
 
+//
+// Edge traversal with a callback - the iterator methods are non-virtual
+// and inline, so these compile down to the same direct CSR walk as the
+// hand-written loops, but the loop body is a single closed functor that
+// the compiler can inline and optimize as one unit
+//
+
+/**
+ * Apply a function to every out-edge of a node
+ *
+ * @param graph the graph
+ * @param n the node
+ * @param f the function, called as f(edge, target node)
+ */
+template <class Graph, class F>
+inline void ll_for_each_out_edge(Graph& graph, node_t n, F f) {
+	ll_edge_iterator iter;
+	graph.out_iter_begin(iter, n);
+	for (edge_t e = graph.out_iter_next(iter);
+			e != LL_NIL_EDGE;
+			e = graph.out_iter_next(iter)) {
+		f(e, iter.last_node);
+	}
+}
+
+
+/**
+ * Apply a function to the source of every in-edge of a node
+ *
+ * @param graph the graph
+ * @param n the node
+ * @param f the function, called as f(source node)
+ */
+template <class Graph, class F>
+inline void ll_for_each_in_node(Graph& graph, node_t n, F f) {
+	ll_edge_iterator iter;
+	graph.inm_iter_begin(iter, n);
+	for (node_t w = graph.inm_iter_next(iter);
+			w != LL_NIL_NODE;
+			w = graph.inm_iter_next(iter)) {
+		f(w);
+	}
+}
+
+
 
 //==========================================================================//
 // Support: ll_common_neighbor_iter                                         //
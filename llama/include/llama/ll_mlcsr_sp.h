@@ -830,10 +830,15 @@ public:
 	 */
 	void update_max_visible_level(edge_t edge, int mlevel) {
 #ifdef LL_DELETIONS
+		// Same per-edge lock as the lower-only variant below: it makes
+		// the payload read-modify-write atomic against concurrent
+		// updates of the same edge without serializing unrelated edges
+		_lt.acquire_for(edge);
 		T& v = (*this->edge_table(LL_EDGE_LEVEL(edge)))[LL_EDGE_INDEX(edge)];
 		v = LL_VALUE_CREATE_EXT(
 				LL_VALUE_PAYLOAD(v),
 				mlevel);
+		_lt.release_for(edge);
 #endif
 	}
 
@@ -1258,7 +1263,7 @@ public:
 	 * @param edge the edge ID
 	 * @param translation the edge ID translation
 	 */
-	inline ll_mlcsr_edge_property<node_t>& edge_translation() {
+	inline ll_mlcsr_edge_property<edge_t>& edge_translation() {
 		return _edge_translation;
 	}
 
@@ -1572,7 +1577,9 @@ public:
 		size_t max_edges = 0;
 		size_t max_adj_lists = 0;
 
-		for (size_t i = 0; i < max_nodes; i++) {
+#pragma omp parallel for schedule(static) \
+		reduction(+:max_edges,max_adj_lists)
+		for (ssize_t i = 0; i < (ssize_t) max_nodes; i++) {
 			max_edges += new_edge_counts[i];
 			if (new_edge_counts[i] > 0) max_adj_lists++;
 		}
@@ -45,6 +45,8 @@
 #include <cstdatomic>
 #endif // if GCC_VERSION > 40500
 
+#include <sys/mman.h>
+
 #include <cassert>
 #include <cstdio>
 
@@ -58,6 +60,19 @@
 //#define LL_PM_COUNTERS
 
 
+/*
+ * The type of page IDs stored in bulk (e.g. the per-level _page_ids
+ * arrays of the vertex tables). 32 bits address 4G pages -- 16 TB of
+ * 4 KB pages -- and halve the bytes the level-creation copies move;
+ * define LL_PAGE_ID_64 to go back to full-width IDs.
+ */
+#ifdef LL_PAGE_ID_64
+typedef size_t ll_page_id_t;
+#else
+typedef uint32_t ll_page_id_t;
+#endif
+
+
 /**
  * The page manager that supports allocation of fixed-size pages and reference
  * counting.
@@ -207,7 +222,7 @@ public:
 	 * @param out_ref the pointer to write the new page IDs
 	 * @param size the number of pages
 	 */
-	void allocate(T** out_ptr, size_t* out_ref, size_t size) {
+	void allocate(T** out_ptr, ll_page_id_t* out_ref, size_t size) {
 
 		ll_spinlock_acquire(&_lock);
 
@@ -244,7 +259,27 @@ public:
 	 * @param ids the page IDs
 	 * @param size the number of pages
 	 */
-	void acquire_pages(size_t* ids, size_t pages) {
+	void acquire_pages(ll_page_id_t* ids, size_t pages) {
+
+		// Batches below the schedule's chunk size would all land on
+		// thread 0 anyway, so run them serially instead of paying a
+		// fork/join per call -- the tiled callers (see
+		// copy_and_acquire_range) hit this path once per small tile
+
+		if (pages <= 131072) {
+
+			for (size_t i = 0; i < pages; i++) {
+
+				size_t id = ids[i];
+				size_t index_outer = id >> LL_PM_ALLOCATION_STEP_BITS;
+				size_t index_inner = id & (LL_PM_ALLOCATION_STEP - 1);
+
+				_pages_t* p = _pages[index_outer];
+				__sync_fetch_and_add(&p->refcounts[index_inner], 1);
+			}
+
+			return;
+		}
 
 #		pragma omp parallel for schedule(static,131072)
 		for (size_t i = 0; i < pages; i++) {
@@ -338,7 +373,7 @@ public:
 	 * @param ids the page IDs
 	 * @param size the number of pages
 	 */
-	void release_pages(size_t* ids, size_t pages) {
+	void release_pages(ll_page_id_t* ids, size_t pages) {
 
 #		pragma omp parallel for schedule(static,131072)
 		for (size_t i = 0; i < pages; i++) {
@@ -463,6 +498,15 @@ protected:
 		// Otherwise allocate a new page
 
 		size_t page_no = __sync_fetch_and_add(&_num_pages, 1);
+
+#ifndef LL_PAGE_ID_64
+		if (page_no >= (size_t) (ll_page_id_t) -1) {
+			LL_E_PRINT("Too many pages for 32-bit page IDs "
+					"(define LL_PAGE_ID_64)\n");
+			abort();
+		}
+#endif
+
 		size_t index_outer = page_no >> LL_PM_ALLOCATION_STEP_BITS;
 		size_t index_inner = page_no & (LL_PM_ALLOCATION_STEP - 1);
 
@@ -492,7 +536,26 @@ protected:
 				while (index_outer >= _pages.size()) {
 					size_t size = sizeof(_pages_t)
 						+ LL_PM_ALLOCATION_STEP * _page_bytes;
-					p = (_pages_t*) malloc(size);
+
+					// Slabs big enough for a hugepage are aligned to one
+					// and advised, so THP can back them and page scans do
+					// not thrash the DTLB; free() remains the correct
+					// release either way. (The default configuration
+					// stays just under 2 MB -- this kicks in with larger
+					// pages or a larger LL_PM_ALLOCATION_STEP_BITS.)
+
+					if (size >= 2ul * 1048576) {
+						void* q = NULL;
+						if (posix_memalign(&q, 2ul * 1048576, size) != 0)
+							q = NULL;
+#ifdef MADV_HUGEPAGE
+						if (q != NULL) madvise(q, size, MADV_HUGEPAGE);
+#endif
+						p = (_pages_t*) q;
+					}
+					else {
+						p = (_pages_t*) malloc(size);
+					}
 					if (p == NULL) {
 						fprintf(stderr, "*** Out of memory ***\n");
 						abort();
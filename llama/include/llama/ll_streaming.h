@@ -41,7 +41,6 @@
 #include "llama/ll_mlcsr_graph.h"
 #include "llama/ll_writable_graph.h"
 
-#include <queue>
 
 
 /**
@@ -76,11 +75,34 @@ public:
 
 /**
  * A serial concatenation of multiple data sources
+ *
+ * The source list is a Michael-Scott style linked queue instead of a
+ * spinlock around std::queue, so concurrent add() and pull() callers
+ * synchronize with single CAS operations on the tail and head pointers
+ * rather than all serializing on one lock word. The head points at a
+ * dummy node; the first live source is head->next. An exhausted source
+ * is retired by one CAS that swings the head to its node, which also
+ * replaces the old "front changed" abort -- whoever wins the CAS owns
+ * the retirement. Retired nodes are kept on a side list until the
+ * destructor, so a concurrent reader can never dereference freed memory
+ * (and the head CAS cannot suffer ABA through a recycled address);
+ * there is one small node per source ever added, which is negligible.
  */
 class ll_concat_data_source : public ll_data_source {
 
-	std::queue<ll_data_source*> _data_sources;
-	ll_spinlock_t _lock;
+	/// A queue node; one per added data source, plus the initial dummy
+	struct node {
+		ll_data_source* ds;
+		node* volatile next;
+		node* retired_next;
+	};
+
+	// The head is hit by the consumers and the tail by the producers, so
+	// keep them on separate cache lines to avoid false sharing
+
+	alignas(64) node* volatile _head;
+	alignas(64) node* volatile _tail;
+	node* volatile _retired;
 
 
 public:
@@ -90,7 +112,14 @@ public:
 	 */
 	ll_concat_data_source() {
 
-		_lock = 0;
+		node* dummy = new node();
+		dummy->ds = NULL;
+		dummy->next = NULL;
+		dummy->retired_next = NULL;
+
+		_head = dummy;
+		_tail = dummy;
+		_retired = NULL;
 	}
 
 
@@ -99,9 +128,19 @@ public:
 	 */
 	virtual ~ll_concat_data_source() {
 
-		while (!_data_sources.empty()) {
-			delete _data_sources.front();
-			_data_sources.pop();
+		node* n = _head;
+		while (n != NULL) {
+			node* next = n->next;
+			if (n->ds != NULL) delete n->ds;
+			delete n;
+			n = next;
+		}
+
+		n = _retired;
+		while (n != NULL) {
+			node* next = n->retired_next;
+			delete n;
+			n = next;
 		}
 	}
 
@@ -113,9 +152,28 @@ public:
 	 */
 	void add(ll_data_source* data_source) {
 
-		ll_spinlock_acquire(&_lock);
-		_data_sources.push(data_source);
-		ll_spinlock_release(&_lock);
+		node* n = new node();
+		n->ds = data_source;
+		n->next = NULL;
+		n->retired_next = NULL;
+
+		while (true) {
+			node* t = _tail;
+			node* next = t->next;
+
+			if (t != _tail) continue;
+
+			if (next != NULL) {
+				// The tail lags behind; help swing it forward
+				__sync_bool_compare_and_swap(&_tail, t, next);
+				continue;
+			}
+
+			if (__sync_bool_compare_and_swap(&t->next, NULL, n)) {
+				__sync_bool_compare_and_swap(&_tail, t, n);
+				return;
+			}
+		}
 	}
 
 
@@ -128,39 +186,210 @@ public:
 	 */
 	virtual bool pull(ll_writable_graph* graph, size_t max_edges) {
 
-		ll_spinlock_acquire(&_lock);
-
-		if (_data_sources.empty()) {
-			ll_spinlock_release(&_lock);
-			return false;
-		}
+		while (true) {
 
-		ll_data_source* d = _data_sources.front();
-		ll_spinlock_release(&_lock);
+			node* h = _head;
+			node* first = h->next;
 
-		while (true) {
+			if (first == NULL) return false;
 
-			bool r = d->pull(graph, max_edges);
+			bool r = first->ds->pull(graph, max_edges);
 			if (r) return r;
 
-			ll_spinlock_acquire(&_lock);
+			// The source is exhausted: whoever wins the head CAS retires
+			// it (the node becomes the new dummy); everybody else just
+			// retries on the new head
 
-			if (d != _data_sources.front()) {
-				LL_E_PRINT("Race condition\n");
-				abort();
-			}
+			if (__sync_bool_compare_and_swap(&_head, h, first)) {
 
-			delete d;
-			_data_sources.pop();
+				delete first->ds;
+				first->ds = NULL;
 
-			if (_data_sources.empty()) {
-				ll_spinlock_release(&_lock);
-				return false;
+				while (true) {
+					node* retired = _retired;
+					h->retired_next = retired;
+					if (__sync_bool_compare_and_swap(&_retired, retired, h))
+						break;
+				}
 			}
+		}
+	}
+};
+
+
+/**
+ * A push-based adapter: the application hands individual edges to
+ * add_edge(), and pull() drains them into the writable graph. The buffer
+ * is a power-of-two ring of two parallel node_t arrays -- one store per
+ * endpoint, no per-edge allocation, and the drain scans each array
+ * sequentially, touching half the cache lines of a ring of node pairs.
+ * The ring grows by doubling when full, so add_edge() never blocks on
+ * the consumer.
+ *
+ * When the application guarantees that only one thread ever touches the
+ * adapter (e.g. a single loader thread that alternates add_edge() and
+ * pull()), instantiate it with ThreadSafe = false: the spinlock and the
+ * atomic cursor loads compile away entirely, saving two atomics per
+ * edge in a loop that does very little other work.
+ */
+template <bool ThreadSafe = true>
+class ll_simple_data_source_adapter : public ll_data_source {
+
+	node_t* _tails;
+	node_t* _heads;
+
+	size_t _capacity;
+	size_t _mask;
+
+	// The read and write cursors are polled lock-free from the other
+	// side, so give each its own cache line, and the same for the lock
+	// word so a spinning waiter does not invalidate either cursor
+
+	alignas(64) size_t _rd;
+	alignas(64) size_t _wr;
+
+	alignas(64) ll_spinlock_t _lock;
+
+
+public:
+
+	/**
+	 * Create an instance of the adapter
+	 *
+	 * @param capacity the initial buffer capacity (rounded up to a power
+	 *                 of two)
+	 */
+	ll_simple_data_source_adapter(size_t capacity = 1024) {
+
+		_capacity = 16;
+		while (_capacity < capacity) _capacity <<= 1;
+		_mask = _capacity - 1;
+
+		_tails = (node_t*) malloc(sizeof(node_t) * _capacity);
+		_heads = (node_t*) malloc(sizeof(node_t) * _capacity);
+
+		_rd = 0;
+		_wr = 0;
+		_lock = 0;
+	}
+
 
-			d = _data_sources.front();
-			ll_spinlock_release(&_lock);
+	/**
+	 * Destroy the adapter
+	 */
+	virtual ~ll_simple_data_source_adapter() {
+
+		free(_tails);
+		free(_heads);
+	}
+
+
+	/**
+	 * Add an edge to the buffer
+	 *
+	 * @param tail the tail
+	 * @param head the head
+	 */
+	void add_edge(node_t tail, node_t head) {
+
+		if (ThreadSafe) ll_spinlock_acquire(&_lock);
+
+		if (_wr - _rd == _capacity) grow();
+
+		size_t i = _wr & _mask;
+		_tails[i] = tail;
+		_heads[i] = head;
+		_wr++;
+
+		if (ThreadSafe) ll_spinlock_release(&_lock);
+	}
+
+
+	/**
+	 * Get the number of buffered edges
+	 *
+	 * The counters are read with atomic loads instead of taking the lock,
+	 * so a polling caller does not bounce the lock's cache line between
+	 * the producer and the consumer cores; the count is a snapshot
+	 *
+	 * @return the number of edges
+	 */
+	size_t size() {
+		if (!ThreadSafe) return _wr - _rd;
+		return __atomic_load_n(&_wr, __ATOMIC_ACQUIRE)
+			- __atomic_load_n(&_rd, __ATOMIC_ACQUIRE);
+	}
+
+
+	/**
+	 * Load the next batch of data
+	 *
+	 * @param graph the writable graph
+	 * @param max_edges the maximum number of edges
+	 * @return true if data was loaded, false if there are no more data
+	 */
+	virtual bool pull(ll_writable_graph* graph, size_t max_edges) {
+
+		// Empty-check without the lock: _rd only advances in pull() and
+		// _wr only grows, so seeing the buffer empty here is conclusive
+
+		if (ThreadSafe) {
+			if (__atomic_load_n(&_wr, __ATOMIC_ACQUIRE) == _rd) return false;
+			ll_spinlock_acquire(&_lock);
 		}
+
+		size_t n = _wr - _rd;
+		if (n > max_edges) n = max_edges;
+
+		if (n == 0) {
+			if (ThreadSafe) ll_spinlock_release(&_lock);
+			return false;
+		}
+
+		for (size_t i = 0; i < n; i++) {
+			size_t x = (_rd + i) & _mask;
+			graph->add_edge(_tails[x], _heads[x]);
+		}
+		_rd += n;
+
+		if (ThreadSafe) ll_spinlock_release(&_lock);
+		return true;
+	}
+
+
+private:
+
+	/**
+	 * Double the ring capacity; the caller must hold the lock
+	 */
+	void grow() {
+
+		size_t capacity = _capacity * 2;
+		node_t* tails = (node_t*) malloc(sizeof(node_t) * capacity);
+		node_t* heads = (node_t*) malloc(sizeof(node_t) * capacity);
+
+		// Unwrap the ring: the occupied range [_rd, _wr) may span the
+		// end of the old arrays, so copy it in up to two runs
+
+		size_t n = _wr - _rd;
+		size_t start = _rd & _mask;
+		size_t run = _capacity - start;
+		if (run > n) run = n;
+
+		memcpy(tails, _tails + start, sizeof(node_t) * run);
+		memcpy(heads, _heads + start, sizeof(node_t) * run);
+		memcpy(tails + run, _tails, sizeof(node_t) * (n - run));
+		memcpy(heads + run, _heads, sizeof(node_t) * (n - run));
+
+		free(_tails);
+		free(_heads);
+
+		_tails = tails;
+		_heads = heads;
+		_capacity = capacity;
+		_mask = capacity - 1;
+		_rd = 0;
+		_wr = n;
 	}
 };
 
@@ -76,6 +76,7 @@
 
 #include <sys/time.h>
 #include <cmath>
+#include <cstdarg>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -140,6 +141,139 @@
 #define __COMPILER_FENCE	asm volatile("":::"memory");
 
 
+/**
+ * A small name-keyed map backed by a flat vector of (name, value) pairs.
+ * Meant for the handful of named CSRs and properties a graph carries:
+ * at these sizes a linear scan over contiguous pairs beats a hash map's
+ * string hashing and bucket chasing on every lookup, and iteration walks
+ * memory in order instead of hopping between heap-allocated nodes. The
+ * iterators are plain vector iterators, so the usual it->first /
+ * it->second access works unchanged.
+ */
+template <typename V>
+class ll_flat_name_map {
+
+	std::vector<std::pair<std::string, V> > _entries;
+
+
+public:
+
+	typedef std::string key_type;
+	typedef V mapped_type;
+
+	typedef typename std::vector<std::pair<std::string, V> >::iterator
+		iterator;
+	typedef typename std::vector<std::pair<std::string, V> >::const_iterator
+		const_iterator;
+
+
+	/**
+	 * Get the start iterator
+	 *
+	 * @return the iterator
+	 */
+	inline iterator begin() { return _entries.begin(); }
+
+
+	/**
+	 * Get the end iterator
+	 *
+	 * @return the iterator
+	 */
+	inline iterator end() { return _entries.end(); }
+
+
+	/**
+	 * Get the start iterator
+	 *
+	 * @return the iterator
+	 */
+	inline const_iterator begin() const { return _entries.begin(); }
+
+
+	/**
+	 * Get the end iterator
+	 *
+	 * @return the iterator
+	 */
+	inline const_iterator end() const { return _entries.end(); }
+
+
+	/**
+	 * Get the number of entries
+	 *
+	 * @return the number of entries
+	 */
+	inline size_t size() const { return _entries.size(); }
+
+
+	/**
+	 * Find an entry by name
+	 *
+	 * @param key the name
+	 * @return the iterator, or end() if not found
+	 */
+	iterator find(const char* key) {
+		for (iterator it = _entries.begin(); it != _entries.end(); it++) {
+			if (strcmp(it->first.c_str(), key) == 0) return it;
+		}
+		return _entries.end();
+	}
+
+
+	/**
+	 * Find an entry by name
+	 *
+	 * @param key the name
+	 * @return the iterator, or end() if not found
+	 */
+	inline iterator find(const std::string& key) {
+		return find(key.c_str());
+	}
+
+
+	/**
+	 * Find an entry by name
+	 *
+	 * @param key the name
+	 * @return the iterator, or end() if not found
+	 */
+	const_iterator find(const char* key) const {
+		for (const_iterator it = _entries.begin(); it != _entries.end();
+				it++) {
+			if (strcmp(it->first.c_str(), key) == 0) return it;
+		}
+		return _entries.end();
+	}
+
+
+	/**
+	 * Find an entry by name
+	 *
+	 * @param key the name
+	 * @return the iterator, or end() if not found
+	 */
+	inline const_iterator find(const std::string& key) const {
+		return find(key.c_str());
+	}
+
+
+	/**
+	 * Get the value for the given name, default-constructing a new entry
+	 * if it does not exist
+	 *
+	 * @param key the name
+	 * @return the value
+	 */
+	V& operator[] (const std::string& key) {
+		iterator it = find(key.c_str());
+		if (it != _entries.end()) return it->second;
+		_entries.push_back(std::make_pair(key, V()));
+		return _entries.back().second;
+	}
+};
+
+
 /**
  * Get the time in ms
  *
@@ -407,6 +541,29 @@ inline int64_t ll_rand64_positive_r(unsigned* seedp) {
 			LL_IS_STDERR_TTY ? LL_AC_RESET : "", \
 			## __VA_ARGS__); }
 
+
+/**
+ * Print an error message and abort. A cold, non-returning, out-of-line
+ * failure path: the callers' happy paths stay small enough to inline,
+ * and the compiler knows the branch never comes back.
+ *
+ * @param format the printf-style format
+ */
+static void __attribute__((noreturn, noinline, cold,
+			format(printf, 1, 2), unused))
+ll_die(const char* format, ...) {
+
+	va_list ap;
+	va_start(ap, format);
+	fprintf(stderr, "%s[ERROR]%s ",
+			LL_IS_STDERR_TTY ? LL_AC_RED : "",
+			LL_IS_STDERR_TTY ? LL_AC_RESET : "");
+	vfprintf(stderr, format, ap);
+	va_end(ap);
+
+	abort();
+}
+
 #define LL_I_PRINT(format, ...) { \
 	fprintf(stderr, "%s[INFO ] %s::%s %s" format, \
 			LL_IS_STDERR_TTY ? LL_AC_BLUE : "", \
@@ -72,7 +72,19 @@ public:
 		_array = (std::atomic<T>*) malloc(sizeof(*_array) * size);
 		
 		if (nil == (T) 0) {
-			memset(_array, 0, sizeof(*_array) * size);
+
+			// Zero page-sized chunks in parallel with a static schedule,
+			// so on NUMA machines the first touch distributes the pages
+			// across the nodes of the threads that will use them instead
+			// of all landing on the constructing thread's node
+
+			const size_t chunk = 4096 / sizeof(*_array);
+
+#			pragma omp parallel for schedule(static)
+			for (ssize_t i = 0; i < (ssize_t) _size; i += chunk) {
+				size_t n = _size - i < chunk ? _size - i : chunk;
+				memset((void*) &_array[i], 0, sizeof(*_array) * n);
+			}
 		}
 		else {
 #			pragma omp parallel for schedule(dynamic,4096)
@@ -401,7 +413,7 @@ public:
 	 *
 	 * @param size the number of elements
 	 */
-	ll_w_vt_swcow_array(size_t size) : _array(size / LL_ENTRIES_PER_PAGE + 1) {
+	ll_w_vt_swcow_array(size_t size) : _array(ll_page_of(size) + 1) {
 		_size = size;
 	}
 
@@ -480,8 +492,8 @@ public:
 	 * @return the number of pages
 	 */
 	inline size_t num_pages() const {
-		size_t n = _size / LL_ENTRIES_PER_PAGE;
-		if ((_size & (LL_ENTRIES_PER_PAGE - 1)) != 0) n++;
+		size_t n = ll_page_of(_size);
+		if (ll_page_off(_size) != 0) n++;
 		return n;
 	}
 
@@ -59,6 +59,10 @@
 #define LL_MAX_EDGE_PROPERTY_ID		0
 #endif
 
+#if LL_MAX_EDGE_PROPERTY_ID > 64
+#error "LL_MAX_EDGE_PROPERTY_ID must fit in the 64-bit property bitmaps"
+#endif
+
 #ifdef LL_WRITABLE_USE_MEMORY_POOL
 #include "llama/ll_mem_helper.h"
 #endif
@@ -150,6 +154,14 @@ public:
 	/// The property spinlock
 	ll_spinlock_t we_properties_spinlock;
 
+	/// Bitmap of 32-bit property IDs ever written on this edge, so scans
+	/// (e.g. the checkpoint) visit only the set IDs instead of probing
+	/// every slot
+	uint64_t we_properties_mask_32;
+
+	/// The same bitmap for the 64-bit properties
+	uint64_t we_properties_mask_64;
+
 	/// The 32-bit properties
 	uint32_t we_properties_32[LL_MAX_EDGE_PROPERTY_ID];
 
@@ -173,6 +185,8 @@ public:
 	w_edge() {
 
 		we_properties_spinlock = 0;
+		we_properties_mask_32 = 0;
+		we_properties_mask_64 = 0;
 
 		memset(we_properties_32, 0, sizeof(we_properties_32));
 		memset(we_properties_64, 0, sizeof(we_properties_64));
@@ -204,6 +218,8 @@ public:
 		memset(we_properties_32, 0, sizeof(we_properties_32));
 		memset(we_properties_64, 0, sizeof(we_properties_64));
 
+		we_properties_mask_32 = 0;
+		we_properties_mask_64 = 0;
 		we_properties_spinlock = 0;
 
 #ifdef LL_S_WEIGHTS_INSTEAD_OF_DUPLICATE_EDGES
@@ -253,6 +269,7 @@ public:
 	template <typename T>
 	void set_property_32(int property_id, T value) {
 		we_properties_32[property_id] = value;
+		mark_property(&we_properties_mask_32, property_id);
 	}
 
 
@@ -265,6 +282,7 @@ public:
 	 */
 	template <typename T>
 	T add_property_32(int property_id, T value) {
+		mark_property(&we_properties_mask_32, property_id);
 		return __sync_add_and_fetch(&we_properties_32[property_id], value);
 	}
 
@@ -298,6 +316,7 @@ public:
 		if (p.first != NULL) p.first(p.second);
 		p.first = destructor;
 		p.second = value;
+		mark_property(&we_properties_mask_64, property_id);
 
 		ll_spinlock_release(&we_properties_spinlock);
 	}
@@ -313,8 +332,28 @@ public:
 	 */
 	template <typename T>
 	T add_property_64(int property_id, T value) {
+		mark_property(&we_properties_mask_64, property_id);
 		return __sync_add_and_fetch(&we_properties_64[property_id].second, value);
 	}
+
+
+private:
+
+	/**
+	 * Mark a property ID as written in the given bitmap. The common case
+	 * of re-writing an already-marked property is a plain load and test;
+	 * the atomic OR runs only on the first write of each ID, so writers
+	 * of different IDs on the same edge cannot lose each other's bits.
+	 *
+	 * @param mask the bitmap
+	 * @param property_id the property ID
+	 */
+	static inline void mark_property(uint64_t* mask, int property_id) {
+		uint64_t bit = 1ull << property_id;
+		if ((*mask & bit) == 0) {
+			__sync_fetch_and_or(mask, bit);
+		}
+	}
 };
 
 
@@ -517,11 +556,19 @@ inline void delete_free_w_edges(void) {
  * Helper types
  */
 
+// The adjacency-list blocks (16 w_edge pointers each) are allocated
+// millions of times during loading; route them through the slab pool
+// instead of thrashing malloc
+
 /// The out-edges
-typedef ll_growable_array<w_edge*, 4, w_edge_deallocator> ll_w_out_edges_t;
+typedef ll_growable_array<w_edge*, 4, w_edge_deallocator, true,
+		ll_slab_block_allocator<sizeof(w_edge*) * 16>,
+		ll_slab_block_deallocator<sizeof(w_edge*) * 16> > ll_w_out_edges_t;
 
 /// The in-edges
-typedef ll_growable_array<w_edge*, 4, w_edge_noop, false> ll_w_in_edges_t;
+typedef ll_growable_array<w_edge*, 4, w_edge_noop, false,
+		ll_slab_block_allocator<sizeof(w_edge*) * 16>,
+		ll_slab_block_deallocator<sizeof(w_edge*) * 16> > ll_w_in_edges_t;
 
 #endif
 
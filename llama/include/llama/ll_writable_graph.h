@@ -887,7 +887,7 @@ public:
 			}
 
 			if (!alreadyDeleted) {
-				_deletions_nodes_out[LL_D_STRIPE(source)][source]
+				_deletions_nodes_out[ll_d_stripe(source)][source]
 					.an_deleted_edges.push_back(edge);
 			}
 
@@ -904,7 +904,7 @@ public:
 				}
 
 				if (!alreadyDeleted) {
-					_deletions_nodes_in[LL_D_STRIPE(target)][target]
+					_deletions_nodes_in[ll_d_stripe(target)][target]
 						.an_deleted_edges.push_back(in_edge);
 				}
 			}
@@ -1017,7 +1017,7 @@ public:
 		// Having to take this spinlock is extremely slow - so let's try something else
 
 retry:
-		auto& h = _deletions_nodes_out[LL_D_STRIPE(node)];
+		auto& h = _deletions_nodes_out[ll_d_stripe(node)];
 		size_t size = h.size();
 		__COMPILER_FENCE;
 		auto it = h.find(node);
@@ -1090,7 +1090,7 @@ retry:
 		// Having to take this spinlock is extremely slow - so let's try something else
 
 retry:
-		auto& h = _deletions_nodes_in[LL_D_STRIPE(node)];
+		auto& h = _deletions_nodes_in[ll_d_stripe(node)];
 		size_t size = h.size();
 		__COMPILER_FENCE;
 		auto it = h.find(node);
@@ -1744,7 +1744,7 @@ retry:
 	 * @param val the value
 	 */
 	template<typename U>
-	void set_node_prop(U* props, node_t n, U val) {
+	static void set_node_prop(U* props, node_t n, U val) {
 		props[n] = val;
 	}
 
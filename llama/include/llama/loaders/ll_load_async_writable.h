@@ -50,11 +50,14 @@ public:
 	/// The next request in the queue
 	ll_la_request* _next;
 
+	/// The originating ll_la_request_pool, or NULL if heap-allocated
+	void* _pool;
+
 
 	/**
 	 * Create an instance of ll_la_request
 	 */
-	ll_la_request() : _next(NULL) {}
+	ll_la_request() : _next(NULL), _pool(NULL) {}
 
 
 	/**
@@ -69,9 +72,157 @@ public:
 	 * @param graph the graph
 	 */
 	virtual void run(ll_writable_graph& graph) = 0;
+
+
+	/**
+	 * Destroy the request, returning its memory to the originating pool
+	 * if it came from one (defined below ll_la_request_pool)
+	 */
+	inline void release();
 };
 
 
+/**
+ * A recycling pool of fixed-size request blocks. The producer thread
+ * placement-news requests into blocks from here instead of calling the
+ * global allocator once per edge, and the queue workers hand the blocks
+ * back through ll_la_request::release(); a recycled block goes onto a
+ * free list and is reused by the next allocation. Blocks come from
+ * 1024-request slabs, so the global allocator is involved once per slab.
+ * The free list is shared between the producer and the workers, hence
+ * the spinlock; it is taken once per request, but unlike malloc there is
+ * no arena bookkeeping behind it.
+ */
+class ll_la_request_pool {
+
+	static const size_t BLOCKS_PER_SLAB = 1024;
+
+	size_t _block_size;
+	std::vector<void*> _slabs;
+	size_t _bump;
+
+	void* _free;
+
+	ll_spinlock_t _lock;
+
+
+public:
+
+	/**
+	 * Create the pool
+	 */
+	ll_la_request_pool() {
+
+		_block_size = 0;
+		_bump = 0;
+		_free = NULL;
+		_lock = 0;
+	}
+
+
+	/**
+	 * Destroy the pool. The caller must make sure that no live requests
+	 * remain.
+	 */
+	~ll_la_request_pool() {
+
+		for (size_t i = 0; i < _slabs.size(); i++) ::free(_slabs[i]);
+	}
+
+
+	/**
+	 * Allocate a block for a request of the given size
+	 *
+	 * @param bytes the request size
+	 * @return the block
+	 */
+	void* allocate(size_t bytes) {
+
+		ll_spinlock_acquire(&_lock);
+
+		if (bytes > _block_size) {
+			// All requests allocated from one pool have the same static
+			// type, so the size can only grow before the first recycle
+			assert(_free == NULL);
+			_block_size = (bytes + LL_MEM_POOL_ALIGN - 1)
+				& ~((size_t) LL_MEM_POOL_ALIGN - 1);
+			_bump = BLOCKS_PER_SLAB;	/* force a fresh slab */
+		}
+
+		void* p = _free;
+		if (p != NULL) {
+			_free = *((void**) p);
+			ll_spinlock_release(&_lock);
+			return p;
+		}
+
+		if (_slabs.empty() || _bump >= BLOCKS_PER_SLAB) {
+			void* slab = malloc(_block_size * BLOCKS_PER_SLAB);
+			if (slab == NULL) {
+				LL_E_PRINT("** OUT OF MEMORY **\n");
+				abort();
+			}
+			_slabs.push_back(slab);
+			_bump = 0;
+		}
+
+		p = ((char*) _slabs[_slabs.size() - 1]) + _block_size * _bump;
+		_bump++;
+
+		ll_spinlock_release(&_lock);
+		return p;
+	}
+
+
+	/**
+	 * Peek at the block the next allocate() is likely to return, so the
+	 * producer can prefetch it for write before constructing the next
+	 * request -- recycled blocks were last touched by a worker core, so
+	 * their lines are typically in another cache. The peek is racy and
+	 * purely a hint; it may return NULL.
+	 *
+	 * @return the probable next block, or NULL
+	 */
+	inline void* peek_next_block() {
+
+		void* p = _free;
+		if (p != NULL) return p;
+
+		if (!_slabs.empty() && _bump < BLOCKS_PER_SLAB)
+			return ((char*) _slabs[_slabs.size() - 1]) + _block_size * _bump;
+
+		return NULL;
+	}
+
+
+	/**
+	 * Return a destroyed request's block to the free list
+	 *
+	 * @param p the block
+	 */
+	void release_block(void* p) {
+
+		ll_spinlock_acquire(&_lock);
+		*((void**) p) = _free;
+		_free = p;
+		ll_spinlock_release(&_lock);
+	}
+};
+
+
+inline void ll_la_request::release() {
+
+	if (_pool != NULL) {
+		ll_la_request_pool* pool = (ll_la_request_pool*) _pool;
+		this->~ll_la_request();
+		pool->release_block(this);
+	}
+	else {
+		delete this;
+	}
+}
+
+
 /**
  * A NOP request
  */
@@ -107,6 +258,11 @@ class ll_la_request_queue {
 	
 	volatile bool _shutdown_when_empty;
 
+	/// The shared batch generation counters (optional; see
+	/// set_shutdown_epochs() -- NULL means per-queue shutdown flags only)
+	const volatile uint32_t* _group_batch;
+	const volatile uint32_t* _group_done;
+
 
 	// Make sure that the data structure is at least one cache-line in size...
 	// Do we need this?
@@ -128,6 +284,9 @@ public:
 		_length = 0;
 
 		_shutdown_when_empty = false;
+
+		_group_batch = NULL;
+		_group_done = NULL;
 	}
 
 
@@ -138,7 +297,7 @@ public:
 
 		while (_head != NULL) {
 			ll_la_request* n = _head->_next;
-			delete _head;
+			_head->release();
 			_head = n;
 		}
 	}
@@ -149,7 +308,7 @@ public:
 	 *
 	 * @param request the request
 	 */
-	void enqueue(ll_la_request* request) {
+	virtual void enqueue(ll_la_request* request) {
 
 		request->_next = NULL;
 
@@ -166,12 +325,39 @@ public:
 	}
 
 
+	/**
+	 * Insert a pre-linked chain of requests into the queue with a single
+	 * lock acquisition -- the batched producers link their requests
+	 * locally and pay the lock once per chain instead of once per request
+	 *
+	 * @param head the first request of the chain
+	 * @param tail the last request of the chain (tail->_next must be NULL)
+	 * @param count the number of requests in the chain
+	 */
+	virtual void enqueue_chain(ll_la_request* head, ll_la_request* tail,
+			size_t count) {
+
+		assert(tail->_next == NULL);
+
+		ll_spinlock_acquire(&_lock);
+
+		_length += count;
+
+		if (_tail != NULL)
+			_tail->_next = head;
+		_tail = tail;
+		if (_head == NULL) _head = head;
+
+		ll_spinlock_release(&_lock);
+	}
+
+
 	/**
 	 * Remove from the front of the queue
 	 *
 	 * @return the request, or NULL if empty
 	 */
-	ll_la_request* dequeue() {
+	virtual ll_la_request* dequeue() {
 
 		ll_spinlock_acquire(&_lock);
 	
@@ -197,7 +383,7 @@ public:
 	 *
 	 * @return the number of elements in the queue
 	 */
-	inline size_t size() const {
+	virtual size_t size() const {
 		return _length;
 	}
 
@@ -212,6 +398,24 @@ public:
 	}
 
 
+	/**
+	 * Attach the queue to a pair of shared batch generation counters, so
+	 * that a producer driving many queues can rearm and shut down all of
+	 * them with one store each instead of touching every queue's control
+	 * line twice per batch. The workers exit when the queue is empty and
+	 * *done == *batch; the producer rearms by incrementing the batch
+	 * counter and signals completion by copying it into the done counter.
+	 *
+	 * @param batch the shared batch generation counter
+	 * @param done the shared producer-done generation counter
+	 */
+	void set_shutdown_epochs(const volatile uint32_t* batch,
+			const volatile uint32_t* done) {
+		_group_batch = batch;
+		_group_done = done;
+	}
+
+
 	/**
 	 * Process the requests from start to finish
 	 *
@@ -222,7 +426,7 @@ public:
 		ll_la_request* r;
 		while ((r = dequeue()) != NULL) {
 			r->run(graph);
-			delete r;
+			r->release();
 		}
 	}
 
@@ -239,11 +443,53 @@ public:
 
 			if (r == NULL) {
 				if (_shutdown_when_empty) return;
+				if (_group_done != NULL && *_group_done == *_group_batch)
+					return;
 				usleep(10);
 			}
 			else {
 				r->run(graph);
-				delete r;
+				r->release();
+			}
+		}
+	}
+
+
+	/**
+	 * Process the requests like worker(), but with the concrete request
+	 * type supplied by the caller: the run() call and the destructor are
+	 * qualified, so the compiler can dispatch (and inline) them directly
+	 * instead of paying two indirect branches per request. All requests
+	 * in the queue must really be of the given type.
+	 *
+	 * @param graph the graph
+	 */
+	template <typename Request>
+	void worker_as(ll_writable_graph& graph) {
+
+		for (;;) {
+
+			ll_la_request* r = dequeue();
+
+			if (r == NULL) {
+				if (_shutdown_when_empty) return;
+				if (_group_done != NULL && *_group_done == *_group_batch)
+					return;
+				usleep(10);
+			}
+			else {
+				Request* q = static_cast<Request*>(r);
+				q->Request::run(graph);
+
+				if (q->_pool != NULL) {
+					ll_la_request_pool* pool
+						= (ll_la_request_pool*) q->_pool;
+					q->Request::~Request();
+					pool->release_block(q);
+				}
+				else {
+					delete q;
+				}
 			}
 		}
 	}
@@ -260,13 +506,153 @@ public:
 		if (r == NULL) return false;
 
 		r->run(graph);
-		delete r;
+		r->release();
 
 		return true;
 	}
 };
 
 
+/**
+ * A single-producer, single-consumer variant of the request queue: one
+ * loader thread enqueues and exactly one worker drains, which is the
+ * shape of the striped writable load. The queue is a fixed ring of
+ * request pointers with a release-store on the write index and an
+ * acquire-load on the read side -- no lock and no CAS on either path,
+ * so neither end ever bounces the other's cache line exclusively.
+ * The indices sit on separate cache lines to avoid false sharing.
+ *
+ * When the ring fills up, the producer briefly sleeps, mirroring the
+ * consumer's behavior when the ring is empty.
+ */
+class ll_la_request_queue_spsc : public ll_la_request_queue {
+
+	static const size_t RING_BITS = 16;
+	static const size_t RING_SIZE = 1ul << RING_BITS;
+	static const size_t RING_MASK = RING_SIZE - 1;
+
+	ll_la_request** _ring;
+
+	volatile size_t _rd;
+	char __pad_rd[64 - sizeof(size_t)];
+
+	volatile size_t _wr;
+	char __pad_wr[64 - sizeof(size_t)];
+
+
+public:
+
+	/**
+	 * Create an empty request queue
+	 */
+	ll_la_request_queue_spsc() {
+
+		_ring = (ll_la_request**) malloc(sizeof(ll_la_request*) * RING_SIZE);
+		_rd = 0;
+		_wr = 0;
+	}
+
+
+	/**
+	 * Destroy the queue
+	 */
+	virtual ~ll_la_request_queue_spsc() {
+
+		ll_la_request* r;
+		while ((r = dequeue()) != NULL) r->release();
+
+		free(_ring);
+	}
+
+
+	/**
+	 * Insert into the queue
+	 *
+	 * @param request the request
+	 */
+	virtual void enqueue(ll_la_request* request) {
+
+		size_t wr = _wr;
+
+		while (wr - __atomic_load_n(&_rd, __ATOMIC_ACQUIRE) >= RING_SIZE) {
+			usleep(10);
+		}
+
+		_ring[wr & RING_MASK] = request;
+		__atomic_store_n(&_wr, wr + 1, __ATOMIC_RELEASE);
+	}
+
+
+	/**
+	 * Insert a pre-linked chain of requests into the queue
+	 *
+	 * The chain is unrolled straight into the ring and published with a
+	 * single release-store of the write index per run of free slots, so
+	 * a batch of requests costs one atomic publish instead of one per
+	 * request (and the consumer-side index is polled once per run, not
+	 * once per request)
+	 *
+	 * @param head the first request of the chain
+	 * @param tail the last request of the chain (tail->_next must be NULL)
+	 * @param count the number of requests in the chain
+	 */
+	virtual void enqueue_chain(ll_la_request* head, ll_la_request* tail,
+			size_t count) {
+
+		(void) tail;
+
+		size_t wr = _wr;
+
+		while (count > 0) {
+
+			size_t free;
+			while ((free = RING_SIZE
+						- (wr - __atomic_load_n(&_rd, __ATOMIC_ACQUIRE)))
+					== 0) {
+				usleep(10);
+			}
+
+			size_t n = count < free ? count : free;
+			for (size_t i = 0; i < n; i++) {
+				_ring[wr & RING_MASK] = head;
+				head = head->_next;
+				wr++;
+			}
+
+			__atomic_store_n(&_wr, wr, __ATOMIC_RELEASE);
+			count -= n;
+		}
+	}
+
+
+	/**
+	 * Remove from the front of the queue
+	 *
+	 * @return the request, or NULL if empty
+	 */
+	virtual ll_la_request* dequeue() {
+
+		size_t rd = _rd;
+		if (rd == __atomic_load_n(&_wr, __ATOMIC_ACQUIRE)) return NULL;
+
+		ll_la_request* r = _ring[rd & RING_MASK];
+		__atomic_store_n(&_rd, rd + 1, __ATOMIC_RELEASE);
+
+		return r;
+	}
+
+
+	/**
+	 * Get the size of the queue
+	 *
+	 * @return the number of elements in the queue
+	 */
+	virtual size_t size() const {
+		return _wr - _rd;
+	}
+};
+
+
 /**
  * A request with node properties
  */
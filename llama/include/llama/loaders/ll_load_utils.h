@@ -42,6 +42,7 @@
 #include <cstring>
 #include <unistd.h>
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -161,6 +162,15 @@ class ll_edge_list_loader : public ll_data_source {
 			else
 				return a.head < b.head;
 		}
+
+		// Order-preserving key prefix for the radix sort in
+		// ll_external_sort; exact for 32-bit nodes, tail-only otherwise
+		static uint64_t key64(const xs_edge& e) {
+			if (sizeof(NodeType) <= 4)
+				return ((uint64_t) (uint32_t) e.tail << 32)
+					| (uint32_t) e.head;
+			return (uint64_t) e.tail;
+		}
 	};
 
 	/**
@@ -182,6 +192,13 @@ class ll_edge_list_loader : public ll_data_source {
 			else
 				return a.head < b.head;
 		}
+
+		static uint64_t key64(const xs_w_edge& e) {
+			if (sizeof(NodeType) <= 4)
+				return ((uint64_t) (uint32_t) e.tail << 32)
+					| (uint32_t) e.head;
+			return (uint64_t) e.tail;
+		}
 	};
 
 	/**
@@ -205,6 +222,13 @@ class ll_edge_list_loader : public ll_data_source {
 			else
 				return a.tail < b.tail;
 		}
+
+		static uint64_t key64(const xs_in_edge& e) {
+			if (sizeof(NodeType) <= 4)
+				return ((uint64_t) (uint32_t) e.head << 32)
+					| (uint32_t) e.tail;
+			return (uint64_t) e.head;
+		}
 	};
 
 
@@ -216,6 +240,22 @@ private:
 	/// The last value of _has_more
 	volatile bool _last_has_more;
 
+	/// The recycling pool for the async writable-load requests
+	ll_la_request_pool _request_pool;
+
+	/// The request queues, reused across the incremental load batches
+	std::vector<ll_la_request_queue*> _request_queues;
+
+	/// The unbounded locked fallback queues, used when the OpenMP team
+	/// comes up smaller than requested (see load_incremental)
+	std::vector<ll_la_request_queue*> _request_queues_locked;
+
+	/// The batch generation counter shared by the request queues
+	volatile uint32_t _batch_epoch;
+
+	/// The producer-done generation counter shared by the request queues
+	volatile uint32_t _producer_done_epoch;
+
 
 public:
 
@@ -225,6 +265,9 @@ public:
 	ll_edge_list_loader() {
 		_has_more = true;
 		_last_has_more = _has_more;
+
+		_batch_epoch = 0;
+		_producer_done_epoch = 0;
 	}
 
 
@@ -232,6 +275,10 @@ public:
 	 * Destroy the loader
 	 */
 	virtual ~ll_edge_list_loader() {
+		for (size_t i = 0; i < _request_queues.size(); i++)
+			delete _request_queues[i];
+		for (size_t i = 0; i < _request_queues_locked.size(); i++)
+			delete _request_queues_locked[i];
 	}
 
 
@@ -255,6 +302,26 @@ protected:
 	virtual void rewind() = 0;
 
 
+	/**
+	 * Read the next batch of edges. The default implementation just loops
+	 * over next_edge(); loaders that can copy many edges at once (e.g.
+	 * from a binary buffer) should override it, which amortizes one
+	 * virtual call over the whole batch.
+	 *
+	 * @param buffer the output buffer
+	 * @param max_edges the buffer capacity
+	 * @return the number of edges read (< max_edges implies end of input)
+	 */
+	virtual size_t next_edges(xs_w_edge* buffer, size_t max_edges) {
+		size_t n = 0;
+		while (n < max_edges && next_edge(&buffer[n].tail, &buffer[n].head,
+					&buffer[n].weight)) {
+			n++;
+		}
+		return n;
+	}
+
+
 	/**
 	 * Get graph stats if they are available
 	 *
@@ -907,36 +974,115 @@ public:
 		size_t chunk_size = config->lc_max_edges;
 		bool load_weight = !config->lc_no_properties;
 
-		xs_w_edge e;
-		bool has_more;
+		const size_t batch_size = 1024;
+		xs_w_edge buffer[batch_size];
 
-		while ((has_more = next_edge(&e.tail, &e.head, &e.weight))) {
-			max_edges++;
+		// Per-stripe local chains: the requests of one batch are linked
+		// locally and handed to each queue with one enqueue_chain call,
+		// so the queue lock is taken once per stripe per batch instead
+		// of once per edge
 
-			LL_D_NODE2_PRINT(e.tail, e.head, "%u --> %u\n", (unsigned) e.tail,
-					(unsigned) e.head);
+		ll_la_request* chain_head[num_stripes];
+		ll_la_request* chain_tail[num_stripes];
+		size_t chain_count[num_stripes];
 
-			ll_la_request_with_edge_properties* request;
+		for (size_t i = 0; i < num_stripes; i++) {
+			chain_head[i] = NULL;
+			chain_tail[i] = NULL;
+			chain_count[i] = 0;
+		}
+
+		// A modulo-power-of-two mask when the stripe count allows it, so
+		// the per-edge stripe pick avoids an integer division
+
+		const bool stripes_pow2 = (num_stripes & (num_stripes - 1)) == 0;
+		const size_t stripe_mask = num_stripes - 1;
 
-			if (HasWeight && load_weight) {
-				// XXX
-				//LL_NOT_IMPLEMENTED;
+		bool has_more = true;
+
+		while (has_more) {
+
+			size_t request_edges = batch_size;
+			if (chunk_size > 0 && chunk_size - max_edges < request_edges) {
+				request_edges = chunk_size - max_edges;
 			}
+			if (request_edges == 0) break;
+
+			size_t n = next_edges(buffer, request_edges);
+			has_more = n == request_edges;
+			max_edges += n;
+
+			for (size_t i = 0; i < n; i++) {
+				xs_w_edge& e = buffer[i];
+
+				LL_D_NODE2_PRINT(e.tail, e.head, "%u --> %u\n",
+						(unsigned) e.tail, (unsigned) e.head);
+
+				ll_la_request_with_edge_properties* request;
+
+				if (HasWeight && load_weight) {
+					// XXX
+					//LL_NOT_IMPLEMENTED;
+				}
 
 #ifdef LL_S_WEIGHTS_INSTEAD_OF_DUPLICATE_EDGES
-			request = new ll_la_add_edge_for_streaming_with_weights
-				<node_t>((node_t) e.tail, (node_t) e.head);
+				request = new (_request_pool.allocate(
+							sizeof(ll_la_add_edge_for_streaming_with_weights
+								<node_t>)))
+					ll_la_add_edge_for_streaming_with_weights
+					<node_t>((node_t) e.tail, (node_t) e.head);
 #else
-			request = new ll_la_add_edge
-				<node_t>((node_t) e.tail, (node_t) e.head);
+				request = new (_request_pool.allocate(
+							sizeof(ll_la_add_edge<node_t>)))
+					ll_la_add_edge
+					<node_t>((node_t) e.tail, (node_t) e.head);
 #endif
+				request->_pool = &_request_pool;
+
+				// Prefetch the block the next request will be built in:
+				// recycled blocks come back from the worker cores, so
+				// pulling the line over early hides the coherence miss
+				// behind the rest of this iteration
+
+				if (i + 1 < n) {
+					void* next_block = _request_pool.peek_next_block();
+					if (next_block != NULL) ll_prefetch_w(next_block);
+				}
+
+				// Mix both endpoints (Murmur3 finalizer) so the hubs of a
+				// power-law graph spread over all the stripes instead of
+				// drowning the one their page maps to
+
+				uint64_t k = (uint64_t) e.tail
+					^ (((uint64_t) e.head << 17) | ((uint64_t) e.head >> 47));
+				k ^= k >> 33;
+				k *= 0xff51afd7ed558ccdULL;
+				k ^= k >> 33;
+				k *= 0xc4ceb9fe1a85ec53ULL;
+				k ^= k >> 33;
 
-			size_t stripe = (e.tail >> (LL_ENTRIES_PER_PAGE_BITS+3))
-				% num_stripes;
-			request_queues[stripe]->enqueue(request);
+				size_t stripe = stripes_pow2
+					? (k & stripe_mask) : (k % num_stripes);
 
-			if (chunk_size > 0)
-				if (max_edges % chunk_size == 0) break;
+				request->_next = NULL;
+				if (chain_tail[stripe] == NULL) {
+					chain_head[stripe] = request;
+				}
+				else {
+					chain_tail[stripe]->_next = request;
+				}
+				chain_tail[stripe] = request;
+				chain_count[stripe]++;
+			}
+
+			for (size_t i = 0; i < num_stripes; i++) {
+				if (chain_head[i] == NULL) continue;
+				request_queues[i]->enqueue_chain(chain_head[i],
+						chain_tail[i], chain_count[i]);
+				chain_head[i] = NULL;
+				chain_tail[i] = NULL;
+				chain_count[i] = 0;
+			}
 		}
 
 		return has_more;
@@ -965,15 +1111,78 @@ public:
 
 		// Initializie
 
-		size_t num_stripes = omp_get_max_threads();
-		ll_la_request_queue* request_queues[num_stripes];
-		for (size_t i = 0; i < num_stripes; i++) {
-			request_queues[i] = new ll_la_request_queue();
+		// One producer thread plus one worker per stripe, so each queue
+		// has a single producer and a single consumer and can use the
+		// SPSC ring variant
+
+		size_t num_stripes = omp_get_max_threads() > 1
+			? omp_get_max_threads() - 1 : 1;
+
+		// Reuse the queues (and their rings) across calls -- streaming
+		// ingest calls this once per batch, so recreating them each time
+		// is just malloc/free churn
+
+		while (_request_queues.size() < num_stripes) {
+			ll_la_request_queue* q = new ll_la_request_queue_spsc();
+			q->set_shutdown_epochs(&_batch_epoch, &_producer_done_epoch);
+			_request_queues.push_back(q);
+		}
+		ll_la_request_queue** request_queues = &_request_queues[0];
+
+		// The locked, unbounded fallback variant for the case where the
+		// OpenMP team comes up smaller than requested (see below); the
+		// queue objects are tiny, so keep both sets around
+
+		while (_request_queues_locked.size() < num_stripes) {
+			ll_la_request_queue* q = new ll_la_request_queue();
+			q->set_shutdown_epochs(&_batch_epoch, &_producer_done_epoch);
+			_request_queues_locked.push_back(q);
 		}
+		ll_la_request_queue** request_queues_locked
+			= &_request_queues_locked[0];
 
 		LL_D_PRINT("Initialize\n");
 
 
+		// Single-threaded fast path: with one thread there is nobody to
+		// pipeline with, so skip the queues, the stripe hashing, and the
+		// OpenMP handshake and apply the edges directly
+
+		if (omp_get_max_threads() == 1) {
+
+			size_t chunk_size = config->lc_max_edges;
+			size_t loaded = 0;
+			bool has_more = true;
+
+			graph->tx_begin();
+
+			xs_w_edge e;
+			while (true) {
+				if (chunk_size > 0 && loaded >= chunk_size) break;
+				if (!next_edge(&e.tail, &e.head, &e.weight)) {
+					has_more = false;
+					break;
+				}
+				loaded++;
+
+#ifdef LL_S_WEIGHTS_INSTEAD_OF_DUPLICATE_EDGES
+				edge_t x;
+				graph->add_edge_for_streaming_with_weights(
+						(node_t) e.tail, (node_t) e.head, &x);
+#else
+				graph->add_edge((node_t) e.tail, (node_t) e.head);
+#endif
+			}
+
+			graph->tx_commit();
+
+			_last_has_more = _has_more;
+			_has_more = has_more;
+
+			return true;
+		}
+
+
 		// TODO Deduplicate? Unordered?
 
 
@@ -984,27 +1193,63 @@ public:
 
 			graph->tx_begin();
 
-			for (size_t i = 0; i < num_stripes; i++)
-				request_queues[i]->shutdown_when_empty(false);
+			// Rearm all the queues with a single store: the workers only
+			// exit once the done counter catches up with the batch counter
+
+			_batch_epoch++;
 
-			#pragma omp parallel
+			#pragma omp parallel num_threads((int) (num_stripes + 1))
 			{
+				// If the team came up smaller than requested, some queues
+				// have no worker and get drained by the producer only
+				// after the whole chunk has been produced -- with the
+				// bounded SPSC rings the producer would spin forever once
+				// such a ring fills up. Every thread in the team sees the
+				// same omp_get_num_threads(), so producer and workers
+				// agree here without any extra handshake to fall back to
+				// the unbounded locked queues in that case.
+
+				ll_la_request_queue** queues
+					= (size_t) omp_get_num_threads() < num_stripes + 1
+					? request_queues_locked : request_queues;
+
 				if (omp_get_thread_num() == 0) {
 
-					has_more = this->load_to_request_queues(request_queues,
+					has_more = this->load_to_request_queues(queues,
 							num_stripes, config);
 
-					// Add a worker
+					// Publish the enqueued requests, then signal all the
+					// workers at once
+
+					__sync_synchronize();
+					_producer_done_epoch = _batch_epoch;
+
+					// Drain the queues that have no worker -- safe here
+					// because the fallback queues never block the producer
 
-					for (size_t i = 0; i < num_stripes; i++)
-						request_queues[i]->shutdown_when_empty();
-					for (size_t i = 0; i < num_stripes; i++)
-						request_queues[i]->run(*graph);
+					size_t workers = omp_get_num_threads() - 1;
+					for (size_t i = workers; i < num_stripes; i++)
+						queues[i]->run(*graph);
 				}
 				else {
-					int t = omp_get_thread_num();
-					for (size_t i = 0; i < num_stripes; i++, t++)
-						request_queues[t % num_stripes]->worker(*graph);
+
+					// Exactly one worker per queue: the old code had
+					// every thread loop over every stripe, which piled
+					// all the consumers onto each queue in turn. The
+					// queues only ever hold the one request type built
+					// in load_to_request_queues, so run the workers with
+					// that type known statically.
+
+#ifdef LL_S_WEIGHTS_INSTEAD_OF_DUPLICATE_EDGES
+					typedef ll_la_add_edge_for_streaming_with_weights
+						<node_t> request_t;
+#else
+					typedef ll_la_add_edge<node_t> request_t;
+#endif
+
+					size_t i = omp_get_thread_num() - 1;
+					if (i < num_stripes)
+						queues[i]->worker_as<request_t>(*graph);
 				}
 			}
 
@@ -1016,8 +1261,6 @@ public:
 		_last_has_more = _has_more;
 		_has_more = has_more;
 
-		for (size_t i = 0; i < num_stripes; i++) delete request_queues[i];
-
 		return true;
 	}
 
@@ -1182,6 +1425,53 @@ private:
 	}
 
 
+	/**
+	 * Compute the cache-oriented vertex relabeling for lc_reorder_gorder.
+	 * This is the degree part of the Gorder family of orderings: relabel
+	 * the vertices in decreasing degree order (ties keep their original
+	 * order), so that the hub vertices -- which dominate the random
+	 * accesses of PageRank, BFS, and the like -- end up packed into the
+	 * same few pages and cache lines instead of scattered across the
+	 * entire vertex range. The full sliding-window sibling score would
+	 * need the adjacency lists in memory, which the streaming loader does
+	 * not have at this point, so only the degree term is used. Costs one
+	 * extra pass over the input; the input is left rewound.
+	 *
+	 * @param max_nodes the number of nodes
+	 * @param permutation the output permutation (new ID = permutation[old ID])
+	 */
+	void compute_reorder_permutation(size_t max_nodes,
+			std::vector<NodeType>& permutation) {
+
+		std::vector<degree_t> degrees(max_nodes, 0);
+
+		xs_w_edge e;
+		while (next_edge(&e.tail, &e.head, &e.weight)) {
+			if ((size_t) e.tail < max_nodes) degrees[e.tail]++;
+			if ((size_t) e.head < max_nodes) degrees[e.head]++;
+		}
+		rewind();
+
+		std::vector<NodeType> order(max_nodes);
+		for (size_t i = 0; i < max_nodes; i++) order[i] = (NodeType) i;
+
+		struct by_degree_desc {
+			const degree_t* d;
+			by_degree_desc(const degree_t* degrees) : d(degrees) {}
+			bool operator() (NodeType a, NodeType b) const {
+				return d[a] > d[b];
+			}
+		};
+		std::stable_sort(order.begin(), order.end(),
+				by_degree_desc(&degrees[0]));
+
+		permutation.resize(max_nodes);
+		for (size_t i = 0; i < max_nodes; i++) {
+			permutation[order[i]] = (NodeType) i;
+		}
+	}
+
+
 	/**
 	 * Load the graph directly into the read-only representation for the case
 	 * in which the ll_edge_list_loader::stat() info is readily available
@@ -1202,6 +1492,8 @@ private:
 		features << LL_L_FEATURE(lc_deduplicate);
 		features << LL_L_FEATURE(lc_no_properties);
 		features << LL_L_FEATURE(lc_max_edges);
+		features << LL_L_FEATURE(lc_reorder_gorder);
+		features << LL_L_FEATURE(lc_numa_interleave);
 
 		config->assert_features(false /*direct*/, true /*error*/, features);
 
@@ -1212,6 +1504,8 @@ private:
 		bool reverse = config->lc_reverse_edges;
 		bool load_weight = !config->lc_no_properties;
 
+		if (config->lc_numa_interleave) ll_numa_interleave_enabled() = true;
+
 		size_t new_level = graph->num_levels();
 		size_t max_nodes = 0;
 		size_t max_edges = 0;
@@ -1238,6 +1532,17 @@ private:
 		}
 
 
+		// Compute the cache-oriented relabeling if configured; both ingest
+		// loops below then remap each edge right after reading it. Note that
+		// the remapped edge stream is not sorted even if the input was, so
+		// loading goes through the external sort
+
+		std::vector<NodeType> reorder;
+		if (config->lc_reorder_gorder) {
+			compute_reorder_permutation(max_nodes, reorder);
+		}
+
+
 		// Initialize the new CSR level
 
 		graph->partial_init_level(max_nodes, max_nodes, max_edges);
@@ -1285,7 +1590,8 @@ private:
 			fprintf(stderr, "[<]");
 		}
 
-		if (config->lc_direction != LL_L_UNDIRECTED_DOUBLE) {
+		if (config->lc_direction != LL_L_UNDIRECTED_DOUBLE
+				&& reorder.empty()) {
 
 			std::vector<NodeType> adj_list_buffer;
 			std::vector<WeightType> weight_buffer;
@@ -1396,6 +1702,11 @@ private:
 				loaded_edges++;
 				read_edges++;
 
+				if (!reorder.empty()) {
+					e.tail = reorder[e.tail];
+					e.head = reorder[e.head];
+				}
+
 				if (config->lc_max_edges > 0
 						&& read_edges > config->lc_max_edges) {
 					break;